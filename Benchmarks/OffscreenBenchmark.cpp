@@ -0,0 +1,310 @@
+// Headless benchmark of the OpenGL renderer.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+// Renders a synthetic scene off screen through OSMesa, so it runs on
+// machines without a gpu, and reports the cpu frame time together
+// with the draw calls and state changes of a frame. Mesa renders in
+// software, so the frame times are dominated by the submission cost
+// only for scenes of many small meshes, which is what the default
+// scene is.
+//
+// The materials are phong shaded by default, with the shaders
+// compiled by a ShaderLoader. The rendering view and the stream
+// buffer are set up from the options, 1 enables and 0 disables.
+//
+// Usage: OpenGLRendererBenchmark [-n meshes] [-m materials]
+//        [-k lights] [-t depth] [-f frames] [-w width] [-h height]
+//        [-p phong] [-s sorted] [-c culling] [-i instancing]
+//        [-b stream buffer bytes]
+
+#include <Meta/OpenGL.h>
+#include <GL/osmesa.h>
+
+#include <Renderers/OpenGL/Renderer.h>
+#include <Renderers/OpenGL/RenderingView.h>
+#include <Renderers/OpenGL/LightRenderer.h>
+#include <Renderers/OpenGL/ShaderLoader.h>
+#include <Renderers/TextureLoader.h>
+#include <Renderers/OpenGL/RenderStatistics.h>
+#include <Display/OpenGL/FrameBufferBackend.h>
+#include <Display/RenderCanvas.h>
+#include <Display/PerspectiveViewingVolume.h>
+#include <Display/Camera.h>
+#include <Scene/SceneNode.h>
+#include <Scene/TransformationNode.h>
+#include <Scene/MeshNode.h>
+#include <Scene/PointLightNode.h>
+#include <Geometry/Mesh.h>
+#include <Geometry/GeometrySet.h>
+#include <Geometry/Material.h>
+#include <Resources/DataBlock.h>
+#include <Resources/Indices.h>
+#include <Resources/DirectoryManager.h>
+#include <Core/EngineEvents.h>
+#include <Utils/Timer.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace OpenEngine;
+using namespace OpenEngine::Display;
+using namespace OpenEngine::Scene;
+using namespace OpenEngine::Geometry;
+using namespace OpenEngine::Resources;
+using namespace OpenEngine::Math;
+using Renderers::OpenGL::Renderer;
+using Renderers::OpenGL::RenderingView;
+using Renderers::OpenGL::LightRenderer;
+using Renderers::OpenGL::ShaderLoader;
+using Renderers::TextureLoader;
+using Renderers::OpenGL::RenderStatistics;
+using Display::OpenGL::FrameBufferBackend;
+
+/**
+ * The top level canvas standing in for the window.
+ */
+class OffscreenFrame : public ICanvas {
+private:
+    unsigned int width, height;
+public:
+    OffscreenFrame(unsigned int width, unsigned int height)
+        : ICanvas(NULL), width(width), height(height) {}
+    void Handle(Display::InitializeEventArg arg) {}
+    void Handle(Display::DeinitializeEventArg arg) {}
+    void Handle(Display::ProcessEventArg arg) {}
+    void Handle(Display::ResizeEventArg arg) {}
+    unsigned int GetWidth() const { return width; }
+    unsigned int GetHeight() const { return height; }
+    void SetWidth(const unsigned int width) { this->width = width; }
+    void SetHeight(const unsigned int height) { this->height = height; }
+    ITexture2DPtr GetTexture() { return ITexture2DPtr(); }
+};
+
+struct Options {
+    unsigned int meshes, materials, lights, depth, frames, width, height;
+    unsigned int phong, sorted, culling, instancing, streamBuffer;
+};
+
+/**
+ * A unit cube with face normals, shared by all meshes in the scene.
+ */
+static GeometrySetPtr CreateCube(IndicesPtr& indices) {
+    static const float n[6][3] = {
+        { 1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0,-1, 0}, {0, 0, 1}, {0, 0,-1}
+    };
+    Float3DataBlockPtr vertices(new Float3DataBlock(24));
+    Float3DataBlockPtr normals(new Float3DataBlock(24));
+    indices = IndicesPtr(new Indices(36));
+    float* v = vertices->GetData();
+    float* vn = normals->GetData();
+    unsigned int* i = indices->GetData();
+    for (unsigned int f = 0; f < 6; ++f) {
+        // two axes spanning the face
+        unsigned int a = (f / 2 + 1) % 3, b = (f / 2 + 2) % 3;
+        for (unsigned int c = 0; c < 4; ++c) {
+            float* p = v + (f * 4 + c) * 3;
+            for (unsigned int d = 0; d < 3; ++d) {
+                p[d] = n[f][d] * 0.5f;
+                vn[(f * 4 + c) * 3 + d] = n[f][d];
+            }
+            p[a] = (c == 1 || c == 2) ? 0.5f : -0.5f;
+            p[b] = (c >= 2) ? 0.5f : -0.5f;
+        }
+        unsigned int q[6] = {0, 1, 2, 0, 2, 3};
+        for (unsigned int k = 0; k < 6; ++k)
+            i[f * 6 + k] = f * 4 + q[k];
+    }
+    return GeometrySetPtr(new GeometrySet(vertices, normals));
+}
+
+/**
+ * Meshes are laid out on a grid, each below a chain of depth
+ * transformation nodes. Lights are placed above the grid.
+ */
+static ISceneNode* CreateScene(const Options& opt) {
+    SceneNode* root = new SceneNode();
+
+    IndicesPtr indices;
+    GeometrySetPtr cube = CreateCube(indices);
+    std::vector<MaterialPtr> materials;
+    for (unsigned int i = 0; i < std::max(opt.materials, 1u); ++i) {
+        MaterialPtr mat(new Material());
+        float t = i / float(std::max(opt.materials, 1u));
+        mat->diffuse = Vector<4,float>(t, 1.0f - t, 0.5f, 1.0f);
+        if (opt.phong) mat->shading = Material::PHONG;
+        materials.push_back(mat);
+    }
+
+    unsigned int side = 1;
+    while (side * side < opt.meshes) ++side;
+    for (unsigned int i = 0; i < opt.meshes; ++i) {
+        ISceneNode* parent = root;
+        for (unsigned int d = 0; d < opt.depth; ++d) {
+            TransformationNode* trans = new TransformationNode();
+            if (d == 0)
+                trans->SetPosition(Vector<3,float>((i % side) * 2.0f - side, 0.0f,
+                                                   (i / side) * 2.0f - side));
+            parent->AddNode(trans);
+            parent = trans;
+        }
+        MeshPtr mesh(new Mesh(indices, Geometry::TRIANGLES, cube,
+                              materials[i % materials.size()]));
+        parent->AddNode(new MeshNode(mesh));
+    }
+
+    for (unsigned int i = 0; i < opt.lights; ++i) {
+        TransformationNode* trans = new TransformationNode();
+        trans->SetPosition(Vector<3,float>(i * 4.0f - opt.lights * 2.0f, 10.0f, 0.0f));
+        trans->AddNode(new PointLightNode());
+        root->AddNode(trans);
+    }
+    return root;
+}
+
+static bool ParseOptions(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] != '-' || strlen(argv[i]) != 2 || i + 1 == argc)
+            return false;
+        unsigned int value = atoi(argv[++i]);
+        switch (argv[i - 1][1]) {
+        case 'n': opt.meshes = value; break;
+        case 'm': opt.materials = value; break;
+        case 'k': opt.lights = value; break;
+        case 't': opt.depth = value; break;
+        case 'f': opt.frames = value; break;
+        case 'w': opt.width = value; break;
+        case 'h': opt.height = value; break;
+        case 'p': opt.phong = value; break;
+        case 's': opt.sorted = value; break;
+        case 'c': opt.culling = value; break;
+        case 'i': opt.instancing = value; break;
+        case 'b': opt.streamBuffer = value; break;
+        default: return false;
+        }
+    }
+    return opt.frames > 0 && opt.width > 0 && opt.height > 0;
+}
+
+int main(int argc, char** argv) {
+    Options opt = { 1000, 16, 4, 2, 200, 256, 256, 1, 0, 0, 1, 0 };
+    if (!ParseOptions(argc, argv, opt)) {
+        std::cerr << "usage: " << argv[0]
+                  << " [-n meshes] [-m materials] [-k lights] [-t depth]"
+                  << " [-f frames] [-w width] [-h height] [-p phong]"
+                  << " [-s sorted] [-c culling] [-i instancing]"
+                  << " [-b stream buffer bytes]" << std::endl;
+        return 1;
+    }
+    // the phong shader sources are found from the engine root
+    DirectoryManager::AppendPath(OE_ENGINE_DIR);
+
+    OSMesaContext context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 8, 0, NULL);
+    if (context == NULL) {
+        std::cerr << "could not create an OSMesa context" << std::endl;
+        return 1;
+    }
+    std::vector<GLubyte> pixels(opt.width * opt.height * 4);
+    if (!OSMesaMakeCurrent(context, &pixels[0], GL_UNSIGNED_BYTE, opt.width, opt.height)) {
+        std::cerr << "could not make the OSMesa context current" << std::endl;
+        OSMesaDestroyContext(context);
+        return 1;
+    }
+
+    ISceneNode* scene = CreateScene(opt);
+    PerspectiveViewingVolume volume(1.0f, 4000.0f);
+    Camera camera(volume);
+    camera.SetPosition(Vector<3,float>(0.0f, opt.meshes / 20.0f + 20.0f,
+                                       opt.meshes / 20.0f + 20.0f));
+    camera.LookAt(Vector<3,float>(0.0f, 0.0f, 0.0f));
+
+    Renderer renderer;
+    RenderingView view;
+    LightRenderer lights;
+    renderer.ProcessEvent().Attach(view);
+    renderer.PreProcessEvent().Attach(lights);
+    renderer.SetStreamBufferSize(opt.streamBuffer);
+    view.SetSortedRendering(opt.sorted != 0);
+    view.SetFrustumCulling(opt.culling != 0);
+    view.SetInstancing(opt.instancing != 0);
+
+    TextureLoader textures(renderer);
+    ShaderLoader shaders(textures, *scene);
+    shaders.SetLightRenderer(&lights);
+
+    OffscreenFrame frame(opt.width, opt.height);
+    RenderCanvas canvas(new FrameBufferBackend(&renderer));
+    canvas.SetRenderer(&renderer);
+    canvas.SetViewingVolume(&camera);
+    canvas.SetScene(scene);
+    ((IListener<Display::InitializeEventArg>&)canvas).Handle(Display::InitializeEventArg(frame));
+    // compile the shaders of the scene once the renderer is set up
+    shaders.Handle(Core::InitializeEventArg());
+
+    // The first frames upload the scene and are not measured.
+    const unsigned int warmup = 3;
+    std::vector<double> times;
+    Utils::Timer timer;
+    timer.Start();
+    unsigned int last = timer.GetElapsedIntervals(1);
+    for (unsigned int i = 0; i < warmup + opt.frames; ++i) {
+        unsigned int start = timer.GetElapsedIntervals(1);
+        ((IListener<Display::ProcessEventArg>&)canvas)
+            .Handle(Display::ProcessEventArg(frame, start, start - last));
+        // wait for the frame, or only the submission is measured
+        glFinish();
+        last = start;
+        if (i >= warmup)
+            times.push_back((timer.GetElapsedIntervals(1) - start) / 1000.0);
+    }
+    RenderStatistics stats = renderer.GetStatistics();
+
+    ((IListener<Display::DeinitializeEventArg>&)canvas).Handle(Display::DeinitializeEventArg(frame));
+    OSMesaDestroyContext(context);
+
+    std::sort(times.begin(), times.end());
+    double total = 0.0;
+    for (unsigned int i = 0; i < times.size(); ++i)
+        total += times[i];
+
+    // One key value pair per line, easy to pick up by scripts.
+    std::cout << "meshes " << opt.meshes << std::endl
+              << "materials " << opt.materials << std::endl
+              << "lights " << opt.lights << std::endl
+              << "depth " << opt.depth << std::endl
+              << "frames " << opt.frames << std::endl
+              << "phong " << opt.phong << std::endl
+              << "sorted " << opt.sorted << std::endl
+              << "culling " << opt.culling << std::endl
+              << "instancing " << opt.instancing << std::endl
+              << "stream_buffer " << opt.streamBuffer << std::endl
+              << "frame_ms_mean " << total / times.size() << std::endl
+              << "frame_ms_median " << times[times.size() / 2] << std::endl
+              << "frame_ms_min " << times.front() << std::endl
+              << "frame_ms_max " << times.back() << std::endl
+              << "draw_calls " << stats.GetDrawCalls() << std::endl
+              << "draw_elements " << stats.drawElements << std::endl
+              << "draw_instanced " << stats.drawInstanced << std::endl
+              << "draw_arrays " << stats.drawArrays << std::endl
+              << "primitives " << stats.primitives << std::endl
+              << "program_binds " << stats.programBinds << std::endl
+              << "texture_binds " << stats.textureBinds << std::endl
+              << "buffer_binds " << stats.bufferBinds << std::endl
+              << "framebuffer_binds " << stats.framebufferBinds << std::endl
+              << "vertex_array_binds " << stats.vertexArrayBinds << std::endl
+              << "other_state_changes " << stats.otherStateChanges << std::endl
+              << "filtered_state_changes " << stats.filteredStateChanges << std::endl
+              << "buffer_bytes " << stats.bufferBytes << std::endl
+              << "texture_bytes " << stats.textureBytes << std::endl;
+
+    delete scene;
+    return 0;
+}
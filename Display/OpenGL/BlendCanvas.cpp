@@ -13,6 +13,7 @@
 #include <Math/Matrix.h>
 #include <Math/Vector.h>
 #include <Meta/OpenGL.h>
+#include <Renderers/OpenGL/GLStateCache.h>
 #include <Logging/Logger.h>
 #include <Renderers/IRenderer.h>
 
@@ -21,6 +22,7 @@ namespace Display {
 namespace OpenGL {
     using Math::Matrix;
     using Math::Vector;
+    using Renderers::OpenGL::GLStateCache;
 
 BlendCanvas::BlendCanvas(ICanvasBackend* backend)
     : ICanvas(backend)
@@ -57,6 +59,9 @@ void BlendCanvas::Handle(Display::ResizeEventArg arg) {
 }
 
 void BlendCanvas::Handle(Display::ProcessEventArg arg) {
+    // The gl state may have been changed outside the cache since
+    // the last frame.
+    GLStateCache::Invalidate();
     list<ICanvas*>::iterator i = inits.begin();
     for (; i != inits.end(); ++i) {
         ((IListener<Display::ProcessEventArg>*)*i)->Handle(arg);
@@ -69,7 +74,7 @@ void BlendCanvas::Handle(Display::ProcessEventArg arg) {
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
     
     Vector<4,int> d(0, 0, arg.canvas.GetWidth(), arg.canvas.GetHeight());
-    glViewport((GLsizei)d[0], (GLsizei)d[1], (GLsizei)d[2], (GLsizei)d[3]);
+    GLStateCache::Viewport((GLsizei)d[0], (GLsizei)d[1], (GLsizei)d[2], (GLsizei)d[3]);
     OrthogonalViewingVolume volume(-1, 1, 0, arg.canvas.GetWidth(), 0, arg.canvas.GetHeight());
 
     // Select The Projection Matrix
@@ -104,21 +109,21 @@ void BlendCanvas::Handle(Display::ProcessEventArg arg) {
     glMultMatrixf(f);
     CHECK_FOR_GL_ERROR();
         
-    GLboolean depth = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean lighting = glIsEnabled(GL_LIGHTING);
-    GLboolean blending = glIsEnabled(GL_BLEND);
-    GLboolean texture = glIsEnabled(GL_TEXTURE_2D);
+    GLboolean depth = GLStateCache::IsEnabled(GL_DEPTH_TEST);
+    GLboolean lighting = GLStateCache::IsEnabled(GL_LIGHTING);
+    GLboolean blending = GLStateCache::IsEnabled(GL_BLEND);
+    GLboolean texture = GLStateCache::IsEnabled(GL_TEXTURE_2D);
     GLint texenv;
     glGetTexEnviv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, &texenv);
     // glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glDisable(GL_BLEND);
-    glEnable(GL_TEXTURE_2D);
+    GLStateCache::Disable(GL_DEPTH_TEST);
+    GLStateCache::Disable(GL_LIGHTING);
+    GLStateCache::Disable(GL_BLEND);
+    GLStateCache::Enable(GL_TEXTURE_2D);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLStateCache::Enable(GL_BLEND);
+    GLStateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         
     list<Element>::iterator itr = elements.begin();
     for (; itr != elements.end(); ++itr) {
@@ -130,7 +135,7 @@ void BlendCanvas::Handle(Display::ProcessEventArg arg) {
         int w = tex->GetWidth();
         int h = tex->GetHeight();
             
-        glBindTexture(GL_TEXTURE_2D, tex->GetID());
+        GLStateCache::BindTexture(GL_TEXTURE_2D, tex->GetID());
         CHECK_FOR_GL_ERROR();
         glColor4f(e.color[0],e.color[1], e.color[2], e.color[3]);
         glBegin(GL_QUADS);
@@ -145,7 +150,7 @@ void BlendCanvas::Handle(Display::ProcessEventArg arg) {
         glEnd();
     }
 
-    glDisable(GL_BLEND);
+    GLStateCache::Disable(GL_BLEND);
  
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
@@ -154,10 +159,10 @@ void BlendCanvas::Handle(Display::ProcessEventArg arg) {
     glPopMatrix();
     CHECK_FOR_GL_ERROR();
     glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, texenv);
-    if (depth)    glEnable(GL_DEPTH_TEST);
-    if (lighting) glEnable(GL_LIGHTING);
-    if (blending) glEnable(GL_BLEND);
-    if (!texture) glDisable(GL_TEXTURE_2D);
+    if (depth)    GLStateCache::Enable(GL_DEPTH_TEST);
+    if (lighting) GLStateCache::Enable(GL_LIGHTING);
+    if (blending) GLStateCache::Enable(GL_BLEND);
+    if (!texture) GLStateCache::Disable(GL_TEXTURE_2D);
 
     backend->Post();
 }
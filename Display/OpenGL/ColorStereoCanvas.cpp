@@ -13,11 +13,14 @@
 #include <Display/ViewingVolume.h>
 #include <Display/OrthogonalViewingVolume.h>
 #include <Meta/OpenGL.h>
+#include <Renderers/OpenGL/GLStateCache.h>
 
 namespace OpenEngine {
 namespace Display {
 namespace OpenGL {
 
+using Renderers::OpenGL::GLStateCache;
+
 ColorStereoCanvas::ColorStereoCanvas(ICanvasBackend* backend)
     : IRenderCanvas(backend)
     , dummyCam(new ViewingVolume())
@@ -46,6 +49,9 @@ void ColorStereoCanvas::Handle(Display::InitializeEventArg arg) {
 }
 
 void ColorStereoCanvas::Handle(Display::ProcessEventArg arg) {
+    // The gl state may have been changed outside the cache since
+    // the last frame.
+    GLStateCache::Invalidate();
     backend->Pre();
     stereoCam->SignalRendering(arg.approx);
     ((IListener<Display::ProcessEventArg>*)left)->Handle(arg);
@@ -55,7 +61,7 @@ void ColorStereoCanvas::Handle(Display::ProcessEventArg arg) {
     unsigned int height = GetHeight();
 
     Vector<4,int> d(0, 0, width, height);
-    glViewport((GLsizei)d[0], (GLsizei)d[1], (GLsizei)d[2], (GLsizei)d[3]);
+    GLStateCache::Viewport((GLsizei)d[0], (GLsizei)d[1], (GLsizei)d[2], (GLsizei)d[3]);
     OrthogonalViewingVolume volume(-1, 1, 0, width, 0, height);
 
     // Select The Projection Matrix
@@ -90,14 +96,14 @@ void ColorStereoCanvas::Handle(Display::ProcessEventArg arg) {
     glMultMatrixf(f);
     CHECK_FOR_GL_ERROR();
         
-    bool depth = glIsEnabled(GL_DEPTH_TEST);
-    GLboolean lighting = glIsEnabled(GL_LIGHTING);
-    GLboolean blending = glIsEnabled(GL_BLEND);
-    GLboolean texture = glIsEnabled(GL_TEXTURE_2D);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_LIGHTING);
-    glDisable(GL_BLEND);
-    glEnable(GL_TEXTURE_2D);
+    bool depth = GLStateCache::IsEnabled(GL_DEPTH_TEST);
+    GLboolean lighting = GLStateCache::IsEnabled(GL_LIGHTING);
+    GLboolean blending = GLStateCache::IsEnabled(GL_BLEND);
+    GLboolean texture = GLStateCache::IsEnabled(GL_TEXTURE_2D);
+    GLStateCache::Disable(GL_DEPTH_TEST);
+    GLStateCache::Disable(GL_LIGHTING);
+    GLStateCache::Disable(GL_BLEND);
+    GLStateCache::Enable(GL_TEXTURE_2D);
     GLint texenv;
     glGetTexEnviv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, &texenv);
     glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
@@ -112,7 +118,7 @@ void ColorStereoCanvas::Handle(Display::ProcessEventArg arg) {
     // glBlendColor(1.0,0.0,0.0,1.0);
     // glBlendFunc(GL_ZERO, GL_CONSTANT_COLOR);
 
-    glBindTexture(GL_TEXTURE_2D, left->GetTexture()->GetID());
+    GLStateCache::BindTexture(GL_TEXTURE_2D, left->GetTexture()->GetID());
     CHECK_FOR_GL_ERROR();
     glBegin(GL_QUADS);
     // glColor4f(1.0,.0,0.0,.5);
@@ -132,7 +138,7 @@ void ColorStereoCanvas::Handle(Display::ProcessEventArg arg) {
     // glBlendFunc(GL_SRC_ALPHA, GL_SRC_ALPHA);
     // glBlendEquation(GL_FUNC_ADD);
     glColorMask (GL_FALSE, GL_TRUE, GL_TRUE, GL_FALSE);
-    glBindTexture(GL_TEXTURE_2D, right->GetTexture()->GetID());
+    GLStateCache::BindTexture(GL_TEXTURE_2D, right->GetTexture()->GetID());
     CHECK_FOR_GL_ERROR();
     glBegin(GL_QUADS);
       //glColor4f(0.0,1.0,1.0,1.0);
@@ -146,7 +152,7 @@ void ColorStereoCanvas::Handle(Display::ProcessEventArg arg) {
       glVertex3f(width, height, z);
     glEnd();
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
     glColorMask (GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
     glMatrixMode(GL_PROJECTION);
@@ -157,10 +163,10 @@ void ColorStereoCanvas::Handle(Display::ProcessEventArg arg) {
     CHECK_FOR_GL_ERROR();
         
     glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, texenv);
-    if (depth)    glEnable(GL_DEPTH_TEST);
-    if (lighting) glEnable(GL_LIGHTING);
-    if (blending) glEnable(GL_BLEND);
-    if (!texture) glDisable(GL_TEXTURE_2D);
+    if (depth)    GLStateCache::Enable(GL_DEPTH_TEST);
+    if (lighting) GLStateCache::Enable(GL_LIGHTING);
+    if (blending) GLStateCache::Enable(GL_BLEND);
+    if (!texture) GLStateCache::Disable(GL_TEXTURE_2D);
 
     backend->Post();
 }
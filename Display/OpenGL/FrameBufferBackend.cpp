@@ -10,12 +10,14 @@
 #include <Display/OpenGL/FrameBufferBackend.h>
 #include <Renderers/IRenderer.h>
 #include <Resources/FrameBuffer.h>
+#include <Renderers/OpenGL/GLStateCache.h>
 #include <Logging/Logger.h>
 
 namespace OpenEngine {
     using namespace Math;
     using namespace Renderers;
     using namespace Resources;
+    using Renderers::OpenGL::GLStateCache;
 namespace Display {
 namespace OpenGL {
 
@@ -30,6 +32,7 @@ namespace OpenGL {
     }
 
     void FrameBufferBackend::Init(unsigned int width, unsigned int height){
+        GLStateCache::Invalidate();
         if (fb == NULL)
             fb = new FrameBuffer(Vector<2, int>(width, height), 1, true);
 
@@ -41,15 +44,18 @@ namespace OpenGL {
     }
 
     void FrameBufferBackend::Pre(){
-        glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &prevFb);
-        glGetIntegerv(GL_VIEWPORT, prevDims.ToArray());
+        // Query the previous frame buffer and viewport from the
+        // driver, they may have been set outside the cache.
+        GLStateCache::Invalidate();
+        prevFb = GLStateCache::GetFramebuffer();
+        prevDims = GLStateCache::GetViewport();
 
-        glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fb->GetID());
+        GLStateCache::BindFramebuffer(GL_FRAMEBUFFER_EXT, fb->GetID());
         CHECK_FOR_GL_ERROR();
     }
 
     void FrameBufferBackend::Post(){
-        glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, prevFb);
+        GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER_EXT, prevFb);
 
         Vector<2, int> dims = fb->GetDimension();
         glBlitFramebufferEXT(prevDims[0], prevDims[1], prevDims[2], prevDims[3], 
@@ -59,7 +65,7 @@ namespace OpenGL {
 			     0, 0, dims[0], dims[1], 
 			     GL_DEPTH_BUFFER_BIT, GL_NEAREST);
 
-        glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, prevFb);
+        GLStateCache::BindFramebuffer(GL_FRAMEBUFFER_EXT, prevFb);
         CHECK_FOR_GL_ERROR();
     }
 
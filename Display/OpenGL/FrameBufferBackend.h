@@ -28,7 +28,7 @@ class FrameBufferBackend : public ICanvasBackend {
 private:
     Renderers::IRenderer* renderer; // ugly stuff to avoid writing explicit FBO loading code. A ya ya.
 
-    GLint prevFb;
+    GLuint prevFb;
     Math::Vector<4, GLint> prevDims;
     
     Resources::FrameBuffer* fb;
@@ -13,6 +13,7 @@
 #include <Math/Matrix.h>
 #include <Math/Vector.h>
 #include <Meta/OpenGL.h>
+#include <Renderers/OpenGL/GLStateCache.h>
 #include <Logging/Logger.h>
 
 namespace OpenEngine {
@@ -20,6 +21,7 @@ namespace Display {
 namespace OpenGL {
     using Math::Matrix;
     using Math::Vector;
+    using Renderers::OpenGL::GLStateCache;
 
     SplitScreenCanvas::SplitScreenCanvas(ICanvasBackend* backend, ICanvas& first, ICanvas& second, Split split, float firstPercentage)
         : ICanvas(backend)
@@ -84,12 +86,15 @@ namespace OpenGL {
     }
 
     void SplitScreenCanvas::Handle(Display::ProcessEventArg arg) {
+        // The gl state may have been changed outside the cache since
+        // the last frame.
+        GLStateCache::Invalidate();
         ((IListener<Display::ProcessEventArg>&)first).Handle(arg);
         ((IListener<Display::ProcessEventArg>&)second).Handle(arg);
 
         backend->Pre();
         Vector<4,int> d(0, 0, arg.canvas.GetWidth(), arg.canvas.GetHeight());
-        glViewport((GLsizei)d[0], (GLsizei)d[1], (GLsizei)d[2], (GLsizei)d[3]);
+        GLStateCache::Viewport((GLsizei)d[0], (GLsizei)d[1], (GLsizei)d[2], (GLsizei)d[3]);
         OrthogonalViewingVolume volume(-1, 1, 0, arg.canvas.GetWidth(), 0, arg.canvas.GetHeight());
 
         // Select The Projection Matrix
@@ -124,20 +129,20 @@ namespace OpenGL {
         glMultMatrixf(f);
         CHECK_FOR_GL_ERROR();
         
-        GLboolean depth = glIsEnabled(GL_DEPTH_TEST);
-        GLboolean lighting = glIsEnabled(GL_LIGHTING);
-        GLboolean blending = glIsEnabled(GL_BLEND);
-        GLboolean texture = glIsEnabled(GL_TEXTURE_2D);
+        GLboolean depth = GLStateCache::IsEnabled(GL_DEPTH_TEST);
+        GLboolean lighting = GLStateCache::IsEnabled(GL_LIGHTING);
+        GLboolean blending = GLStateCache::IsEnabled(GL_BLEND);
+        GLboolean texture = GLStateCache::IsEnabled(GL_TEXTURE_2D);
         GLint texenv;
         glGetTexEnviv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, &texenv);
         glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_LIGHTING);
-        glDisable(GL_BLEND);
-        glEnable(GL_TEXTURE_2D);
+        GLStateCache::Disable(GL_DEPTH_TEST);
+        GLStateCache::Disable(GL_LIGHTING);
+        GLStateCache::Disable(GL_BLEND);
+        GLStateCache::Enable(GL_TEXTURE_2D);
 
-        glBindTexture(GL_TEXTURE_2D, first.GetTexture()->GetID());
+        GLStateCache::BindTexture(GL_TEXTURE_2D, first.GetTexture()->GetID());
         CHECK_FOR_GL_ERROR();
         const unsigned int z = 0;
         glBegin(GL_QUADS);
@@ -151,7 +156,7 @@ namespace OpenGL {
         glVertex3i(first.GetWidth(), first.GetHeight(), z);
         glEnd();
 
-        glBindTexture(GL_TEXTURE_2D, second.GetTexture()->GetID());
+        GLStateCache::BindTexture(GL_TEXTURE_2D, second.GetTexture()->GetID());
         CHECK_FOR_GL_ERROR();
         glBegin(GL_QUADS);
         glTexCoord2f(0.0, 0.0);
@@ -164,7 +169,7 @@ namespace OpenGL {
         glVertex3i(GetWidth(), GetHeight(), z);
         glEnd();
 
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
  
         glMatrixMode(GL_PROJECTION);
         glPopMatrix();
@@ -173,10 +178,10 @@ namespace OpenGL {
         glPopMatrix();
         CHECK_FOR_GL_ERROR();
         glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, texenv);
-        if (depth)    glEnable(GL_DEPTH_TEST);
-        if (lighting) glEnable(GL_LIGHTING);
-        if (blending) glEnable(GL_BLEND);
-        if (!texture) glDisable(GL_TEXTURE_2D);
+        if (depth)    GLStateCache::Enable(GL_DEPTH_TEST);
+        if (lighting) GLStateCache::Enable(GL_LIGHTING);
+        if (blending) GLStateCache::Enable(GL_BLEND);
+        if (!texture) GLStateCache::Disable(GL_TEXTURE_2D);
 
         backend->Post();
     }
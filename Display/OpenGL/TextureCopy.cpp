@@ -9,6 +9,7 @@
 
 #include <Display/OpenGL/TextureCopy.h>
 #include <Meta/OpenGL.h>
+#include <Renderers/OpenGL/GLStateCache.h>
 
 #include <Logging/Logger.h>
 
@@ -17,6 +18,7 @@ namespace Display {
 namespace OpenGL {
 
 using namespace Resources;
+using Renderers::OpenGL::GLStateCache;
 
 GLint GLInternalColorFormat(ColorFormat f){
     switch (f) {
@@ -102,7 +104,7 @@ void TextureCopy::Init(const unsigned int width, const unsigned int height) {
     ctex->height = height;
     glGenTextures(1, &ctex->id);
     CHECK_FOR_GL_ERROR();
-    glBindTexture(GL_TEXTURE_2D, ctex->id);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, ctex->id);
     CHECK_FOR_GL_ERROR();
     GLenum colorFormat = GLColorFormat(ctex->GetColorFormat());
     GLenum internalFormat = GLInternalColorFormat(ctex->GetColorFormat());
@@ -114,7 +116,7 @@ void TextureCopy::Init(const unsigned int width, const unsigned int height) {
                  ctex->width, ctex->height, 0, colorFormat, 
                  ctex->GetType(), NULL);
     CHECK_FOR_GL_ERROR();
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void TextureCopy::Deinit() {
@@ -127,11 +129,11 @@ void TextureCopy::Pre() {
 
 void TextureCopy::Post() {
     GLenum colorFormat = GLColorFormat(ctex->GetColorFormat());
-    glBindTexture(GL_TEXTURE_2D, ctex->id);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, ctex->id);
     CHECK_FOR_GL_ERROR();
     glCopyTexImage2D(GL_TEXTURE_2D, 0, colorFormat, 0, 0, ctex->width, ctex->height, 0);
     CHECK_FOR_GL_ERROR();
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
     CHECK_FOR_GL_ERROR();
 }
     
@@ -140,7 +142,7 @@ void TextureCopy::SetDimensions(const unsigned int width, const unsigned int hei
     ctex->height = height;
     if (ctex->id == (unsigned int)-1) return;
     //! @todo: update the texture
-    glBindTexture(GL_TEXTURE_2D, ctex->id);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, ctex->id);
     CHECK_FOR_GL_ERROR();
     GLenum colorFormat = GLColorFormat(ctex->GetColorFormat());
     GLenum internalFormat = GLInternalColorFormat(ctex->GetColorFormat());
@@ -148,7 +150,7 @@ void TextureCopy::SetDimensions(const unsigned int width, const unsigned int hei
                  ctex->width, ctex->height, 0, colorFormat, 
                  ctex->GetType(), NULL);
     CHECK_FOR_GL_ERROR();
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 ICanvasBackend* TextureCopy::Clone() {
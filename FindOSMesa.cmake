@@ -0,0 +1,40 @@
+# - Try to find OSMesa, the Mesa off-screen rendering interface
+# Once done this will define
+#
+#  OSMESA_FOUND - system has OSMesa
+#  OSMESA_INCLUDE_DIR - the OSMesa include directory
+#  OSMESA_LIBRARIES - Link these to use OSMesa
+#
+
+FIND_PATH(OSMESA_INCLUDE_DIR NAMES GL/osmesa.h
+  PATHS
+  ${PROJECT_BINARY_DIR}/include
+  ${PROJECT_SOURCE_DIR}/include
+  ENV CPATH
+  /usr/include
+  /usr/local/include
+  /opt/local/include
+  NO_DEFAULT_PATH
+)
+
+FIND_LIBRARY(OSMESA_LIBRARIES NAMES
+  OSMesa OSMesa32
+  PATHS
+  ${PROJECT_BINARY_DIR}/lib
+  ${PROJECT_SOURCE_DIR}/lib
+  ENV LD_LIBRARY_PATH
+  ENV LIBRARY_PATH
+  /usr/lib
+  /usr/local/lib
+  /opt/local/lib
+  NO_DEFAULT_PATH
+)
+
+IF(OSMESA_INCLUDE_DIR AND OSMESA_LIBRARIES)
+   SET(OSMESA_FOUND TRUE)
+ENDIF(OSMESA_INCLUDE_DIR AND OSMESA_LIBRARIES)
+
+# show the OSMESA_INCLUDE_DIR and OSMESA_LIBRARIES variables only in the advanced view
+IF(OSMESA_FOUND)
+  MARK_AS_ADVANCED(OSMESA_INCLUDE_DIR OSMESA_LIBRARIES )
+ENDIF(OSMESA_FOUND)
@@ -47,6 +47,75 @@ using std::string;
 #define GL_R32F 0x822E
 #endif
 
+/**
+ * With OE_TRACE_GL the OpenGL 1.1 calls recorded by the GLTracer
+ * go through these pointers. The other traced calls are GLEW
+ * pointers already. OE_GL_TRACER is defined by the tracer itself to
+ * reach the real functions.
+ */
+#if OE_TRACE_GL
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+struct GLCoreHooks {
+    static void (GLAPIENTRY *Enable)(GLenum cap);
+    static void (GLAPIENTRY *Disable)(GLenum cap);
+    static void (GLAPIENTRY *BindTexture)(GLenum target, GLuint texture);
+    static void (GLAPIENTRY *Viewport)(GLint x, GLint y, GLsizei width, GLsizei height);
+    static void (GLAPIENTRY *Clear)(GLbitfield mask);
+    static void (GLAPIENTRY *DrawElements)(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices);
+    static void (GLAPIENTRY *DrawArrays)(GLenum mode, GLint first, GLsizei count);
+    static void (GLAPIENTRY *BlendFunc)(GLenum sfactor, GLenum dfactor);
+    static void (GLAPIENTRY *DepthFunc)(GLenum func);
+    static void (GLAPIENTRY *EnableClientState)(GLenum array);
+    static void (GLAPIENTRY *DisableClientState)(GLenum array);
+    static void (GLAPIENTRY *VertexPointer)(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+    static void (GLAPIENTRY *NormalPointer)(GLenum type, GLsizei stride, const GLvoid* pointer);
+    static void (GLAPIENTRY *ColorPointer)(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+    static void (GLAPIENTRY *TexCoordPointer)(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer);
+    static void (GLAPIENTRY *MatrixMode)(GLenum mode);
+    static void (GLAPIENTRY *PushMatrix)();
+    static void (GLAPIENTRY *PopMatrix)();
+    static void (GLAPIENTRY *LoadIdentity)();
+    static void (GLAPIENTRY *LoadMatrixf)(const GLfloat* m);
+    static void (GLAPIENTRY *MultMatrixf)(const GLfloat* m);
+    static void (GLAPIENTRY *TexImage2D)(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                                         GLint border, GLenum format, GLenum type, const GLvoid* pixels);
+    static void (GLAPIENTRY *Lightf)(GLenum light, GLenum name, GLfloat value);
+    static void (GLAPIENTRY *Lightfv)(GLenum light, GLenum name, const GLfloat* values);
+};
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#ifndef OE_GL_TRACER
+#define glEnable(cap) OpenEngine::Renderers::OpenGL::GLCoreHooks::Enable(cap)
+#define glDisable(cap) OpenEngine::Renderers::OpenGL::GLCoreHooks::Disable(cap)
+#define glBindTexture(target, texture) OpenEngine::Renderers::OpenGL::GLCoreHooks::BindTexture(target, texture)
+#define glViewport(x, y, w, h) OpenEngine::Renderers::OpenGL::GLCoreHooks::Viewport(x, y, w, h)
+#define glClear(mask) OpenEngine::Renderers::OpenGL::GLCoreHooks::Clear(mask)
+#define glDrawElements(mode, count, type, indices) OpenEngine::Renderers::OpenGL::GLCoreHooks::DrawElements(mode, count, type, indices)
+#define glDrawArrays(mode, first, count) OpenEngine::Renderers::OpenGL::GLCoreHooks::DrawArrays(mode, first, count)
+#define glBlendFunc(s, d) OpenEngine::Renderers::OpenGL::GLCoreHooks::BlendFunc(s, d)
+#define glDepthFunc(func) OpenEngine::Renderers::OpenGL::GLCoreHooks::DepthFunc(func)
+#define glEnableClientState(array) OpenEngine::Renderers::OpenGL::GLCoreHooks::EnableClientState(array)
+#define glDisableClientState(array) OpenEngine::Renderers::OpenGL::GLCoreHooks::DisableClientState(array)
+#define glVertexPointer(size, type, stride, p) OpenEngine::Renderers::OpenGL::GLCoreHooks::VertexPointer(size, type, stride, p)
+#define glNormalPointer(type, stride, p) OpenEngine::Renderers::OpenGL::GLCoreHooks::NormalPointer(type, stride, p)
+#define glColorPointer(size, type, stride, p) OpenEngine::Renderers::OpenGL::GLCoreHooks::ColorPointer(size, type, stride, p)
+#define glTexCoordPointer(size, type, stride, p) OpenEngine::Renderers::OpenGL::GLCoreHooks::TexCoordPointer(size, type, stride, p)
+#define glMatrixMode(mode) OpenEngine::Renderers::OpenGL::GLCoreHooks::MatrixMode(mode)
+#define glPushMatrix() OpenEngine::Renderers::OpenGL::GLCoreHooks::PushMatrix()
+#define glPopMatrix() OpenEngine::Renderers::OpenGL::GLCoreHooks::PopMatrix()
+#define glLoadIdentity() OpenEngine::Renderers::OpenGL::GLCoreHooks::LoadIdentity()
+#define glLoadMatrixf(m) OpenEngine::Renderers::OpenGL::GLCoreHooks::LoadMatrixf(m)
+#define glMultMatrixf(m) OpenEngine::Renderers::OpenGL::GLCoreHooks::MultMatrixf(m)
+#define glTexImage2D(target, level, internal, w, h, border, format, type, p) OpenEngine::Renderers::OpenGL::GLCoreHooks::TexImage2D(target, level, internal, w, h, border, format, type, p)
+#define glLightf(light, name, value) OpenEngine::Renderers::OpenGL::GLCoreHooks::Lightf(light, name, value)
+#define glLightfv(light, name, values) OpenEngine::Renderers::OpenGL::GLCoreHooks::Lightfv(light, name, values)
+#endif
+#endif
+
 
 /**
  *  Should never be used in the code, use CHECK_FOR_GL_ERROR(); instead
@@ -108,12 +177,24 @@ inline void CHECK_FRAMEBUFFER_STATUS(const std::string file, const int line) {
 /**
  *  Checks for Open GL errors and throws an exception if
  *  an error was detected, is only available in debug mode.
+ *  With OE_CHECK_GL errors are checked once per rendering phase and
+ *  the call sites are only checked in the frame after an error, see
+ *  GLErrorCheck.
  *  NOTE: This call must not be used between calls to glBegin and
  *  glEnd. 
  */
 #if OE_DEBUG_GL
 #define CHECK_FOR_GL_ERROR(); CHECK_FOR_GL_ERROR(__FILE__,__LINE__);
 #define CHECK_FRAMEBUFFER_STATUS(); CHECK_FRAMEBUFFER_STATUS(__FILE__,__LINE__);
+#elif OE_CHECK_GL
+#include <Renderers/OpenGL/GLErrorCheck.h>
+// a single statement, also as the body of an if with an else
+#define CHECK_FOR_GL_ERROR() \
+    do { \
+        if (OpenEngine::Renderers::OpenGL::GLErrorCheck::IsDiagnosing()) \
+            OpenEngine::Renderers::OpenGL::GLErrorCheck::CheckSite(__FILE__,__LINE__); \
+    } while (0)
+#define CHECK_FRAMEBUFFER_STATUS();
 #else
 #define CHECK_FOR_GL_ERROR();
 #define CHECK_FRAMEBUFFER_STATUS();
@@ -0,0 +1,67 @@
+// OpenGL bindless texture handles.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/BindlessTextures.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+std::map<GLuint, GLuint64> BindlessTextures::handles;
+
+bool BindlessTextures::IsSupported() {
+    return GLEW_ARB_bindless_texture;
+}
+
+/**
+ * The resident handle of a texture, created on first use.
+ */
+GLuint64 BindlessTextures::GetHandle(GLuint texture) {
+    std::map<GLuint, GLuint64>::iterator itr = handles.find(texture);
+    if (itr != handles.end()) return itr->second;
+    GLuint64 handle = glGetTextureHandleARB(texture);
+    glMakeTextureHandleResidentARB(handle);
+    CHECK_FOR_GL_ERROR();
+    handles[texture] = handle;
+    return handle;
+}
+
+/**
+ * True if a handle was created for the texture, after which its
+ * storage and sampling parameters are immutable.
+ */
+bool BindlessTextures::HasHandle(GLuint texture) {
+    return handles.find(texture) != handles.end();
+}
+
+/**
+ * Make the handle of a texture non resident. Must be called before
+ * the texture is deleted.
+ */
+void BindlessTextures::Forget(GLuint texture) {
+    std::map<GLuint, GLuint64>::iterator itr = handles.find(texture);
+    if (itr == handles.end()) return;
+    glMakeTextureHandleNonResidentARB(itr->second);
+    handles.erase(itr);
+}
+
+void BindlessTextures::Clear() {
+    std::map<GLuint, GLuint64>::iterator itr = handles.begin();
+    for (; itr != handles.end(); ++itr)
+        glMakeTextureHandleNonResidentARB(itr->second);
+    handles.clear();
+}
+
+unsigned int BindlessTextures::GetResidentCount() {
+    return handles.size();
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
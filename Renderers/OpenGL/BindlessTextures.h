@@ -0,0 +1,51 @@
+// OpenGL bindless texture handles.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_BINDLESS_TEXTURES_H_
+#define _OPENGL_BINDLESS_TEXTURES_H_
+
+#include <Meta/OpenGL.h>
+#include <map>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Resident texture handles of GL_ARB_bindless_texture.
+ *
+ * A handle is created and made resident the first time a texture is
+ * used bindless and stays resident until the texture is forgotten.
+ * Shaders reading textures through handles set their sampler
+ * uniforms to the handle instead of a texture unit, so drawing with
+ * them needs no texture binds at all.
+ *
+ * Once a handle exists the sampling parameters of the texture can no
+ * longer be changed, its contents can.
+ *
+ * @class BindlessTextures BindlessTextures.h Renderers/OpenGL/BindlessTextures.h
+ */
+class BindlessTextures {
+private:
+    static std::map<GLuint, GLuint64> handles;
+
+public:
+    static bool IsSupported();
+    static GLuint64 GetHandle(GLuint texture);
+    static bool HasHandle(GLuint texture);
+    static void Forget(GLuint texture);
+    static void Clear();
+    static unsigned int GetResidentCount();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_BINDLESS_TEXTURES_H_
@@ -0,0 +1,119 @@
+// View frustum and bounding sphere.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/Frustum.h>
+#include <cmath>
+#include <algorithm>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+BoundingSphere::BoundingSphere()
+    : center(0.0f), radius(0.0f), empty(true), infinite(false) {}
+
+BoundingSphere::BoundingSphere(Vector<3, float> center, float radius)
+    : center(center), radius(radius), empty(false), infinite(false) {}
+
+BoundingSphere BoundingSphere::Infinite() {
+    BoundingSphere s;
+    s.empty = false;
+    s.infinite = true;
+    return s;
+}
+
+/**
+ * Grow the sphere to also enclose other.
+ */
+void BoundingSphere::Expand(const BoundingSphere& other) {
+    if (infinite || other.empty) return;
+    if (empty || other.infinite) {
+        *this = other;
+        return;
+    }
+    Vector<3, float> d = other.center - center;
+    float dist = d.GetLength();
+    if (dist + other.radius <= radius) return;
+    if (dist + radius <= other.radius) {
+        *this = other;
+        return;
+    }
+    float r = (dist + radius + other.radius) * 0.5f;
+    center = center + d * ((r - radius) / dist);
+    radius = r;
+}
+
+/**
+ * Transform the sphere by an affine matrix. Non-uniform scaling is
+ * handled by scaling the radius with the largest axis scale.
+ */
+BoundingSphere BoundingSphere::Transform(Matrix<4, 4, float> m) const {
+    if (empty || infinite) return *this;
+    float f[16];
+    m.ToArray(f);
+    Vector<3, float> c(f[0] * center[0] + f[4] * center[1] + f[8] * center[2] + f[12],
+                       f[1] * center[0] + f[5] * center[1] + f[9] * center[2] + f[13],
+                       f[2] * center[0] + f[6] * center[1] + f[10] * center[2] + f[14]);
+    float sx = f[0] * f[0] + f[1] * f[1] + f[2] * f[2];
+    float sy = f[4] * f[4] + f[5] * f[5] + f[6] * f[6];
+    float sz = f[8] * f[8] + f[9] * f[9] + f[10] * f[10];
+    float scale = std::sqrt(std::max(sx, std::max(sy, sz)));
+    return BoundingSphere(c, radius * scale);
+}
+
+Frustum::Frustum() {}
+
+Frustum::Frustum(Matrix<4, 4, float> m) {
+    SetMatrix(m);
+}
+
+/**
+ * Extract the frustum planes from a matrix in the OpenGL clip
+ * space convention. The planes point inwards and are normalized,
+ * so plane distances are true distances.
+ */
+void Frustum::SetMatrix(Matrix<4, 4, float> m) {
+    float f[16];
+    m.ToArray(f);
+    // rows of the column major matrix
+    Vector<4, float> row[4];
+    for (unsigned int i = 0; i < 4; ++i)
+        row[i] = Vector<4, float>(f[i], f[4 + i], f[8 + i], f[12 + i]);
+
+    planes[0] = row[3] + row[0]; // left
+    planes[1] = row[3] - row[0]; // right
+    planes[2] = row[3] + row[1]; // bottom
+    planes[3] = row[3] - row[1]; // top
+    planes[4] = row[3] + row[2]; // near
+    planes[5] = row[3] - row[2]; // far
+
+    for (unsigned int i = 0; i < 6; ++i) {
+        Vector<4, float> p = planes[i];
+        float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        if (len > 0.0f) planes[i] = p * (1.0f / len);
+    }
+}
+
+Frustum::Result Frustum::Test(const BoundingSphere& sphere) const {
+    if (sphere.infinite) return INTERSECTING;
+    if (sphere.empty) return OUTSIDE;
+    Result result = INSIDE;
+    const Vector<3, float>& c = sphere.center;
+    for (unsigned int i = 0; i < 6; ++i) {
+        const Vector<4, float>& p = planes[i];
+        float dist = p[0] * c[0] + p[1] * c[1] + p[2] * c[2] + p[3];
+        if (dist < -sphere.radius) return OUTSIDE;
+        if (dist < sphere.radius) result = INTERSECTING;
+    }
+    return result;
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
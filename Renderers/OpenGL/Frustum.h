@@ -0,0 +1,66 @@
+// View frustum and bounding sphere.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_FRUSTUM_H_
+#define _OPENGL_FRUSTUM_H_
+
+#include <Math/Vector.h>
+#include <Math/Matrix.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+using OpenEngine::Math::Vector;
+using OpenEngine::Math::Matrix;
+
+/**
+ * Bounding sphere. An empty sphere bounds nothing, an infinite
+ * sphere bounds everything.
+ */
+struct BoundingSphere {
+    Vector<3, float> center;
+    float radius;
+    bool empty, infinite;
+
+    BoundingSphere();
+    BoundingSphere(Vector<3, float> center, float radius);
+    static BoundingSphere Infinite();
+
+    void Expand(const BoundingSphere& other);
+    BoundingSphere Transform(Matrix<4, 4, float> m) const;
+};
+
+/**
+ * View frustum given by six planes, used for culling bounding
+ * spheres. The planes are extracted from a projection matrix (or a
+ * combined model view projection matrix), so the spheres must be
+ * given in the space the matrix maps from.
+ *
+ * @class Frustum Frustum.h Renderers/OpenGL/Frustum.h
+ */
+class Frustum {
+public:
+    enum Result { OUTSIDE, INTERSECTING, INSIDE };
+private:
+    Vector<4, float> planes[6];
+public:
+    Frustum();
+    Frustum(Matrix<4, 4, float> m);
+
+    void SetMatrix(Matrix<4, 4, float> m);
+    Result Test(const BoundingSphere& sphere) const;
+    Vector<4, float> GetPlane(unsigned int i) const { return planes[i]; }
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_FRUSTUM_H_
@@ -0,0 +1,106 @@
+// OpenGL error checking at frame granularity.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/GLErrorCheck.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Meta/OpenGL.h>
+#include <Logging/Logger.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+bool GLErrorCheck::diagnosing = false;
+bool GLErrorCheck::diagnoseNext = false;
+unsigned int GLErrorCheck::errors = 0;
+unsigned int GLErrorCheck::siteErrors = 0;
+
+// errors are sticky, but a lost context reports them forever
+static const unsigned int MAX_ERRORS = 16;
+
+static void GLAPIENTRY DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                     GLsizei length, const GLchar* message, const void* user) {
+    logger.error << "OpenGL debug: " << message << logger.end;
+    GLErrorCheck::Diagnose();
+}
+
+bool GLErrorCheck::Check(const std::string& phase) {
+    bool clean = true;
+    for (unsigned int i = 0; i < MAX_ERRORS; ++i) {
+        GLenum error = glGetError();
+        if (error == GL_NO_ERROR) break;
+        logger.error << "OpenGL error: "
+                     << (const char*)gluErrorString(error)
+                     << " in the " << phase << " phase" << logger.end;
+        ++errors;
+        clean = false;
+    }
+    if (!clean && !diagnosing) diagnoseNext = true;
+    return clean;
+}
+
+void GLErrorCheck::CheckSite(const char* file, int line) {
+    GLenum error = glGetError();
+    if (error == GL_NO_ERROR) return;
+    logger.error << "OpenGL error: "
+                 << (const char*)gluErrorString(error)
+                 << " at " << file << ":" << line << logger.end;
+    ++errors;
+    ++siteErrors;
+}
+
+/**
+ * Errors raised outside the renderer since the last frame are
+ * reported before the frame starts.
+ */
+void GLErrorCheck::BeginFrame() {
+    if (diagnoseNext) {
+        diagnosing = true;
+        diagnoseNext = false;
+        siteErrors = 0;
+        logger.info << "OpenGL: checking every call site this frame" << logger.end;
+    }
+    Check("pre-frame");
+}
+
+void GLErrorCheck::EndFrame() {
+    if (!diagnosing) return;
+    if (siteErrors == 0)
+        logger.info << "OpenGL: the error did not recur" << logger.end;
+    diagnosing = false;
+}
+
+bool GLErrorCheck::SetDebugOutput(bool enabled) {
+    if (!glewIsSupported("GL_VERSION_4_3") && !GLEW_KHR_debug)
+        return false;
+    if (enabled) {
+        // only report errors, the other messages are chatty
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_FALSE);
+        glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_ERROR, GL_DONT_CARE, 0, NULL, GL_TRUE);
+        // older GLEW versions declare the user parameter non const
+        glDebugMessageCallback((GLDEBUGPROC)DebugCallback, NULL);
+        GLStateCache::Enable(GL_DEBUG_OUTPUT);
+    } else {
+        GLStateCache::Disable(GL_DEBUG_OUTPUT);
+        glDebugMessageCallback(NULL, NULL);
+    }
+    return true;
+}
+
+void GLErrorCheck::Diagnose() {
+    diagnoseNext = true;
+}
+
+unsigned int GLErrorCheck::GetErrorCount() {
+    return errors;
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
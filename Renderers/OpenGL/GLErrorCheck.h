@@ -0,0 +1,76 @@
+// OpenGL error checking at frame granularity.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_GL_ERROR_CHECK_H_
+#define _OPENGL_GL_ERROR_CHECK_H_
+
+#include <string>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Error checking for builds with OE_CHECK_GL.
+ *
+ * Instead of querying the error state at every CHECK_FOR_GL_ERROR
+ * the renderer checks it once at each phase boundary. When an error
+ * is found the next frame is rendered in diagnostic mode, where
+ * every CHECK_FOR_GL_ERROR queries the error state and logs the
+ * source location of the error. Errors are logged, not thrown.
+ *
+ * Optionally errors are also reported by the driver through the
+ * GL_KHR_debug message callback, which does not synchronize with
+ * the gpu. Some drivers only report messages in debug contexts.
+ *
+ * @class GLErrorCheck GLErrorCheck.h Renderers/OpenGL/GLErrorCheck.h
+ */
+class GLErrorCheck {
+private:
+    static bool diagnosing, diagnoseNext;
+    static unsigned int errors, siteErrors;
+public:
+    static bool IsDiagnosing() { return diagnosing; }
+
+    /**
+     * Check the error state at a phase boundary.
+     *
+     * @return True if no error was found.
+     */
+    static bool Check(const std::string& phase);
+
+    /**
+     * Check the error state at a CHECK_FOR_GL_ERROR call site, used
+     * in diagnostic frames.
+     */
+    static void CheckSite(const char* file, int line);
+
+    static void BeginFrame();
+    static void EndFrame();
+
+    /**
+     * Report errors through the GL_KHR_debug callback, if
+     * supported. Must be called with a current context.
+     *
+     * @return True if the callback is in use.
+     */
+    static bool SetDebugOutput(bool enabled);
+
+    /**
+     * Render the next frame in diagnostic mode.
+     */
+    static void Diagnose();
+    static unsigned int GetErrorCount();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_GL_ERROR_CHECK_H_
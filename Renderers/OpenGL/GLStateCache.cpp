@@ -0,0 +1,439 @@
+// OpenGL state shadow cache.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/GLStateCache.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+std::map<GLStateCache::Capability, bool> GLStateCache::capabilities;
+std::map<GLStateCache::TextureTarget, GLuint> GLStateCache::textures;
+std::map<GLenum, GLuint> GLStateCache::buffers;
+bool GLStateCache::blendFuncKnown = false;
+bool GLStateCache::blendEquationKnown = false;
+bool GLStateCache::viewportKnown = false;
+bool GLStateCache::drawFboKnown = false;
+bool GLStateCache::readFboKnown = false;
+bool GLStateCache::activeTextureKnown = false;
+bool GLStateCache::programKnown = false;
+bool GLStateCache::vertexArrayKnown = false;
+GLenum GLStateCache::blendSrc = GL_ONE;
+GLenum GLStateCache::blendDst = GL_ZERO;
+GLenum GLStateCache::blendEquation = GL_FUNC_ADD;
+Vector<4, GLint> GLStateCache::viewport;
+GLuint GLStateCache::drawFbo = 0;
+GLuint GLStateCache::readFbo = 0;
+GLuint GLStateCache::program = 0;
+GLuint GLStateCache::vertexArray = 0;
+GLenum GLStateCache::activeTexture = GL_TEXTURE0;
+GLStateCache::Counters GLStateCache::counters = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+static std::map<GLenum, GLint> limits;
+
+/**
+ * Forget everything known about the current state. Every tracked
+ * state will be fetched from the driver again on its next query.
+ */
+void GLStateCache::Invalidate() {
+    capabilities.clear();
+    textures.clear();
+    buffers.clear();
+    blendFuncKnown = blendEquationKnown = viewportKnown = false;
+    drawFboKnown = readFboKnown = activeTextureKnown = programKnown = false;
+    vertexArrayKnown = false;
+}
+
+void GLStateCache::Enable(GLenum cap) {
+    SetCapability(cap, true);
+}
+
+void GLStateCache::Disable(GLenum cap) {
+    SetCapability(cap, false);
+}
+
+/**
+ * The cache key of a capability. The texture target and texture
+ * coordinate generation enables belong to the active texture unit.
+ */
+GLStateCache::Capability GLStateCache::GetCapability(GLenum cap) {
+    switch (cap) {
+    case GL_TEXTURE_1D:
+    case GL_TEXTURE_2D:
+    case GL_TEXTURE_3D:
+    case GL_TEXTURE_CUBE_MAP:
+    case GL_TEXTURE_RECTANGLE_ARB:
+    case GL_TEXTURE_GEN_S:
+    case GL_TEXTURE_GEN_T:
+    case GL_TEXTURE_GEN_R:
+    case GL_TEXTURE_GEN_Q:
+        return Capability(GetActiveTexture(), cap);
+    default:
+        return Capability(0, cap);
+    }
+}
+
+void GLStateCache::SetCapability(GLenum cap, bool enabled) {
+    Capability key = GetCapability(cap);
+    std::map<Capability, bool>::iterator itr = capabilities.find(key);
+    if (itr != capabilities.end() && itr->second == enabled) {
+        ++counters.filtered;
+        return;
+    }
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+    capabilities[key] = enabled;
+    ++counters.issued;
+}
+
+bool GLStateCache::IsEnabled(GLenum cap) {
+    Capability key = GetCapability(cap);
+    std::map<Capability, bool>::iterator itr = capabilities.find(key);
+    if (itr != capabilities.end()) {
+        ++counters.answered;
+        return itr->second;
+    }
+    bool enabled = glIsEnabled(cap) == GL_TRUE;
+    capabilities[key] = enabled;
+    ++counters.queried;
+    return enabled;
+}
+
+void GLStateCache::BlendFunc(GLenum source, GLenum destination) {
+    if (blendFuncKnown && blendSrc == source && blendDst == destination) {
+        ++counters.filtered;
+        return;
+    }
+    glBlendFunc(source, destination);
+    blendSrc = source;
+    blendDst = destination;
+    blendFuncKnown = true;
+    ++counters.issued;
+}
+
+void GLStateCache::GetBlendFunc(GLenum& source, GLenum& destination) {
+    if (!blendFuncKnown) {
+        GLint src, dst;
+        glGetIntegerv(GL_BLEND_SRC, &src);
+        glGetIntegerv(GL_BLEND_DST, &dst);
+        blendSrc = src;
+        blendDst = dst;
+        blendFuncKnown = true;
+        ++counters.queried;
+    } else ++counters.answered;
+    source = blendSrc;
+    destination = blendDst;
+}
+
+void GLStateCache::BlendEquation(GLenum equation) {
+    if (blendEquationKnown && blendEquation == equation) {
+        ++counters.filtered;
+        return;
+    }
+    glBlendEquationEXT(equation);
+    blendEquation = equation;
+    blendEquationKnown = true;
+    ++counters.issued;
+}
+
+GLenum GLStateCache::GetBlendEquation() {
+    if (!blendEquationKnown) {
+        GLint eq;
+        glGetIntegerv(GL_BLEND_EQUATION, &eq);
+        blendEquation = eq;
+        blendEquationKnown = true;
+        ++counters.queried;
+    } else ++counters.answered;
+    return blendEquation;
+}
+
+/**
+ * Bind a frame buffer object. Binding to GL_FRAMEBUFFER_EXT binds
+ * both the draw and the read frame buffer.
+ */
+void GLStateCache::BindFramebuffer(GLenum target, GLuint fbo) {
+    bool draw = target == GL_FRAMEBUFFER_EXT || target == GL_DRAW_FRAMEBUFFER_EXT;
+    bool read = target == GL_FRAMEBUFFER_EXT || target == GL_READ_FRAMEBUFFER_EXT;
+    if ((!draw || (drawFboKnown && drawFbo == fbo)) &&
+        (!read || (readFboKnown && readFbo == fbo))) {
+        ++counters.filtered;
+        return;
+    }
+    glBindFramebufferEXT(target, fbo);
+    if (draw) {
+        drawFbo = fbo;
+        drawFboKnown = true;
+    }
+    if (read) {
+        readFbo = fbo;
+        readFboKnown = true;
+    }
+    ++counters.issued;
+    ++counters.framebuffers;
+}
+
+GLuint GLStateCache::GetFramebuffer(GLenum target) {
+    GLint fbo;
+    if (target == GL_READ_FRAMEBUFFER_EXT) {
+        if (readFboKnown) {
+            ++counters.answered;
+            return readFbo;
+        }
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING_EXT, &fbo);
+        readFbo = fbo;
+        readFboKnown = true;
+    } else {
+        if (drawFboKnown) {
+            ++counters.answered;
+            return drawFbo;
+        }
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &fbo);
+        drawFbo = fbo;
+        drawFboKnown = true;
+    }
+    ++counters.queried;
+    return fbo;
+}
+
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    if (viewportKnown && viewport[0] == x && viewport[1] == y &&
+        viewport[2] == width && viewport[3] == height) {
+        ++counters.filtered;
+        return;
+    }
+    glViewport(x, y, width, height);
+    viewport = Vector<4, GLint>(x, y, width, height);
+    viewportKnown = true;
+    ++counters.issued;
+}
+
+Vector<4, GLint> GLStateCache::GetViewport() {
+    if (!viewportKnown) {
+        GLint v[4];
+        glGetIntegerv(GL_VIEWPORT, v);
+        viewport = Vector<4, GLint>(v[0], v[1], v[2], v[3]);
+        viewportKnown = true;
+        ++counters.queried;
+    } else ++counters.answered;
+    return viewport;
+}
+
+void GLStateCache::ActiveTexture(GLenum unit) {
+    if (activeTextureKnown && activeTexture == unit) {
+        ++counters.filtered;
+        return;
+    }
+    glActiveTexture(unit);
+    activeTexture = unit;
+    activeTextureKnown = true;
+    ++counters.issued;
+}
+
+GLenum GLStateCache::GetActiveTexture() {
+    if (!activeTextureKnown) {
+        GLint unit;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+        activeTexture = unit;
+        activeTextureKnown = true;
+        ++counters.queried;
+    } else ++counters.answered;
+    return activeTexture;
+}
+
+/**
+ * Bind a texture to the active texture unit.
+ */
+void GLStateCache::BindTexture(GLenum target, GLuint texture) {
+    TextureTarget key(GetActiveTexture(), target);
+    std::map<TextureTarget, GLuint>::iterator itr = textures.find(key);
+    if (itr != textures.end() && itr->second == texture) {
+        ++counters.filtered;
+        return;
+    }
+    glBindTexture(target, texture);
+    textures[key] = texture;
+    ++counters.issued;
+    ++counters.textures;
+}
+
+/**
+ * Bind a texture to the given texture unit. The unit is only
+ * activated if the binding actually changes.
+ */
+void GLStateCache::BindTexture(GLenum unit, GLenum target, GLuint texture) {
+    TextureTarget key(unit, target);
+    std::map<TextureTarget, GLuint>::iterator itr = textures.find(key);
+    if (itr != textures.end() && itr->second == texture) {
+        ++counters.filtered;
+        return;
+    }
+    ActiveTexture(unit);
+    glBindTexture(target, texture);
+    textures[key] = texture;
+    ++counters.issued;
+    ++counters.textures;
+}
+
+/**
+ * Get the texture bound to a texture unit. The active unit is never
+ * changed, so the binding of another unit is unknown until a texture
+ * has been bound to it through the cache after the last Invalidate().
+ *
+ * @return False if the binding is unknown.
+ */
+bool GLStateCache::GetTexture(GLenum unit, GLenum target, GLuint& texture) {
+    TextureTarget key(unit, target);
+    std::map<TextureTarget, GLuint>::iterator itr = textures.find(key);
+    if (itr != textures.end()) {
+        ++counters.answered;
+        texture = itr->second;
+        return true;
+    }
+    if (!activeTextureKnown || activeTexture != unit)
+        return false;
+    GLenum binding;
+    switch (target) {
+    case GL_TEXTURE_3D: binding = GL_TEXTURE_BINDING_3D; break;
+    case GL_TEXTURE_2D_ARRAY_EXT: binding = GL_TEXTURE_BINDING_2D_ARRAY_EXT; break;
+    default: binding = GL_TEXTURE_BINDING_2D;
+    }
+    GLint bound;
+    glGetIntegerv(binding, &bound);
+    texture = bound;
+    textures[key] = texture;
+    ++counters.queried;
+    return true;
+}
+
+/**
+ * Deleting a texture unbinds it from every unit, so the cache must
+ * be told when a texture is deleted.
+ */
+void GLStateCache::ForgetTexture(GLuint texture) {
+    std::map<TextureTarget, GLuint>::iterator itr = textures.begin();
+    for (; itr != textures.end(); ++itr)
+        if (itr->second == texture) itr->second = 0;
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer) {
+    std::map<GLenum, GLuint>::iterator itr = buffers.find(target);
+    if (itr != buffers.end() && itr->second == buffer) {
+        ++counters.filtered;
+        return;
+    }
+    glBindBuffer(target, buffer);
+    buffers[target] = buffer;
+    ++counters.issued;
+    ++counters.buffers;
+}
+
+GLuint GLStateCache::GetBuffer(GLenum target) {
+    std::map<GLenum, GLuint>::iterator itr = buffers.find(target);
+    if (itr != buffers.end()) {
+        ++counters.answered;
+        return itr->second;
+    }
+    GLenum binding;
+    switch (target) {
+    case GL_ELEMENT_ARRAY_BUFFER: binding = GL_ELEMENT_ARRAY_BUFFER_BINDING; break;
+    case GL_PIXEL_PACK_BUFFER: binding = GL_PIXEL_PACK_BUFFER_BINDING; break;
+    case GL_PIXEL_UNPACK_BUFFER: binding = GL_PIXEL_UNPACK_BUFFER_BINDING; break;
+    default: binding = GL_ARRAY_BUFFER_BINDING;
+    }
+    GLint buffer;
+    glGetIntegerv(binding, &buffer);
+    buffers[target] = buffer;
+    ++counters.queried;
+    return buffer;
+}
+
+void GLStateCache::ForgetBuffer(GLuint buffer) {
+    std::map<GLenum, GLuint>::iterator itr = buffers.begin();
+    for (; itr != buffers.end(); ++itr)
+        if (itr->second == buffer) itr->second = 0;
+}
+
+/**
+ * Bind a vertex array object. The element array buffer binding is
+ * part of the vertex array object, so it becomes unknown.
+ */
+void GLStateCache::BindVertexArray(GLuint vao) {
+    if (vertexArrayKnown && vertexArray == vao) {
+        ++counters.filtered;
+        return;
+    }
+    glBindVertexArray(vao);
+    vertexArray = vao;
+    vertexArrayKnown = true;
+    buffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+    ++counters.issued;
+    ++counters.vertexArrays;
+}
+
+GLuint GLStateCache::GetVertexArray() {
+    if (!vertexArrayKnown) {
+        GLint vao;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+        vertexArray = vao;
+        vertexArrayKnown = true;
+        ++counters.queried;
+    } else ++counters.answered;
+    return vertexArray;
+}
+
+void GLStateCache::UseProgram(GLuint prog) {
+    if (programKnown && program == prog) {
+        ++counters.filtered;
+        return;
+    }
+    glUseProgram(prog);
+    program = prog;
+    programKnown = true;
+    ++counters.issued;
+    ++counters.programs;
+}
+
+GLuint GLStateCache::GetProgram() {
+    if (!programKnown) {
+        GLint prog;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &prog);
+        program = prog;
+        programKnown = true;
+        ++counters.queried;
+    } else ++counters.answered;
+    return program;
+}
+
+GLint GLStateCache::GetLimit(GLenum pname) {
+    std::map<GLenum, GLint>::iterator itr = limits.find(pname);
+    if (itr != limits.end()) {
+        ++counters.answered;
+        return itr->second;
+    }
+    GLint value;
+    glGetIntegerv(pname, &value);
+    limits[pname] = value;
+    ++counters.queried;
+    return value;
+}
+
+GLStateCache::Counters GLStateCache::GetCounters() {
+    return counters;
+}
+
+void GLStateCache::ResetCounters() {
+    counters.issued = counters.filtered = 0;
+    counters.queried = counters.answered = 0;
+    counters.programs = counters.textures = counters.buffers = 0;
+    counters.framebuffers = counters.vertexArrays = 0;
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
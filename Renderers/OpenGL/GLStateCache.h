@@ -0,0 +1,126 @@
+// OpenGL state shadow cache.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_STATE_CACHE_H_
+#define _OPENGL_STATE_CACHE_H_
+
+#include <Meta/OpenGL.h>
+#include <Math/Vector.h>
+#include <map>
+#include <utility>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+using OpenEngine::Math::Vector;
+
+/**
+ * CPU side shadow of the OpenGL state.
+ *
+ * All state changes in the OpenGL extension go through this cache,
+ * so setting a state that is already in effect is filtered out and
+ * state queries are answered without a round trip to the driver.
+ * State that has not been set or queried since the last call to
+ * Invalidate() is unknown and will be fetched from the driver once,
+ * except texture bindings of inactive units, which stay unknown
+ * rather than switching units to query them.
+ *
+ * The cache assumes a single OpenGL context. Code that changes the
+ * tracked state behind its back must call Invalidate() afterwards.
+ *
+ * @class GLStateCache GLStateCache.h Renderers/OpenGL/GLStateCache.h
+ */
+class GLStateCache {
+public:
+    /**
+     * Counters for the calls passing through the cache.
+     */
+    struct Counters {
+        unsigned int issued;      //!< state changes sent to the driver
+        unsigned int filtered;    //!< redundant state changes skipped
+        unsigned int queried;     //!< queries sent to the driver
+        unsigned int answered;    //!< queries answered from the cache
+        // issued state changes by category
+        unsigned int programs, textures, buffers, framebuffers, vertexArrays;
+    };
+
+private:
+    typedef std::pair<GLenum, GLenum> TextureTarget; // unit, target
+    // Texture enables are per texture unit, other capabilities are
+    // kept under unit 0.
+    typedef std::pair<GLenum, GLenum> Capability; // unit, capability
+
+    static std::map<Capability, bool> capabilities;
+    static std::map<TextureTarget, GLuint> textures;
+    static std::map<GLenum, GLuint> buffers;
+    static bool blendFuncKnown, blendEquationKnown, viewportKnown;
+    static bool drawFboKnown, readFboKnown, activeTextureKnown, programKnown;
+    static bool vertexArrayKnown;
+    static GLenum blendSrc, blendDst, blendEquation;
+    static Vector<4, GLint> viewport;
+    static GLuint drawFbo, readFbo, program, vertexArray;
+    static GLenum activeTexture;
+    static Counters counters;
+
+    static Capability GetCapability(GLenum cap);
+
+public:
+    static void Invalidate();
+
+    // Capabilities (glEnable/glDisable/glIsEnabled)
+    static void Enable(GLenum cap);
+    static void Disable(GLenum cap);
+    static void SetCapability(GLenum cap, bool enabled);
+    static bool IsEnabled(GLenum cap);
+
+    // Blending
+    static void BlendFunc(GLenum source, GLenum destination);
+    static void GetBlendFunc(GLenum& source, GLenum& destination);
+    static void BlendEquation(GLenum equation);
+    static GLenum GetBlendEquation();
+
+    // Frame buffers and viewport
+    static void BindFramebuffer(GLenum target, GLuint fbo);
+    static GLuint GetFramebuffer(GLenum target = GL_DRAW_FRAMEBUFFER_EXT);
+    static void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    static Vector<4, GLint> GetViewport();
+
+    // Textures
+    static void ActiveTexture(GLenum unit);
+    static GLenum GetActiveTexture();
+    static void BindTexture(GLenum target, GLuint texture);
+    static void BindTexture(GLenum unit, GLenum target, GLuint texture);
+    static bool GetTexture(GLenum unit, GLenum target, GLuint& texture);
+    static void ForgetTexture(GLuint texture);
+
+    // Buffers and programs
+    static void BindBuffer(GLenum target, GLuint buffer);
+    static GLuint GetBuffer(GLenum target);
+    static void ForgetBuffer(GLuint buffer);
+    static void BindVertexArray(GLuint vao);
+    static GLuint GetVertexArray();
+    static void UseProgram(GLuint program);
+    static GLuint GetProgram();
+
+    /**
+     * Implementation limits, like GL_MAX_LIGHTS, never change for
+     * a context and are only queried once.
+     */
+    static GLint GetLimit(GLenum pname);
+
+    static Counters GetCounters();
+    static void ResetCounters();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_STATE_CACHE_H_
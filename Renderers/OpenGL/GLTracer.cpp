@@ -0,0 +1,677 @@
+// OpenGL call tracer.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+// The tracer calls the real OpenGL 1.1 functions.
+#define OE_GL_TRACER 1
+
+#include <Renderers/OpenGL/GLTracer.h>
+#include <Utils/Timer.h>
+#include <Logging/Logger.h>
+#include <fstream>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+#if OE_TRACE_GL
+void (GLAPIENTRY *GLCoreHooks::Enable)(GLenum) = glEnable;
+void (GLAPIENTRY *GLCoreHooks::Disable)(GLenum) = glDisable;
+void (GLAPIENTRY *GLCoreHooks::BindTexture)(GLenum, GLuint) = glBindTexture;
+void (GLAPIENTRY *GLCoreHooks::Viewport)(GLint, GLint, GLsizei, GLsizei) = glViewport;
+void (GLAPIENTRY *GLCoreHooks::Clear)(GLbitfield) = glClear;
+void (GLAPIENTRY *GLCoreHooks::DrawElements)(GLenum, GLsizei, GLenum, const GLvoid*) = glDrawElements;
+void (GLAPIENTRY *GLCoreHooks::DrawArrays)(GLenum, GLint, GLsizei) = glDrawArrays;
+void (GLAPIENTRY *GLCoreHooks::BlendFunc)(GLenum, GLenum) = glBlendFunc;
+void (GLAPIENTRY *GLCoreHooks::DepthFunc)(GLenum) = glDepthFunc;
+void (GLAPIENTRY *GLCoreHooks::EnableClientState)(GLenum) = glEnableClientState;
+void (GLAPIENTRY *GLCoreHooks::DisableClientState)(GLenum) = glDisableClientState;
+void (GLAPIENTRY *GLCoreHooks::VertexPointer)(GLint, GLenum, GLsizei, const GLvoid*) = glVertexPointer;
+void (GLAPIENTRY *GLCoreHooks::NormalPointer)(GLenum, GLsizei, const GLvoid*) = glNormalPointer;
+void (GLAPIENTRY *GLCoreHooks::ColorPointer)(GLint, GLenum, GLsizei, const GLvoid*) = glColorPointer;
+void (GLAPIENTRY *GLCoreHooks::TexCoordPointer)(GLint, GLenum, GLsizei, const GLvoid*) = glTexCoordPointer;
+void (GLAPIENTRY *GLCoreHooks::MatrixMode)(GLenum) = glMatrixMode;
+void (GLAPIENTRY *GLCoreHooks::PushMatrix)() = glPushMatrix;
+void (GLAPIENTRY *GLCoreHooks::PopMatrix)() = glPopMatrix;
+void (GLAPIENTRY *GLCoreHooks::LoadIdentity)() = glLoadIdentity;
+void (GLAPIENTRY *GLCoreHooks::LoadMatrixf)(const GLfloat*) = glLoadMatrixf;
+void (GLAPIENTRY *GLCoreHooks::MultMatrixf)(const GLfloat*) = glMultMatrixf;
+void (GLAPIENTRY *GLCoreHooks::TexImage2D)(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const GLvoid*) = glTexImage2D;
+void (GLAPIENTRY *GLCoreHooks::Lightf)(GLenum, GLenum, GLfloat) = glLightf;
+void (GLAPIENTRY *GLCoreHooks::Lightfv)(GLenum, GLenum, const GLfloat*) = glLightfv;
+#endif
+
+static const char MAGIC[8] = { 'O', 'E', 'G', 'L', 'T', 'R', '0', '1' };
+
+static const char* callNames[GLTracer::CALL_COUNT] = {
+    "glBindBuffer", "glBufferData", "glBufferSubData", "glUseProgram",
+    "glActiveTexture", "glBindFramebufferEXT", "glBindVertexArray",
+    "glVertexAttribPointer", "glEnableVertexAttribArray",
+    "glDisableVertexAttribArray", "glVertexAttribDivisorARB",
+    "glDrawElementsInstancedARB", "glBlendEquationEXT", "glUniform1i",
+    "glUniform1iv", "glUniform2iv", "glUniform3iv", "glUniform4iv",
+    "glUniform1fv", "glUniform2fv", "glUniform3fv", "glUniform4fv",
+    "glUniformMatrix4fv", "glEnable", "glDisable", "glBindTexture",
+    "glViewport", "glClear", "glDrawElements", "glDrawArrays",
+    "glBlendFunc", "glDepthFunc", "glBindBufferBase",
+    "glClientActiveTexture", "glEnableClientState", "glDisableClientState",
+    "glVertexPointer", "glNormalPointer", "glColorPointer",
+    "glTexCoordPointer", "glMatrixMode", "glPushMatrix", "glPopMatrix",
+    "glLoadIdentity", "glLoadMatrixf", "glMultMatrixf", "glTexImage2D",
+    "glLight"
+};
+
+static std::string captureFile;
+static std::ofstream out;
+static bool capturing = false;
+static unsigned int calls = 0;
+static Utils::Timer timer;
+static unsigned int frameStart = 0;
+
+// The replaced GLEW pointers while capturing.
+static struct {
+    PFNGLBINDBUFFERPROC BindBuffer;
+    PFNGLBUFFERDATAPROC BufferData;
+    PFNGLBUFFERSUBDATAPROC BufferSubData;
+    PFNGLUSEPROGRAMPROC UseProgram;
+    PFNGLACTIVETEXTUREPROC ActiveTexture;
+    PFNGLBINDFRAMEBUFFEREXTPROC BindFramebufferEXT;
+    PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+    PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+    PFNGLDISABLEVERTEXATTRIBARRAYPROC DisableVertexAttribArray;
+    PFNGLVERTEXATTRIBDIVISORARBPROC VertexAttribDivisorARB;
+    PFNGLDRAWELEMENTSINSTANCEDARBPROC DrawElementsInstancedARB;
+    PFNGLBLENDEQUATIONEXTPROC BlendEquationEXT;
+    PFNGLUNIFORM1IPROC Uniform1i;
+    PFNGLUNIFORM1IVPROC Uniform1iv;
+    PFNGLUNIFORM2IVPROC Uniform2iv;
+    PFNGLUNIFORM3IVPROC Uniform3iv;
+    PFNGLUNIFORM4IVPROC Uniform4iv;
+    PFNGLUNIFORM1FVPROC Uniform1fv;
+    PFNGLUNIFORM2FVPROC Uniform2fv;
+    PFNGLUNIFORM3FVPROC Uniform3fv;
+    PFNGLUNIFORM4FVPROC Uniform4fv;
+    PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+    PFNGLBINDBUFFERBASEPROC BindBufferBase;
+    PFNGLCLIENTACTIVETEXTUREPROC ClientActiveTexture;
+} real;
+
+static unsigned int Now() {
+    return timer.GetElapsedIntervals(1) - frameStart;
+}
+
+static GLuint64 Signed(GLint value) {
+    return (GLuint64)(GLint64)value;
+}
+
+static GLuint Binding(GLenum binding) {
+    GLint id;
+    glGetIntegerv(binding, &id);
+    return id;
+}
+
+static GLuint64 BufferSize(GLenum target, GLuint buffer) {
+    GLint size = 0;
+    if (buffer != 0) glGetBufferParameteriv(target, GL_BUFFER_SIZE, &size);
+    return size;
+}
+
+static void Write(GLTracer::Call call, unsigned int start, unsigned int end,
+                  const GLuint64* args, unsigned short argc,
+                  const void* data = NULL, unsigned int size = 0) {
+    unsigned short id = call;
+    unsigned int duration = end - start;
+    out.write((const char*)&id, sizeof(id));
+    out.write((const char*)&argc, sizeof(argc));
+    out.write((const char*)&start, sizeof(start));
+    out.write((const char*)&duration, sizeof(duration));
+    out.write((const char*)args, argc * sizeof(GLuint64));
+    if (data == NULL) size = 0;
+    out.write((const char*)&size, sizeof(size));
+    if (size > 0) out.write((const char*)data, size);
+    ++calls;
+}
+
+static void GLAPIENTRY TraceBindBuffer(GLenum target, GLuint buffer) {
+    unsigned int start = Now();
+    real.BindBuffer(target, buffer);
+    unsigned int end = Now();
+    GLuint64 args[] = { target, buffer, BufferSize(target, buffer) };
+    Write(GLTracer::BIND_BUFFER, start, end, args, 3);
+}
+
+static void GLAPIENTRY TraceBufferData(GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage) {
+    unsigned int start = Now();
+    real.BufferData(target, size, data, usage);
+    unsigned int end = Now();
+    GLuint64 args[] = { target, (GLuint64)size, usage };
+    Write(GLTracer::BUFFER_DATA, start, end, args, 3, data, size);
+}
+
+static void GLAPIENTRY TraceBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid* data) {
+    unsigned int start = Now();
+    real.BufferSubData(target, offset, size, data);
+    unsigned int end = Now();
+    GLuint64 args[] = { target, (GLuint64)offset, (GLuint64)size };
+    Write(GLTracer::BUFFER_SUB_DATA, start, end, args, 3, data, size);
+}
+
+static void GLAPIENTRY TraceUseProgram(GLuint program) {
+    unsigned int start = Now();
+    real.UseProgram(program);
+    unsigned int end = Now();
+    GLuint64 args[] = { program };
+    Write(GLTracer::USE_PROGRAM, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceActiveTexture(GLenum unit) {
+    unsigned int start = Now();
+    real.ActiveTexture(unit);
+    unsigned int end = Now();
+    GLuint64 args[] = { unit };
+    Write(GLTracer::ACTIVE_TEXTURE, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceBindFramebufferEXT(GLenum target, GLuint fbo) {
+    unsigned int start = Now();
+    real.BindFramebufferEXT(target, fbo);
+    unsigned int end = Now();
+    GLuint64 args[] = { target, fbo };
+    Write(GLTracer::BIND_FRAMEBUFFER, start, end, args, 2);
+}
+
+static void GLAPIENTRY TraceBindVertexArray(GLuint vao) {
+    unsigned int start = Now();
+    real.BindVertexArray(vao);
+    unsigned int end = Now();
+    GLuint64 args[] = { vao };
+    Write(GLTracer::BIND_VERTEX_ARRAY, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                                GLsizei stride, const GLvoid* pointer) {
+    unsigned int start = Now();
+    real.VertexAttribPointer(index, size, type, normalized, stride, pointer);
+    unsigned int end = Now();
+    GLuint buffer = Binding(GL_ARRAY_BUFFER_BINDING);
+    GLuint64 args[] = { index, Signed(size), type, normalized, Signed(stride),
+                        (GLuint64)(size_t)pointer, buffer,
+                        BufferSize(GL_ARRAY_BUFFER, buffer) };
+    Write(GLTracer::VERTEX_ATTRIB_POINTER, start, end, args, 8);
+}
+
+static void GLAPIENTRY TraceEnableVertexAttribArray(GLuint index) {
+    unsigned int start = Now();
+    real.EnableVertexAttribArray(index);
+    unsigned int end = Now();
+    GLuint64 args[] = { index };
+    Write(GLTracer::ENABLE_VERTEX_ATTRIB_ARRAY, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceDisableVertexAttribArray(GLuint index) {
+    unsigned int start = Now();
+    real.DisableVertexAttribArray(index);
+    unsigned int end = Now();
+    GLuint64 args[] = { index };
+    Write(GLTracer::DISABLE_VERTEX_ATTRIB_ARRAY, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceVertexAttribDivisorARB(GLuint index, GLuint divisor) {
+    unsigned int start = Now();
+    real.VertexAttribDivisorARB(index, divisor);
+    unsigned int end = Now();
+    GLuint64 args[] = { index, divisor };
+    Write(GLTracer::VERTEX_ATTRIB_DIVISOR, start, end, args, 2);
+}
+
+static void GLAPIENTRY TraceDrawElementsInstancedARB(GLenum mode, GLsizei count, GLenum type,
+                                                     const GLvoid* indices, GLsizei instances) {
+    unsigned int start = Now();
+    real.DrawElementsInstancedARB(mode, count, type, indices, instances);
+    unsigned int end = Now();
+    GLuint buffer = Binding(GL_ELEMENT_ARRAY_BUFFER_BINDING);
+    GLuint64 args[] = { mode, Signed(count), type, (GLuint64)(size_t)indices, Signed(instances),
+                        buffer, BufferSize(GL_ELEMENT_ARRAY_BUFFER, buffer) };
+    Write(GLTracer::DRAW_ELEMENTS_INSTANCED, start, end, args, 7);
+}
+
+static void GLAPIENTRY TraceBlendEquationEXT(GLenum mode) {
+    unsigned int start = Now();
+    real.BlendEquationEXT(mode);
+    unsigned int end = Now();
+    GLuint64 args[] = { mode };
+    Write(GLTracer::BLEND_EQUATION, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceUniform1i(GLint location, GLint value) {
+    unsigned int start = Now();
+    real.Uniform1i(location, value);
+    unsigned int end = Now();
+    GLuint64 args[] = { Signed(location), Signed(value) };
+    Write(GLTracer::UNIFORM_1I, start, end, args, 2);
+}
+
+#define TRACE_UNIFORM_V(name, call, type, n)                            \
+    static void GLAPIENTRY Trace##name(GLint location, GLsizei count, const type* values) { \
+        unsigned int start = Now();                                     \
+        real.name(location, count, values);                             \
+        unsigned int end = Now();                                       \
+        GLuint64 args[] = { Signed(location), Signed(count) };          \
+        Write(GLTracer::call, start, end, args, 2, values, count * n * sizeof(type)); \
+    }
+
+TRACE_UNIFORM_V(Uniform1iv, UNIFORM_1IV, GLint, 1)
+TRACE_UNIFORM_V(Uniform2iv, UNIFORM_2IV, GLint, 2)
+TRACE_UNIFORM_V(Uniform3iv, UNIFORM_3IV, GLint, 3)
+TRACE_UNIFORM_V(Uniform4iv, UNIFORM_4IV, GLint, 4)
+TRACE_UNIFORM_V(Uniform1fv, UNIFORM_1FV, GLfloat, 1)
+TRACE_UNIFORM_V(Uniform2fv, UNIFORM_2FV, GLfloat, 2)
+TRACE_UNIFORM_V(Uniform3fv, UNIFORM_3FV, GLfloat, 3)
+TRACE_UNIFORM_V(Uniform4fv, UNIFORM_4FV, GLfloat, 4)
+
+static void GLAPIENTRY TraceUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* values) {
+    unsigned int start = Now();
+    real.UniformMatrix4fv(location, count, transpose, values);
+    unsigned int end = Now();
+    GLuint64 args[] = { Signed(location), Signed(count), transpose };
+    Write(GLTracer::UNIFORM_MATRIX_4FV, start, end, args, 3, values, count * 16 * sizeof(GLfloat));
+}
+
+static void GLAPIENTRY TraceBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    unsigned int start = Now();
+    real.BindBufferBase(target, index, buffer);
+    unsigned int end = Now();
+    GLuint64 args[] = { target, index, buffer, BufferSize(target, buffer) };
+    Write(GLTracer::BIND_BUFFER_BASE, start, end, args, 4);
+}
+
+static void GLAPIENTRY TraceClientActiveTexture(GLenum unit) {
+    unsigned int start = Now();
+    real.ClientActiveTexture(unit);
+    unsigned int end = Now();
+    GLuint64 args[] = { unit };
+    Write(GLTracer::CLIENT_ACTIVE_TEXTURE, start, end, args, 1);
+}
+
+#if OE_TRACE_GL
+static void GLAPIENTRY TraceEnable(GLenum cap) {
+    unsigned int start = Now();
+    glEnable(cap);
+    unsigned int end = Now();
+    GLuint64 args[] = { cap };
+    Write(GLTracer::ENABLE, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceDisable(GLenum cap) {
+    unsigned int start = Now();
+    glDisable(cap);
+    unsigned int end = Now();
+    GLuint64 args[] = { cap };
+    Write(GLTracer::DISABLE, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceBindTexture(GLenum target, GLuint texture) {
+    unsigned int start = Now();
+    glBindTexture(target, texture);
+    unsigned int end = Now();
+    GLuint64 args[] = { target, texture };
+    Write(GLTracer::BIND_TEXTURE, start, end, args, 2);
+}
+
+static void GLAPIENTRY TraceViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    unsigned int start = Now();
+    glViewport(x, y, width, height);
+    unsigned int end = Now();
+    GLuint64 args[] = { Signed(x), Signed(y), Signed(width), Signed(height) };
+    Write(GLTracer::VIEWPORT, start, end, args, 4);
+}
+
+static void GLAPIENTRY TraceClear(GLbitfield mask) {
+    unsigned int start = Now();
+    glClear(mask);
+    unsigned int end = Now();
+    GLuint64 args[] = { mask };
+    Write(GLTracer::CLEAR, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices) {
+    unsigned int start = Now();
+    glDrawElements(mode, count, type, indices);
+    unsigned int end = Now();
+    GLuint buffer = Binding(GL_ELEMENT_ARRAY_BUFFER_BINDING);
+    GLuint64 args[] = { mode, Signed(count), type, (GLuint64)(size_t)indices,
+                        buffer, BufferSize(GL_ELEMENT_ARRAY_BUFFER, buffer) };
+    Write(GLTracer::DRAW_ELEMENTS, start, end, args, 6);
+}
+
+static void GLAPIENTRY TraceDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    unsigned int start = Now();
+    glDrawArrays(mode, first, count);
+    unsigned int end = Now();
+    GLuint64 args[] = { mode, Signed(first), Signed(count) };
+    Write(GLTracer::DRAW_ARRAYS, start, end, args, 3);
+}
+
+static void GLAPIENTRY TraceBlendFunc(GLenum source, GLenum destination) {
+    unsigned int start = Now();
+    glBlendFunc(source, destination);
+    unsigned int end = Now();
+    GLuint64 args[] = { source, destination };
+    Write(GLTracer::BLEND_FUNC, start, end, args, 2);
+}
+
+static void GLAPIENTRY TraceDepthFunc(GLenum func) {
+    unsigned int start = Now();
+    glDepthFunc(func);
+    unsigned int end = Now();
+    GLuint64 args[] = { func };
+    Write(GLTracer::DEPTH_FUNC, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceEnableClientState(GLenum array) {
+    unsigned int start = Now();
+    glEnableClientState(array);
+    unsigned int end = Now();
+    GLuint64 args[] = { array };
+    Write(GLTracer::ENABLE_CLIENT_STATE, start, end, args, 1);
+}
+
+static void GLAPIENTRY TraceDisableClientState(GLenum array) {
+    unsigned int start = Now();
+    glDisableClientState(array);
+    unsigned int end = Now();
+    GLuint64 args[] = { array };
+    Write(GLTracer::DISABLE_CLIENT_STATE, start, end, args, 1);
+}
+
+#define TRACE_POINTER(name, call)                                       \
+    static void GLAPIENTRY Trace##name(GLint size, GLenum type, GLsizei stride, const GLvoid* pointer) { \
+        unsigned int start = Now();                                     \
+        gl##name(size, type, stride, pointer);                          \
+        unsigned int end = Now();                                       \
+        GLuint buffer = Binding(GL_ARRAY_BUFFER_BINDING);               \
+        GLuint64 args[] = { Signed(size), type, Signed(stride), (GLuint64)(size_t)pointer, \
+                            buffer, BufferSize(GL_ARRAY_BUFFER, buffer) }; \
+        Write(GLTracer::call, start, end, args, 6);                     \
+    }
+
+TRACE_POINTER(VertexPointer, VERTEX_POINTER)
+TRACE_POINTER(ColorPointer, COLOR_POINTER)
+TRACE_POINTER(TexCoordPointer, TEX_COORD_POINTER)
+
+static void GLAPIENTRY TraceNormalPointer(GLenum type, GLsizei stride, const GLvoid* pointer) {
+    unsigned int start = Now();
+    glNormalPointer(type, stride, pointer);
+    unsigned int end = Now();
+    GLuint buffer = Binding(GL_ARRAY_BUFFER_BINDING);
+    GLuint64 args[] = { type, Signed(stride), (GLuint64)(size_t)pointer,
+                        buffer, BufferSize(GL_ARRAY_BUFFER, buffer) };
+    Write(GLTracer::NORMAL_POINTER, start, end, args, 5);
+}
+
+static void GLAPIENTRY TraceMatrixMode(GLenum mode) {
+    unsigned int start = Now();
+    glMatrixMode(mode);
+    unsigned int end = Now();
+    GLuint64 args[] = { mode };
+    Write(GLTracer::MATRIX_MODE, start, end, args, 1);
+}
+
+static void GLAPIENTRY TracePushMatrix() {
+    unsigned int start = Now();
+    glPushMatrix();
+    unsigned int end = Now();
+    Write(GLTracer::PUSH_MATRIX, start, end, NULL, 0);
+}
+
+static void GLAPIENTRY TracePopMatrix() {
+    unsigned int start = Now();
+    glPopMatrix();
+    unsigned int end = Now();
+    Write(GLTracer::POP_MATRIX, start, end, NULL, 0);
+}
+
+static void GLAPIENTRY TraceLoadIdentity() {
+    unsigned int start = Now();
+    glLoadIdentity();
+    unsigned int end = Now();
+    Write(GLTracer::LOAD_IDENTITY, start, end, NULL, 0);
+}
+
+static void GLAPIENTRY TraceLoadMatrixf(const GLfloat* m) {
+    unsigned int start = Now();
+    glLoadMatrixf(m);
+    unsigned int end = Now();
+    Write(GLTracer::LOAD_MATRIX, start, end, NULL, 0, m, 16 * sizeof(GLfloat));
+}
+
+static void GLAPIENTRY TraceMultMatrixf(const GLfloat* m) {
+    unsigned int start = Now();
+    glMultMatrixf(m);
+    unsigned int end = Now();
+    Write(GLTracer::MULT_MATRIX, start, end, NULL, 0, m, 16 * sizeof(GLfloat));
+}
+
+static void GLAPIENTRY TraceTexImage2D(GLenum target, GLint level, GLint internalFormat,
+                                       GLsizei width, GLsizei height, GLint border,
+                                       GLenum format, GLenum type, const GLvoid* pixels) {
+    unsigned int start = Now();
+    glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+    unsigned int end = Now();
+    GLuint64 args[] = { target, Signed(level), Signed(internalFormat), Signed(width), Signed(height),
+                        Signed(border), format, type, (GLuint64)(size_t)pixels,
+                        Binding(GL_PIXEL_UNPACK_BUFFER_BINDING) };
+    Write(GLTracer::TEX_IMAGE_2D, start, end, args, 10);
+}
+
+static void GLAPIENTRY TraceLightf(GLenum light, GLenum name, GLfloat value) {
+    unsigned int start = Now();
+    glLightf(light, name, value);
+    unsigned int end = Now();
+    GLuint64 args[] = { light, name };
+    Write(GLTracer::LIGHT, start, end, args, 2, &value, sizeof(GLfloat));
+}
+
+static void GLAPIENTRY TraceLightfv(GLenum light, GLenum name, const GLfloat* values) {
+    unsigned int start = Now();
+    glLightfv(light, name, values);
+    unsigned int end = Now();
+    unsigned int count = 1;
+    if (name == GL_AMBIENT || name == GL_DIFFUSE ||
+        name == GL_SPECULAR || name == GL_POSITION)
+        count = 4;
+    else if (name == GL_SPOT_DIRECTION)
+        count = 3;
+    GLuint64 args[] = { light, name };
+    Write(GLTracer::LIGHT, start, end, args, 2, values, count * sizeof(GLfloat));
+}
+#endif
+
+#define HOOK(name)                                      \
+    real.name = __glew##name;                           \
+    if (real.name != NULL) __glew##name = Trace##name;
+#define UNHOOK(name)                            \
+    __glew##name = real.name;
+
+static void Install() {
+    HOOK(BindBuffer);
+    HOOK(BufferData);
+    HOOK(BufferSubData);
+    HOOK(UseProgram);
+    HOOK(ActiveTexture);
+    HOOK(BindFramebufferEXT);
+    HOOK(BindVertexArray);
+    HOOK(VertexAttribPointer);
+    HOOK(EnableVertexAttribArray);
+    HOOK(DisableVertexAttribArray);
+    HOOK(VertexAttribDivisorARB);
+    HOOK(DrawElementsInstancedARB);
+    HOOK(BlendEquationEXT);
+    HOOK(Uniform1i);
+    HOOK(Uniform1iv);
+    HOOK(Uniform2iv);
+    HOOK(Uniform3iv);
+    HOOK(Uniform4iv);
+    HOOK(Uniform1fv);
+    HOOK(Uniform2fv);
+    HOOK(Uniform3fv);
+    HOOK(Uniform4fv);
+    HOOK(UniformMatrix4fv);
+    HOOK(BindBufferBase);
+    HOOK(ClientActiveTexture);
+#if OE_TRACE_GL
+    GLCoreHooks::Enable = TraceEnable;
+    GLCoreHooks::Disable = TraceDisable;
+    GLCoreHooks::BindTexture = TraceBindTexture;
+    GLCoreHooks::Viewport = TraceViewport;
+    GLCoreHooks::Clear = TraceClear;
+    GLCoreHooks::DrawElements = TraceDrawElements;
+    GLCoreHooks::DrawArrays = TraceDrawArrays;
+    GLCoreHooks::BlendFunc = TraceBlendFunc;
+    GLCoreHooks::DepthFunc = TraceDepthFunc;
+    GLCoreHooks::EnableClientState = TraceEnableClientState;
+    GLCoreHooks::DisableClientState = TraceDisableClientState;
+    GLCoreHooks::VertexPointer = TraceVertexPointer;
+    GLCoreHooks::NormalPointer = TraceNormalPointer;
+    GLCoreHooks::ColorPointer = TraceColorPointer;
+    GLCoreHooks::TexCoordPointer = TraceTexCoordPointer;
+    GLCoreHooks::MatrixMode = TraceMatrixMode;
+    GLCoreHooks::PushMatrix = TracePushMatrix;
+    GLCoreHooks::PopMatrix = TracePopMatrix;
+    GLCoreHooks::LoadIdentity = TraceLoadIdentity;
+    GLCoreHooks::LoadMatrixf = TraceLoadMatrixf;
+    GLCoreHooks::MultMatrixf = TraceMultMatrixf;
+    GLCoreHooks::TexImage2D = TraceTexImage2D;
+    GLCoreHooks::Lightf = TraceLightf;
+    GLCoreHooks::Lightfv = TraceLightfv;
+#endif
+}
+
+static void Uninstall() {
+    UNHOOK(BindBuffer);
+    UNHOOK(BufferData);
+    UNHOOK(BufferSubData);
+    UNHOOK(UseProgram);
+    UNHOOK(ActiveTexture);
+    UNHOOK(BindFramebufferEXT);
+    UNHOOK(BindVertexArray);
+    UNHOOK(VertexAttribPointer);
+    UNHOOK(EnableVertexAttribArray);
+    UNHOOK(DisableVertexAttribArray);
+    UNHOOK(VertexAttribDivisorARB);
+    UNHOOK(DrawElementsInstancedARB);
+    UNHOOK(BlendEquationEXT);
+    UNHOOK(Uniform1i);
+    UNHOOK(Uniform1iv);
+    UNHOOK(Uniform2iv);
+    UNHOOK(Uniform3iv);
+    UNHOOK(Uniform4iv);
+    UNHOOK(Uniform1fv);
+    UNHOOK(Uniform2fv);
+    UNHOOK(Uniform3fv);
+    UNHOOK(Uniform4fv);
+    UNHOOK(UniformMatrix4fv);
+    UNHOOK(BindBufferBase);
+    UNHOOK(ClientActiveTexture);
+#if OE_TRACE_GL
+    GLCoreHooks::Enable = glEnable;
+    GLCoreHooks::Disable = glDisable;
+    GLCoreHooks::BindTexture = glBindTexture;
+    GLCoreHooks::Viewport = glViewport;
+    GLCoreHooks::Clear = glClear;
+    GLCoreHooks::DrawElements = glDrawElements;
+    GLCoreHooks::DrawArrays = glDrawArrays;
+    GLCoreHooks::BlendFunc = glBlendFunc;
+    GLCoreHooks::DepthFunc = glDepthFunc;
+    GLCoreHooks::EnableClientState = glEnableClientState;
+    GLCoreHooks::DisableClientState = glDisableClientState;
+    GLCoreHooks::VertexPointer = glVertexPointer;
+    GLCoreHooks::NormalPointer = glNormalPointer;
+    GLCoreHooks::ColorPointer = glColorPointer;
+    GLCoreHooks::TexCoordPointer = glTexCoordPointer;
+    GLCoreHooks::MatrixMode = glMatrixMode;
+    GLCoreHooks::PushMatrix = glPushMatrix;
+    GLCoreHooks::PopMatrix = glPopMatrix;
+    GLCoreHooks::LoadIdentity = glLoadIdentity;
+    GLCoreHooks::LoadMatrixf = glLoadMatrixf;
+    GLCoreHooks::MultMatrixf = glMultMatrixf;
+    GLCoreHooks::TexImage2D = glTexImage2D;
+    GLCoreHooks::Lightf = glLightf;
+    GLCoreHooks::Lightfv = glLightfv;
+#endif
+}
+
+void GLTracer::CaptureFrame(std::string file) {
+    captureFile = file;
+}
+
+bool GLTracer::IsCapturing() {
+    return capturing;
+}
+
+void GLTracer::BeginFrame() {
+    if (captureFile.empty() || capturing) return;
+    out.open(captureFile.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out) {
+        logger.error << "GLTracer: could not open " << captureFile << logger.end;
+        captureFile.clear();
+        return;
+    }
+    out.write(MAGIC, sizeof(MAGIC));
+    calls = 0;
+    timer.Start();
+    frameStart = timer.GetElapsedIntervals(1);
+    Install();
+    capturing = true;
+}
+
+void GLTracer::EndFrame() {
+    if (!capturing) return;
+    Uninstall();
+    out.close();
+    logger.info << "GLTracer: " << calls << " calls written to "
+                << captureFile << logger.end;
+    captureFile.clear();
+    capturing = false;
+}
+
+const char* GLTracer::GetCallName(Call call) {
+    if (call >= CALL_COUNT) return "unknown";
+    return callNames[call];
+}
+
+bool GLTracer::ReadTrace(std::string file, std::vector<Record>& records) {
+    std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    if (!in.read(magic, sizeof(magic)) ||
+        std::string(magic, sizeof(magic)) != std::string(MAGIC, sizeof(MAGIC)))
+        return false;
+    records.clear();
+    unsigned short id, argc;
+    while (in.read((char*)&id, sizeof(id))) {
+        Record r;
+        unsigned int size;
+        r.call = (Call)id;
+        in.read((char*)&argc, sizeof(argc));
+        in.read((char*)&r.start, sizeof(r.start));
+        in.read((char*)&r.duration, sizeof(r.duration));
+        r.args.resize(argc);
+        if (argc > 0) in.read((char*)&r.args[0], argc * sizeof(GLuint64));
+        in.read((char*)&size, sizeof(size));
+        r.data.resize(size);
+        if (size > 0) in.read(&r.data[0], size);
+        if (!in || r.call >= CALL_COUNT) return false;
+        records.push_back(r);
+    }
+    return true;
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
@@ -0,0 +1,137 @@
+// OpenGL call tracer.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_GL_TRACER_H_
+#define _OPENGL_GL_TRACER_H_
+
+#include <Meta/OpenGL.h>
+#include <string>
+#include <vector>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Records the OpenGL calls of a frame to a binary trace file.
+ *
+ * While a frame is captured the GLEW function pointers of the traced
+ * calls are replaced by wrappers that forward the call and record it
+ * with its arguments, its start time and its duration. The OpenGL
+ * 1.1 calls are not GLEW pointers and are only traced when the
+ * extension is compiled with OE_TRACE_GL, which routes them through
+ * GLCoreHooks. Outside a capture the tracer costs nothing.
+ *
+ * The trace starts with the 8 byte magic "OEGLTR01", followed by one
+ * record per call:
+ *   - uint16 call, uint16 argument count
+ *   - uint32 start and duration in microseconds from the frame start
+ *   - uint64 arguments
+ *   - uint32 data size and the data passed by pointer, if any
+ *
+ * Besides the arguments of the call a few records carry state needed
+ * to replay them: the buffer a pointer refers to and its size, as
+ * the buffer may have been created in an earlier frame. Texture
+ * uploads record their arguments but not the texels. glLightf and
+ * glLightfv are both recorded as LIGHT with their values as data.
+ *
+ * @see Tools/GLTraceReplay.cpp
+ * @class GLTracer GLTracer.h Renderers/OpenGL/GLTracer.h
+ */
+class GLTracer {
+public:
+    enum Call {
+        BIND_BUFFER,                 // target, buffer, buffer size
+        BUFFER_DATA,                 // target, size, usage; data
+        BUFFER_SUB_DATA,             // target, offset, size; data
+        USE_PROGRAM,                 // program
+        ACTIVE_TEXTURE,              // unit
+        BIND_FRAMEBUFFER,            // target, framebuffer
+        BIND_VERTEX_ARRAY,           // array
+        VERTEX_ATTRIB_POINTER,       // index, size, type, normalized, stride, pointer, array buffer, its size
+        ENABLE_VERTEX_ATTRIB_ARRAY,  // index
+        DISABLE_VERTEX_ATTRIB_ARRAY, // index
+        VERTEX_ATTRIB_DIVISOR,       // index, divisor
+        DRAW_ELEMENTS_INSTANCED,     // mode, count, type, indices, instances, element buffer, its size
+        BLEND_EQUATION,              // mode
+        UNIFORM_1I,                  // location, value
+        UNIFORM_1IV,                 // location, count; values
+        UNIFORM_2IV,
+        UNIFORM_3IV,
+        UNIFORM_4IV,
+        UNIFORM_1FV,
+        UNIFORM_2FV,
+        UNIFORM_3FV,
+        UNIFORM_4FV,
+        UNIFORM_MATRIX_4FV,          // location, count, transpose; values
+        // OpenGL 1.1, only with OE_TRACE_GL
+        ENABLE,                      // capability
+        DISABLE,                     // capability
+        BIND_TEXTURE,                // target, texture
+        VIEWPORT,                    // x, y, width, height
+        CLEAR,                       // mask
+        DRAW_ELEMENTS,               // mode, count, type, indices, element buffer, its size
+        DRAW_ARRAYS,                 // mode, first, count
+        BLEND_FUNC,                  // source, destination
+        DEPTH_FUNC,                  // function
+        // Added later, at the end to keep the ids of older traces
+        BIND_BUFFER_BASE,            // target, index, buffer, buffer size
+        CLIENT_ACTIVE_TEXTURE,       // unit
+        // OpenGL 1.1, only with OE_TRACE_GL
+        ENABLE_CLIENT_STATE,         // array
+        DISABLE_CLIENT_STATE,        // array
+        VERTEX_POINTER,              // size, type, stride, pointer, array buffer, its size
+        NORMAL_POINTER,              // type, stride, pointer, array buffer, its size
+        COLOR_POINTER,               // size, type, stride, pointer, array buffer, its size
+        TEX_COORD_POINTER,           // size, type, stride, pointer, array buffer, its size
+        MATRIX_MODE,                 // mode
+        PUSH_MATRIX,
+        POP_MATRIX,
+        LOAD_IDENTITY,
+        LOAD_MATRIX,                 // ; matrix
+        MULT_MATRIX,                 // ; matrix
+        TEX_IMAGE_2D,                // target, level, internal format, width, height, border, format, type, pointer, unpack buffer
+        LIGHT,                       // light, name; values
+        CALL_COUNT
+    };
+
+    /**
+     * A call read back from a trace.
+     */
+    struct Record {
+        Call call;
+        unsigned int start, duration;
+        std::vector<GLuint64> args;
+        std::vector<char> data;
+    };
+
+    /**
+     * Capture the next frame rendered to the given file.
+     */
+    static void CaptureFrame(std::string file);
+    static bool IsCapturing();
+
+    static void BeginFrame();
+    static void EndFrame();
+
+    static const char* GetCallName(Call call);
+
+    /**
+     * Read a trace file.
+     *
+     * @return False if the file could not be read or is not a trace.
+     */
+    static bool ReadTrace(std::string file, std::vector<Record>& records);
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_GL_TRACER_H_
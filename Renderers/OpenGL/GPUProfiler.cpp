@@ -0,0 +1,216 @@
+// OpenGL frame profiler.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/GPUProfiler.h>
+#include <sstream>
+#include <iomanip>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+bool GPUProfiler::enabled = false;
+bool GPUProfiler::timerSupport = false;
+bool GPUProfiler::inFrame = false;
+unsigned int GPUProfiler::frame = 0;
+unsigned int GPUProfiler::current = 0;
+unsigned int GPUProfiler::depth = 0;
+GPUProfiler::Frame GPUProfiler::frames[GPUProfiler::FRAMES];
+std::vector<unsigned int> GPUProfiler::open;
+std::vector<GPUProfiler::Sample> GPUProfiler::results;
+unsigned int GPUProfiler::resultFrame = 0;
+Utils::Timer GPUProfiler::timer;
+
+/**
+ * Enable or disable profiling. Disabled by default, in which case
+ * the profiling calls do nothing. Must be changed outside a frame.
+ */
+void GPUProfiler::SetEnabled(bool enabled) {
+    if (enabled && !GPUProfiler::enabled) {
+        timerSupport = glewIsSupported("GL_VERSION_3_3") || GLEW_ARB_timer_query;
+        timer.Start();
+    }
+    if (!enabled) {
+        for (unsigned int i = 0; i < FRAMES; ++i) {
+            Frame& f = frames[i];
+            if (!f.queries.empty())
+                glDeleteQueries(f.queries.size(), &f.queries[0]);
+            f.queries.clear();
+            f.records.clear();
+        }
+        results.clear();
+    }
+    GPUProfiler::enabled = enabled;
+}
+
+bool GPUProfiler::IsEnabled() {
+    return enabled;
+}
+
+/**
+ * Start profiling a frame, reading back the results of the oldest
+ * frame in flight.
+ */
+void GPUProfiler::BeginFrame() {
+    if (!enabled) return;
+    ++frame;
+    current = frame % FRAMES;
+    Frame& f = frames[current];
+    if (!f.records.empty()) Collect(f);
+    f.number = frame;
+    f.records.clear();
+    f.usedQueries = 0;
+    open.clear();
+    depth = 0;
+    inFrame = true;
+}
+
+void GPUProfiler::EndFrame() {
+    if (!enabled) return;
+    while (!open.empty()) End();
+    inFrame = false;
+}
+
+void GPUProfiler::Begin(const std::string& name) {
+    if (!enabled || !inFrame) return;
+    Frame& f = frames[current];
+    Record r;
+    r.name = name;
+    r.depth = depth++;
+    r.cpuStart = r.cpuEnd = timer.GetElapsedIntervals(1);
+    r.start = r.end = 0;
+    if (timerSupport) {
+        r.start = NextQuery();
+        glQueryCounter(r.start, GL_TIMESTAMP);
+    }
+    open.push_back(f.records.size());
+    f.records.push_back(r);
+}
+
+void GPUProfiler::End() {
+    if (!enabled || !inFrame || open.empty()) return;
+    Record& r = frames[current].records[open.back()];
+    open.pop_back();
+    --depth;
+    if (timerSupport) {
+        r.end = NextQuery();
+        glQueryCounter(r.end, GL_TIMESTAMP);
+    }
+    r.cpuEnd = timer.GetElapsedIntervals(1);
+}
+
+GLuint GPUProfiler::NextQuery() {
+    Frame& f = frames[current];
+    if (f.usedQueries == f.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        f.queries.push_back(query);
+    }
+    return f.queries[f.usedQueries++];
+}
+
+/**
+ * Read back the results of a frame, if the gpu is done with it.
+ */
+void GPUProfiler::Collect(Frame& f) {
+    bool gpu = timerSupport;
+    if (gpu) {
+        // the last query is the last to finish
+        GLint available = 0;
+        glGetQueryObjectiv(f.queries[f.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return;
+    }
+    results.clear();
+    for (unsigned int i = 0; i < f.records.size(); ++i) {
+        const Record& r = f.records[i];
+        Sample s;
+        s.name = r.name;
+        s.depth = r.depth;
+        s.cpu = (r.cpuEnd - r.cpuStart) / 1000.0;
+        s.gpu = -1.0;
+        if (gpu) {
+            GLuint64 start, end;
+            glGetQueryObjectui64v(r.start, GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(r.end, GL_QUERY_RESULT, &end);
+            s.gpu = (end - start) / 1000000.0;
+        }
+        results.push_back(s);
+    }
+    resultFrame = f.number;
+}
+
+const std::vector<GPUProfiler::Sample>& GPUProfiler::GetResults() {
+    return results;
+}
+
+unsigned int GPUProfiler::GetResultFrame() {
+    return resultFrame;
+}
+
+/**
+ * Escape a CSV field, quotes are doubled.
+ */
+static std::string EscapeCSV(const std::string& str) {
+    std::string out;
+    for (unsigned int i = 0; i < str.size(); ++i) {
+        if (str[i] == '"') out += '"';
+        out += str[i];
+    }
+    return out;
+}
+
+/**
+ * Escape a JSON string, including its control characters.
+ */
+static std::string EscapeJSON(const std::string& str) {
+    std::ostringstream out;
+    for (unsigned int i = 0; i < str.size(); ++i) {
+        unsigned char c = str[i];
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20)
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                << (unsigned int)c << std::dec;
+        else
+            out << c;
+    }
+    return out.str();
+}
+
+/**
+ * The results as comma separated values, one line per sample with
+ * the frame, name, depth, cpu and gpu milliseconds.
+ */
+std::string GPUProfiler::ToCSV(bool header) {
+    std::ostringstream out;
+    if (header) out << "frame,name,depth,cpu_ms,gpu_ms\n";
+    for (unsigned int i = 0; i < results.size(); ++i) {
+        const Sample& s = results[i];
+        out << resultFrame << ",\"" << EscapeCSV(s.name) << "\","
+            << s.depth << "," << s.cpu << "," << s.gpu << "\n";
+    }
+    return out.str();
+}
+
+std::string GPUProfiler::ToJSON() {
+    std::ostringstream out;
+    out << "{\"frame\":" << resultFrame << ",\"samples\":[";
+    for (unsigned int i = 0; i < results.size(); ++i) {
+        const Sample& s = results[i];
+        if (i > 0) out << ",";
+        out << "{\"name\":\"" << EscapeJSON(s.name) << "\",\"depth\":" << s.depth
+            << ",\"cpu_ms\":" << s.cpu << ",\"gpu_ms\":" << s.gpu << "}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
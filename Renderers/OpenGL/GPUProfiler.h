@@ -0,0 +1,108 @@
+// OpenGL frame profiler.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_GPU_PROFILER_H_
+#define _OPENGL_GPU_PROFILER_H_
+
+#include <Meta/OpenGL.h>
+#include <Utils/Timer.h>
+#include <string>
+#include <vector>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Measures the cpu and gpu time of named, nested scopes of a frame.
+ *
+ * The gpu time of a scope is measured with timestamp queries issued
+ * at its begin and end. The queries of a frame are read back
+ * FRAMES - 1 frames later, so reading never waits for the gpu;
+ * results that are still not available by then are dropped. Without
+ * timer query support only cpu times are measured.
+ *
+ * The renderer profiles its phases, post process nodes and the
+ * shadow depth pass. Other code can add scopes with Begin and End,
+ * or a Scope object.
+ *
+ * @class GPUProfiler GPUProfiler.h Renderers/OpenGL/GPUProfiler.h
+ */
+class GPUProfiler {
+public:
+    static const unsigned int FRAMES = 3;
+
+    /**
+     * The times of a scope in milliseconds. The gpu time is
+     * negative when not measured.
+     */
+    struct Sample {
+        std::string name;
+        unsigned int depth;
+        double cpu, gpu;
+    };
+
+    /**
+     * Profiles the lifetime of the object.
+     */
+    class Scope {
+    public:
+        Scope(const std::string& name) { Begin(name); }
+        ~Scope() { End(); }
+    };
+
+private:
+    struct Record {
+        std::string name;
+        unsigned int depth;
+        unsigned int cpuStart, cpuEnd; // microseconds
+        GLuint start, end;             // queries
+    };
+    struct Frame {
+        unsigned int number;
+        std::vector<Record> records;
+        std::vector<GLuint> queries;
+        unsigned int usedQueries;
+    };
+
+    static bool enabled, timerSupport, inFrame;
+    static unsigned int frame, current, depth;
+    static Frame frames[FRAMES];
+    static std::vector<unsigned int> open;
+    static std::vector<Sample> results;
+    static unsigned int resultFrame;
+    static Utils::Timer timer;
+
+    static GLuint NextQuery();
+    static void Collect(Frame& f);
+public:
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+    static void BeginFrame();
+    static void EndFrame();
+    static void Begin(const std::string& name);
+    static void End();
+
+    /**
+     * The samples of the most recent frame whose results are read
+     * back, in the order the scopes began.
+     */
+    static const std::vector<Sample>& GetResults();
+    static unsigned int GetResultFrame();
+
+    static std::string ToCSV(bool header = true);
+    static std::string ToJSON();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_GPU_PROFILER_H_
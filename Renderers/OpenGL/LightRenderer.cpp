@@ -8,6 +8,9 @@
 //--------------------------------------------------------------------
 
 #include <Renderers/OpenGL/LightRenderer.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Renderers/OpenGL/Renderer.h>
+#include <Display/IViewingVolume.h>
 #include <Scene/TransformationNode.h>
 #include <Scene/DirectionalLightNode.h>
 #include <Scene/PointLightNode.h>
@@ -36,6 +39,28 @@ LightRenderer::LightRenderer()
 }
 
 LightRenderer::~LightRenderer() {}
+
+/**
+ * The light block entry of the light being visited, or NULL if the
+ * block is not in use or full.
+ */
+UniformBlocks::Light* LightRenderer::NextBlockLight() {
+    if (!Renderer::IsUniformBufferSupported() ||
+        count >= (GLint)UniformBlocks::MAX_LIGHTS)
+        return NULL;
+    return &UniformBlocks::GetLightBlock().lightSources[count];
+}
+
+/**
+ * Transform a homogeneous vector from the current model space to eye
+ * space.
+ */
+void LightRenderer::ToEyeSpace(const float* in, float* out) {
+    float m[16];
+    (model * view).ToArray(m);
+    for (unsigned int i = 0; i < 4; ++i)
+        out[i] = m[i] * in[0] + m[4 + i] * in[1] + m[8 + i] * in[2] + m[12 + i] * in[3];
+}
         
 void LightRenderer::VisitTransformationNode(TransformationNode* node) {
     // push transformation matrix to model view stack
@@ -44,18 +69,19 @@ void LightRenderer::VisitTransformationNode(TransformationNode* node) {
     m.ToArray(f);
     glPushMatrix();
     glMultMatrixf(f);
+    Matrix<4,4,float> oldModel = model;
+    model = m * model;
     // traverse sub nodes
     node->VisitSubNodes(*this);
     // pop transformation matrix
     glPopMatrix();
+    model = oldModel;
     CHECK_FOR_GL_ERROR();
 }
     
 void LightRenderer::VisitDirectionalLightNode(DirectionalLightNode* node) {
 #if OE_SAFE
-    GLint max;
-    glGetIntegerv(GL_MAX_LIGHTS, &max);
-    if (count >= max) 
+    if (count >= GLStateCache::GetLimit(GL_MAX_LIGHTS)) 
         throw new Exception("OpenGL max lights exceeded.");
 #endif
     GLint light = GL_LIGHT0+count;
@@ -67,7 +93,19 @@ void LightRenderer::VisitDirectionalLightNode(DirectionalLightNode* node) {
     glLightfv(light, GL_DIFFUSE, color);
     node->specular.ToArray(color);
     glLightfv(light, GL_SPECULAR, color);
-    glEnable(light);
+    GLStateCache::Enable(light);
+    UniformBlocks::Light* l = NextBlockLight();
+    if (l) {
+        ToEyeSpace(dir, l->position);
+        ToEyeSpace(dir, l->direction);
+        node->ambient.ToArray(l->ambient);
+        node->diffuse.ToArray(l->diffuse);
+        node->specular.ToArray(l->specular);
+        l->attenuation[0] = 1.0f;
+        l->attenuation[1] = l->attenuation[2] = 0.0f;
+        l->spot[0] = 180.0f;
+        l->spot[1] = 0.0f;
+    }
     count++;
     CHECK_FOR_GL_ERROR();
     node->VisitSubNodes(*this);            
@@ -75,9 +113,7 @@ void LightRenderer::VisitDirectionalLightNode(DirectionalLightNode* node) {
     
 void LightRenderer::VisitPointLightNode(PointLightNode* node) {
 #if OE_SAFE
-    GLint max;
-    glGetIntegerv(GL_MAX_LIGHTS, &max);
-    if (count >= max) 
+    if (count >= GLStateCache::GetLimit(GL_MAX_LIGHTS)) 
         throw new Exception("OpenGL max lights exceeded.");
 #endif
     GLint light = GL_LIGHT0 + count;
@@ -92,7 +128,20 @@ void LightRenderer::VisitPointLightNode(PointLightNode* node) {
     glLightf(light, GL_CONSTANT_ATTENUATION, node->constAtt);
     glLightf(light, GL_LINEAR_ATTENUATION, node->linearAtt);
     glLightf(light, GL_QUADRATIC_ATTENUATION, node->quadAtt);
-    glEnable(light);
+    GLStateCache::Enable(light);
+    UniformBlocks::Light* l = NextBlockLight();
+    if (l) {
+        ToEyeSpace(pos, l->position);
+        ToEyeSpace(dir, l->direction);
+        node->ambient.ToArray(l->ambient);
+        node->diffuse.ToArray(l->diffuse);
+        node->specular.ToArray(l->specular);
+        l->attenuation[0] = node->constAtt;
+        l->attenuation[1] = node->linearAtt;
+        l->attenuation[2] = node->quadAtt;
+        l->spot[0] = 180.0f;
+        l->spot[1] = 0.0f;
+    }
     ++count;
     CHECK_FOR_GL_ERROR();
     node->VisitSubNodes(*this);
@@ -100,9 +149,7 @@ void LightRenderer::VisitPointLightNode(PointLightNode* node) {
 
 void LightRenderer::VisitSpotLightNode(SpotLightNode* node) {
 #if OE_SAFE
-    GLint max;
-    glGetIntegerv(GL_MAX_LIGHTS, &max);
-    if (count >= max) 
+    if (count >= GLStateCache::GetLimit(GL_MAX_LIGHTS)) 
         throw new Exception("OpenGL max lights exceeded.");
 #endif
     GLint light = GL_LIGHT0+count;
@@ -120,7 +167,20 @@ void LightRenderer::VisitSpotLightNode(SpotLightNode* node) {
     glLightf(light, GL_CONSTANT_ATTENUATION, node->constAtt);
     glLightf(light, GL_LINEAR_ATTENUATION, node->linearAtt);
     glLightf(light, GL_QUADRATIC_ATTENUATION, node->quadAtt);
-    glEnable(light);
+    GLStateCache::Enable(light);
+    UniformBlocks::Light* l = NextBlockLight();
+    if (l) {
+        ToEyeSpace(pos, l->position);
+        ToEyeSpace(dir, l->direction);
+        node->ambient.ToArray(l->ambient);
+        node->diffuse.ToArray(l->diffuse);
+        node->specular.ToArray(l->specular);
+        l->attenuation[0] = node->constAtt;
+        l->attenuation[1] = node->linearAtt;
+        l->attenuation[2] = node->quadAtt;
+        l->spot[0] = node->cutoff;
+        l->spot[1] = node->exponent;
+    }
     ++count;
     CHECK_FOR_GL_ERROR();
     node->VisitSubNodes(*this);            
@@ -134,11 +194,23 @@ void LightRenderer::Handle(RenderingEventArg arg) {
     if (arg.canvas.GetScene() == NULL)
         throw new Exception("Scene was NULL in LightRenderer.");
     #endif
+    Matrix<4,4,float> identity(1, 0, 0, 0,
+                               0, 1, 0, 0,
+                               0, 0, 1, 0,
+                               0, 0, 0, 1);
+    model = view = identity;
+    if (arg.canvas.GetViewingVolume() != NULL)
+        view = arg.canvas.GetViewingVolume()->GetViewMatrix();
     arg.canvas.GetScene()->Accept(*this);
-    GLint max;
-    glGetIntegerv(GL_MAX_LIGHTS, &max);
+    if (Renderer::IsUniformBufferSupported()) {
+        UniformBlocks::LightBlock& block = UniformBlocks::GetLightBlock();
+        GLint blockMax = UniformBlocks::MAX_LIGHTS;
+        block.lightCount[0] = count < blockMax ? count : blockMax;
+        UniformBlocks::UpdateLightBlock();
+    }
+    GLint max = GLStateCache::GetLimit(GL_MAX_LIGHTS);
     for (int i = count; i < max; ++i) {
-        glDisable(GL_LIGHT0 + i);
+        GLStateCache::Disable(GL_LIGHT0 + i);
         CHECK_FOR_GL_ERROR();
     }
     if (count != oldCount) {
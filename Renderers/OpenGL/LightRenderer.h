@@ -14,6 +14,8 @@
 #include <Scene/ISceneNodeVisitor.h>
 #include <Core/IListener.h>
 #include <Core/Event.h>
+#include <Renderers/OpenGL/UniformBlocks.h>
+#include <Math/Matrix.h>
 
 #include <Meta/OpenGL.h>
 
@@ -41,6 +43,7 @@ using OpenEngine::Core::IListener;
 using OpenEngine::Core::Event;
 using OpenEngine::Renderers::IRenderer;
 using OpenEngine::Renderers::RenderingEventArg;
+using OpenEngine::Math::Matrix;
 
 
 struct LightCountChangedEventArg {
@@ -48,7 +51,8 @@ struct LightCountChangedEventArg {
 };
 
 /**
- * Setup OpenGL lighting
+ * Setup OpenGL lighting. When uniform buffers are supported the
+ * lights are also written to the shared light block in eye space.
  *
  * @class LightRenderer LightRenderer.h Renderers/OpenGL/LightRenderer.h
  */
@@ -58,6 +62,11 @@ private:
     GLint count;
     Event<LightCountChangedEventArg> lightCountChanged;
     LightCountChangedEventArg event;
+    // model and view matrices for the light block
+    Matrix<4,4,float> model, view;
+
+    UniformBlocks::Light* NextBlockLight();
+    void ToEyeSpace(const float* in, float* out);
 public:
 
     LightRenderer(); 
@@ -70,6 +79,8 @@ public:
     void VisitSpotLightNode(SpotLightNode* node);
 
     Event<LightCountChangedEventArg>& LightCountChangedEvent() { return lightCountChanged; }
+    // The number of lights set up in the last frame.
+    int GetLightCount() const { return count; }
 
 };
 
@@ -0,0 +1,121 @@
+// Cached bounding volumes of vertex data.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/MeshBounds.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Resources/IDataBlock.h>
+#include <Geometry/Mesh.h>
+#include <Geometry/GeometrySet.h>
+#include <Meta/OpenGL.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+using OpenEngine::Resources::IDataBlock;
+using OpenEngine::Resources::IDataBlockPtr;
+using OpenEngine::Geometry::Mesh;
+
+std::map<IDataBlock*, MeshBounds::Entry> MeshBounds::entries;
+
+Bounds MeshBounds::Compute(IDataBlock* vertices) {
+    Bounds b;
+    b.sphere = BoundingSphere::Infinite();
+    unsigned int size = vertices->GetSize();
+    unsigned int dim = vertices->GetDimension();
+    if (size == 0 || dim == 0 || dim > 4 || vertices->GetType() != Resources::Types::FLOAT)
+        return b;
+
+    // Read the vertices back from the buffer object if the client
+    // side copy has been unloaded.
+    const float* data = (const float*)vertices->GetVoidDataPtr();
+    std::vector<float> readback;
+    if (data == NULL) {
+        if (vertices->GetID() == 0) return b;
+        readback.resize(size * dim);
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, vertices->GetID());
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, size * dim * sizeof(float), &readback[0]);
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+        CHECK_FOR_GL_ERROR();
+        data = &readback[0];
+    }
+
+    // Center the sphere in the axis aligned box and find the
+    // farthest vertex from it.
+    b.min = b.max = Vector<3, float>(0.0f);
+    for (unsigned int i = 0; i < size; ++i) {
+        for (unsigned int j = 0; j < 3; ++j) {
+            float v = j < dim ? data[i * dim + j] : 0.0f;
+            if (i == 0 || v < b.min[j]) b.min[j] = v;
+            if (i == 0 || v > b.max[j]) b.max[j] = v;
+        }
+    }
+    Vector<3, float> center = (b.min + b.max) * 0.5f;
+    float radius2 = 0.0f;
+    for (unsigned int i = 0; i < size; ++i) {
+        float d2 = 0.0f;
+        for (unsigned int j = 0; j < 3; ++j) {
+            float d = (j < dim ? data[i * dim + j] : 0.0f) - center[j];
+            d2 += d * d;
+        }
+        radius2 = std::max(radius2, d2);
+    }
+    b.sphere = BoundingSphere(center, std::sqrt(radius2));
+    return b;
+}
+
+const Bounds& MeshBounds::Get(IDataBlockPtr vertices) {
+    IDataBlock* key = vertices.get();
+    std::map<IDataBlock*, Entry>::iterator itr = entries.find(key);
+    // a destroyed block may have left an entry at the address
+    if (itr != entries.end() && !itr->second.block.expired())
+        return itr->second.bounds;
+    Entry& entry = entries[key];
+    entry.block = vertices;
+    entry.bounds = Compute(key);
+    return entry.bounds;
+}
+
+/**
+ * Get the bounding sphere of a mesh in mesh coordinates.
+ */
+BoundingSphere MeshBounds::GetSphere(Mesh* mesh) {
+    IDataBlockPtr v = mesh->GetGeometrySet()->GetVertices();
+    if (v == NULL) return BoundingSphere();
+    return Get(v).sphere;
+}
+
+void MeshBounds::Invalidate(IDataBlock* vertices) {
+    entries.erase(vertices);
+}
+
+/**
+ * Drop the bounds of blocks that have been destroyed.
+ */
+void MeshBounds::NextFrame() {
+    std::map<IDataBlock*, Entry>::iterator itr = entries.begin();
+    while (itr != entries.end()) {
+        if (itr->second.block.expired())
+            entries.erase(itr++);
+        else
+            ++itr;
+    }
+}
+
+void MeshBounds::Clear() {
+    entries.clear();
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
@@ -0,0 +1,72 @@
+// Cached bounding volumes of vertex data.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_MESH_BOUNDS_H_
+#define _OPENGL_MESH_BOUNDS_H_
+
+#include <Renderers/OpenGL/Frustum.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <map>
+
+namespace OpenEngine {
+    // Forward declarations.
+    namespace Resources {
+        class IDataBlock;
+        typedef boost::shared_ptr<IDataBlock> IDataBlockPtr;
+    }
+    namespace Geometry {
+        class Mesh;
+    }
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Bounding volumes of a vertex data block in its own coordinate
+ * system.
+ */
+struct Bounds {
+    BoundingSphere sphere;
+    Vector<3, float> min, max;
+};
+
+/**
+ * Cache of bounding volumes computed from vertex data blocks.
+ *
+ * Bounds are computed the first time a block is looked up, from the
+ * client side data or, if the block has been unloaded, by reading
+ * the buffer object back. Blocks whose vertices cannot be read get
+ * infinite bounds. Changing the vertex data requires a call to
+ * Invalidate(). The bounds of blocks that have been destroyed are
+ * dropped at the start of the next frame.
+ *
+ * @class MeshBounds MeshBounds.h Renderers/OpenGL/MeshBounds.h
+ */
+class MeshBounds {
+private:
+    struct Entry {
+        boost::weak_ptr<Resources::IDataBlock> block;
+        Bounds bounds;
+    };
+
+    static std::map<Resources::IDataBlock*, Entry> entries;
+    static Bounds Compute(Resources::IDataBlock* vertices);
+public:
+    static const Bounds& Get(Resources::IDataBlockPtr vertices);
+    static BoundingSphere GetSphere(Geometry::Mesh* mesh);
+    static void Invalidate(Resources::IDataBlock* vertices);
+    static void NextFrame();
+    static void Clear();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_MESH_BOUNDS_H_
@@ -0,0 +1,126 @@
+// OpenGL render queue.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/RenderQueue.h>
+#include <Geometry/Mesh.h>
+#include <Geometry/Material.h>
+#include <Geometry/GeometrySet.h>
+#include <Resources/ITexture2D.h>
+#include <Resources/OpenGLShader.h>
+
+#include <algorithm>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+using OpenEngine::Geometry::Mesh;
+using OpenEngine::Geometry::MaterialPtr;
+using OpenEngine::Resources::ITexture2DPtr;
+using OpenEngine::Resources::OpenGLShader;
+
+// Bit layout of the sort key, most significant first:
+// | state 8 | shader 14 | texture set 14 | geometry set 14 | depth 14 |
+static const unsigned int FIELD_BITS = 14;
+static const unsigned int FIELD_MAX = (1 << FIELD_BITS) - 1;
+
+static bool CompareItems(const DrawItem& a, const DrawItem& b) {
+    return a.key < b.key;
+}
+
+RenderQueue::RenderQueue() {}
+
+RenderQueue::~RenderQueue() {}
+
+template <class K>
+unsigned int RenderQueue::Ordinal(std::map<K, unsigned int>& ordinals, K key) {
+    typename std::map<K, unsigned int>::iterator itr = ordinals.find(key);
+    if (itr != ordinals.end()) return itr->second;
+    unsigned int ord = std::min((unsigned int)ordinals.size(), FIELD_MAX);
+    ordinals[key] = ord;
+    return ord;
+}
+
+void RenderQueue::Add(Mesh* mesh, Matrix<4,4,float> modelView,
+                      unsigned int state, unsigned int stateMask) {
+    DrawItem item;
+    item.mesh = mesh;
+    item.modelView = modelView;
+    item.state = state;
+    item.stateMask = stateMask;
+    item.key = 0;
+    items.push_back(item);
+}
+
+/**
+ * Compute the sort key of every queued item and sort the queue.
+ * Ordinals are handed out in first seen order, so the key only
+ * groups equal resources together, it does not impose any global
+ * ordering between them.
+ */
+void RenderQueue::Sort() {
+    if (items.empty()) return;
+
+    // Find the depth range of the queue to quantize depth with.
+    float minDepth = 0, maxDepth = 0;
+    std::vector<float> depths(items.size());
+    for (unsigned int i = 0; i < items.size(); ++i) {
+        float f[16];
+        items[i].modelView.ToArray(f);
+        // The camera looks down the negative z-axis.
+        depths[i] = -f[14];
+        if (i == 0 || depths[i] < minDepth) minDepth = depths[i];
+        if (i == 0 || depths[i] > maxDepth) maxDepth = depths[i];
+    }
+    float range = maxDepth - minDepth;
+
+    for (unsigned int i = 0; i < items.size(); ++i) {
+        DrawItem& item = items[i];
+        MaterialPtr mat = item.mesh->GetMaterial();
+
+        // Hash the texture ids of the material into a texture set.
+        unsigned int texHash = 2166136261u;
+        std::map<std::string, ITexture2DPtr> texs = mat->Get2DTextures();
+        std::map<std::string, ITexture2DPtr>::iterator tex = texs.begin();
+        for (; tex != texs.end(); ++tex) {
+            unsigned int id = tex->second ? tex->second->GetID() : 0;
+            texHash = (texHash ^ id) * 16777619u;
+        }
+
+        // Materials sharing a program are grouped, switching between
+        // them only restores uniforms.
+        OpenGLShader* glShader = dynamic_cast<OpenGLShader*>(mat->shad.get());
+        unsigned int program = glShader ? glShader->GetProgramID() : 0;
+        unsigned long long shader = Ordinal<unsigned int>(shaders, program);
+        unsigned long long texture = Ordinal<unsigned int>(textureSets, texHash);
+        unsigned long long geom = Ordinal<void*>(geometries, item.mesh->GetGeometrySet().get());
+        unsigned long long depth = 0;
+        if (range > 0)
+            depth = (unsigned long long)((depths[i] - minDepth) / range * FIELD_MAX);
+
+        item.key = ((unsigned long long)(item.state & 0xFF) << (4 * FIELD_BITS))
+            | (shader << (3 * FIELD_BITS))
+            | (texture << (2 * FIELD_BITS))
+            | (geom << FIELD_BITS)
+            | depth;
+    }
+
+    std::stable_sort(items.begin(), items.end(), CompareItems);
+}
+
+void RenderQueue::Clear() {
+    items.clear();
+    shaders.clear();
+    textureSets.clear();
+    geometries.clear();
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
@@ -0,0 +1,73 @@
+// OpenGL render queue.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_RENDER_QUEUE_H_
+#define _OPENGL_RENDER_QUEUE_H_
+
+#include <Math/Matrix.h>
+#include <vector>
+#include <map>
+
+namespace OpenEngine {
+    // Forward declarations.
+    namespace Geometry {
+        class Mesh;
+    }
+namespace Renderers {
+namespace OpenGL {
+
+using OpenEngine::Math::Matrix;
+
+/**
+ * A single draw recorded during scene traversal.
+ */
+struct DrawItem {
+    Geometry::Mesh* mesh;
+    Matrix<4,4,float> modelView;
+    unsigned int state;      // packed render state options
+    unsigned int stateMask;  // which of the options are known
+    unsigned long long key;  // sort key, computed by RenderQueue::Sort
+};
+
+/**
+ * Queue of draw items that is sorted by a packed key before
+ * submission. The key orders by render state, shader, texture set,
+ * geometry set and finally front to back depth, so consecutive items
+ * share as much GL state as possible.
+ *
+ * @class RenderQueue RenderQueue.h Renderers/OpenGL/RenderQueue.h
+ */
+class RenderQueue {
+private:
+    std::vector<DrawItem> items;
+    std::map<unsigned int, unsigned int> shaders;
+    std::map<unsigned int, unsigned int> textureSets;
+    std::map<void*, unsigned int> geometries;
+
+    template <class K>
+    unsigned int Ordinal(std::map<K, unsigned int>& ordinals, K key);
+public:
+    RenderQueue();
+    virtual ~RenderQueue();
+
+    void Add(Geometry::Mesh* mesh, Matrix<4,4,float> modelView,
+             unsigned int state, unsigned int stateMask);
+    void Sort();
+    void Clear();
+
+    bool IsEmpty() const { return items.empty(); }
+    unsigned int GetSize() const { return items.size(); }
+    DrawItem& GetItem(unsigned int i) { return items[i]; }
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_RENDER_QUEUE_H_
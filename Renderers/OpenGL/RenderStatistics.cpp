@@ -0,0 +1,59 @@
+// OpenGL per frame rendering statistics.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/RenderStatistics.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+RenderStatistics RenderStatistics::current;
+
+RenderStatistics::RenderStatistics() {
+    Reset();
+}
+
+void RenderStatistics::Reset() {
+    drawElements = drawInstanced = drawArrays = drawLists = drawQuads = 0;
+    primitives = indices = 0;
+    programBinds = textureBinds = bufferBinds = 0;
+    framebufferBinds = vertexArrayBinds = 0;
+    otherStateChanges = filteredStateChanges = 0;
+    bufferBytes = textureBytes = 0;
+}
+
+unsigned int RenderStatistics::GetDrawCalls() const {
+    return drawElements + drawInstanced + drawArrays + drawLists + drawQuads;
+}
+
+void RenderStatistics::Draw(GLenum mode, GLsizei count, GLsizei instances) {
+    unsigned long prims;
+    switch (mode) {
+    case GL_POINTS: prims = count; break;
+    case GL_LINES: prims = count / 2; break;
+    case GL_LINE_STRIP: prims = count > 1 ? count - 1 : 0; break;
+    case GL_LINE_LOOP: prims = count > 1 ? count : 0; break;
+    case GL_TRIANGLES: prims = count / 3; break;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN: prims = count > 2 ? count - 2 : 0; break;
+    case GL_QUADS: prims = count / 4; break;
+    case GL_QUAD_STRIP: prims = count > 3 ? count / 2 - 1 : 0; break;
+    default: prims = count > 2 ? 1 : 0; // polygon
+    }
+    primitives += prims * instances;
+    indices += (unsigned long)count * instances;
+}
+
+RenderStatistics& RenderStatistics::Current() {
+    return current;
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
@@ -0,0 +1,73 @@
+// OpenGL per frame rendering statistics.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_RENDER_STATISTICS_H_
+#define _OPENGL_RENDER_STATISTICS_H_
+
+#include <Meta/OpenGL.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Counts the work submitted to OpenGL in a frame.
+ *
+ * The counters of the frame being rendered are gathered in
+ * Current(). The renderer copies them at the end of each frame,
+ * together with the state changes counted by the GLStateCache, and
+ * resets them. The statistics of the last complete frame are
+ * available through Renderer::GetStatistics().
+ *
+ * @class RenderStatistics RenderStatistics.h Renderers/OpenGL/RenderStatistics.h
+ */
+struct RenderStatistics {
+    // draw calls by type
+    unsigned int drawElements;    //!< indexed draws
+    unsigned int drawInstanced;   //!< instanced indexed draws
+    unsigned int drawArrays;      //!< non-indexed draws
+    unsigned int drawLists;       //!< display lists called
+    unsigned int drawQuads;       //!< full screen effect quads
+
+    // geometry submitted, instances included
+    unsigned long primitives;
+    unsigned long indices;
+
+    // state changes sent to the driver, by category
+    unsigned int programBinds;
+    unsigned int textureBinds;
+    unsigned int bufferBinds;
+    unsigned int framebufferBinds;
+    unsigned int vertexArrayBinds;
+    unsigned int otherStateChanges;
+    unsigned int filteredStateChanges; //!< redundant changes skipped
+
+    // data sent to the gpu
+    unsigned long bufferBytes;
+    unsigned long textureBytes;
+
+    RenderStatistics();
+    void Reset();
+    unsigned int GetDrawCalls() const;
+
+    /**
+     * Count a draw call of count indices or vertices.
+     */
+    void Draw(GLenum mode, GLsizei count, GLsizei instances = 1);
+
+    static RenderStatistics& Current();
+private:
+    static RenderStatistics current;
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_RENDER_STATISTICS_H_
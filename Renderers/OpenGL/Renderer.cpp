@@ -9,6 +9,17 @@
 
 #include <Renderers/IRenderingView.h>
 #include <Renderers/OpenGL/Renderer.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Renderers/OpenGL/MeshBounds.h>
+#include <Renderers/OpenGL/UniformBlocks.h>
+#include <Renderers/OpenGL/TextureStreamer.h>
+#include <Renderers/OpenGL/ResidencyManager.h>
+#include <Renderers/OpenGL/BindlessTextures.h>
+#include <Renderers/OpenGL/VertexArrayCache.h>
+#include <Renderers/OpenGL/StreamBuffer.h>
+#include <Renderers/OpenGL/GPUProfiler.h>
+#include <Renderers/OpenGL/GLTracer.h>
+#include <Renderers/OpenGL/GLErrorCheck.h>
 #include <Scene/ISceneNode.h>
 #include <Logging/Logger.h>
 #include <Meta/OpenGL.h>
@@ -25,6 +36,8 @@
 #include <Resources/FrameBuffer.h>
 
 #include <Resources/OpenGLShader.h>
+#include <Resources/ShaderWatcher.h>
+#include <algorithm>
 
 using namespace OpenEngine::Resources;
 
@@ -39,8 +52,12 @@ using OpenEngine::Math::Matrix;
 using OpenEngine::Display::IViewingVolume;
 
 GLSLVersion Renderer::glslversion = GLSL_UNKNOWN;
+bool Renderer::vertexArraySupport = false;
+bool Renderer::instancingSupport = false;
+bool Renderer::uniformBufferSupport = false;
 
-Renderer::Renderer(): init(false)
+Renderer::Renderer(): init(false), time(0.0f), streaming(false), streamer(NULL)
+    , deferUploads(true), streamBufferSize(0), streamBuffer(NULL)
 {
     //backgroundColor = Vector<4,float>(1.0);
 }
@@ -50,6 +67,8 @@ Renderer::Renderer(): init(false)
  * Deletes the internal viewport.
  */
 Renderer::~Renderer() {
+    delete streamer;
+    delete streamBuffer;
 }
 
 void Renderer::InitializeGLSLVersion() {
@@ -284,6 +303,31 @@ void Renderer::Handle(Renderers::InitializeEventArg arg) {
 
     bufferSupport = glewIsSupported("GL_VERSION_2_0");
     fboSupport = glewGetExtension("GL_EXT_framebuffer_object") == GL_TRUE;
+    vertexArraySupport = bufferSupport &&
+        (glewIsSupported("GL_VERSION_3_0") ||
+         glewGetExtension("GL_ARB_vertex_array_object") == GL_TRUE);
+    instancingSupport = bufferSupport &&
+        glewGetExtension("GL_ARB_instanced_arrays") == GL_TRUE &&
+        glewGetExtension("GL_ARB_draw_instanced") == GL_TRUE;
+    uniformBufferSupport = bufferSupport &&
+        (glewIsSupported("GL_VERSION_3_1") ||
+         glewGetExtension("GL_ARB_uniform_buffer_object") == GL_TRUE);
+    if (uniformBufferSupport)
+        UniformBlocks::Initialize();
+    ShaderWatcher::Start();
+    ResidencyManager::SetRenderer(this);
+    if (streaming) {
+        if (TextureStreamer::IsSupported())
+            streamer = new TextureStreamer();
+        else
+            logger.warning << "Pixel buffer objects not supported, textures are loaded synchronously." << logger.end;
+    }
+    if (streamBufferSize > 0) {
+        if (StreamBuffer::IsSupported())
+            streamBuffer = new StreamBuffer(streamBufferSize);
+        else
+            logger.warning << "Buffer storage not supported, dynamic data blocks are not streamed." << logger.end;
+    }
         
     // Vector<4,float> bgc = backgroundColor;
     // glClearColor(bgc[0], bgc[1], bgc[2], bgc[3]);
@@ -293,7 +337,7 @@ void Renderer::Handle(Renderers::InitializeEventArg arg) {
     // CHECK_FOR_GL_ERROR();
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);						   
+    GLStateCache::Enable(GL_DEPTH_TEST);						   
     CHECK_FOR_GL_ERROR();
 
     // Set perspective calculations to most accurate
@@ -303,6 +347,9 @@ void Renderer::Handle(Renderers::InitializeEventArg arg) {
 
     this->stage = RENDERER_INITIALIZE;
     this->initialize.Notify(RenderingEventArg(arg.canvas, *this));
+#if OE_CHECK_GL
+    GLErrorCheck::Check("initialize");
+#endif
     this->stage = RENDERER_PREPROCESS;
     CHECK_FOR_GL_ERROR();
 
@@ -311,6 +358,26 @@ void Renderer::Handle(Renderers::InitializeEventArg arg) {
 
 void Renderer::Handle(Renderers::ProcessEventArg arg) {
     // @todo: assert we are in preprocess stage
+    GLTracer::BeginFrame();
+    GPUProfiler::BeginFrame();
+#if OE_CHECK_GL
+    GLErrorCheck::BeginFrame();
+#endif
+
+    // The gl state may have been changed outside the renderer since
+    // the last frame.
+    GLStateCache::Invalidate();
+
+    // Reload shaders whose sources changed since the last frame.
+    ShaderWatcher::ProcessReloads();
+
+    // Copy the textures streamed in since the last frame.
+    if (streamer) UploadStreamedTextures();
+
+    // Delete released textures and keep within the memory budget.
+    ResidencyManager::NextFrame();
+    // Drop the bounds of destroyed vertex blocks.
+    MeshBounds::NextFrame();
 
     Vector<4,float> bgc = backgroundColor;
     glClearColor(bgc[0], bgc[1], bgc[2], bgc[3]);
@@ -318,10 +385,18 @@ void Renderer::Handle(Renderers::ProcessEventArg arg) {
     // Clear the screen and the depth buffer.
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
+    // Upload the data blocks changed since the last frame, before the
+    // preprocess observers draw with them.
+    UploadDataBlocks();
 
     // run the processing phases
     RenderingEventArg rarg(arg.canvas, *this, arg.start, arg.approx);
+    GPUProfiler::Begin("preprocess");
     this->preProcess.Notify(rarg);
+    GPUProfiler::End();
+#if OE_CHECK_GL
+    GLErrorCheck::Check("preprocess");
+#endif
 
 
     IViewingVolume* volume = arg.canvas.GetViewingVolume();
@@ -331,7 +406,7 @@ void Renderer::Handle(Renderers::ProcessEventArg arg) {
 
         // Set viewport size 
         Vector<4,int> d(0, 0, arg.canvas.GetWidth(), arg.canvas.GetHeight());
-        glViewport((GLsizei)d[0], (GLsizei)d[1], (GLsizei)d[2], (GLsizei)d[3]);
+        GLStateCache::Viewport((GLsizei)d[0], (GLsizei)d[1], (GLsizei)d[2], (GLsizei)d[3]);
         CHECK_FOR_GL_ERROR();
 
         // apply the volume
@@ -339,11 +414,59 @@ void Renderer::Handle(Renderers::ProcessEventArg arg) {
     }
     CHECK_FOR_GL_ERROR();
 
+    time += arg.approx / 1000000.0f;
+    if (uniformBufferSupport) {
+        UniformBlocks::FrameBlock& frame = UniformBlocks::GetFrameBlock();
+        if (volume != NULL) {
+            float* v = frame.viewMatrix;
+            volume->GetViewMatrix().ToArray(v);
+            volume->GetProjectionMatrix().ToArray(frame.projectionMatrix);
+            // the view is rigid, so the camera is at -R^T t
+            for (unsigned int i = 0; i < 3; ++i)
+                frame.cameraPosition[i] = 
+                    -(v[i * 4] * v[12] + v[i * 4 + 1] * v[13] + v[i * 4 + 2] * v[14]);
+            frame.cameraPosition[3] = 1.0f;
+        }
+        frame.time[0] = time;
+        frame.time[1] = arg.approx / 1000000.0f;
+        UniformBlocks::UpdateFrameBlock();
+    }
+
     this->stage = RENDERER_PROCESS;
+    GPUProfiler::Begin("process");
     this->process.Notify(rarg);
+    GPUProfiler::End();
+#if OE_CHECK_GL
+    GLErrorCheck::Check("process");
+#endif
     this->stage = RENDERER_POSTPROCESS;
+    GPUProfiler::Begin("postprocess");
     this->postProcess.Notify(rarg);
+    GPUProfiler::End();
+#if OE_CHECK_GL
+    GLErrorCheck::Check("postprocess");
+    GLErrorCheck::EndFrame();
+#endif
     this->stage = RENDERER_PREPROCESS;
+    deferUploads = true;
+
+    if (streamBuffer) streamBuffer->EndFrame();
+    GPUProfiler::EndFrame();
+    GLTracer::EndFrame();
+
+    // Keep the statistics of the frame and start counting the next.
+    statistics = RenderStatistics::Current();
+    GLStateCache::Counters c = GLStateCache::GetCounters();
+    statistics.programBinds = c.programs;
+    statistics.textureBinds = c.textures;
+    statistics.bufferBinds = c.buffers;
+    statistics.framebufferBinds = c.framebuffers;
+    statistics.vertexArrayBinds = c.vertexArrays;
+    statistics.otherStateChanges = c.issued - c.programs - c.textures - 
+        c.buffers - c.framebuffers - c.vertexArrays;
+    statistics.filteredStateChanges = c.filtered;
+    RenderStatistics::Current().Reset();
+    GLStateCache::ResetCounters();
 }
 
 
@@ -359,6 +482,18 @@ void Renderer::Handle(Renderers::DeinitializeEventArg arg) {
     if (!init) return;
     this->stage = RENDERER_DEINITIALIZE;
     this->deinitialize.Notify(RenderingEventArg(arg.canvas, *this));
+    OpenGLShader::Deinitialize();
+    UniformBlocks::Deinitialize();
+    VertexArrayCache::Clear();
+    BindlessTextures::Clear();
+    ShaderWatcher::Stop();
+    delete streamer;
+    streamer = NULL;
+    delete streamBuffer;
+    streamBuffer = NULL;
+    streamedBlocks.clear();
+    ResidencyManager::Clear();
+    MeshBounds::Clear();
     init = false;
 }
 
@@ -414,6 +549,18 @@ bool Renderer::IsGLSLSupported() {
     return (glslversion != GLSL_NONE && glslversion != GLSL_UNKNOWN);
 }
 
+bool Renderer::IsVertexArraySupported() {
+    return vertexArraySupport;
+}
+
+bool Renderer::IsInstancingSupported() {
+    return instancingSupport;
+}
+
+bool Renderer::IsUniformBufferSupported() {
+    return uniformBufferSupport;
+}
+
 bool Renderer::BufferSupport(){
     return bufferSupport;
 }
@@ -426,15 +573,110 @@ GLSLVersion Renderer::GetGLSLVersion() {
     return glslversion;
 }
 
+void Renderer::SetTextureStreaming(bool enabled) {
+    streaming = enabled;
+}
+
+unsigned int Renderer::GetPendingTextureCount() {
+    return streamer ? streamer->GetPendingCount() : 0;
+}
+
+void Renderer::SetStreamBufferSize(unsigned int bytes) {
+    streamBufferSize = bytes;
+}
+
+StreamBuffer* Renderer::GetStreamBuffer() {
+    return streamBuffer;
+}
+
+const RenderStatistics& Renderer::GetStatistics() const {
+    return statistics;
+}
+
 void Renderer::LoadTexture(ITexture2DPtr texr) {
-    LoadTexture(texr.get());
+    if (texr == NULL || texr->GetID() != 0) return;
+    if (streamer == NULL) {
+        bool reloadable = LoadTextureData(texr.get());
+        ResidencyManager::AddTexture(texr, reloadable);
+        return;
+    }
+
+    // Give the texture a white placeholder until the streamed data
+    // arrives.
+    GLuint texid;
+    glGenTextures(1, &texid);
+    texr->SetID(texid);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, texid);
+    const GLubyte white[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, 
+                 GL_RGBA, GL_UNSIGNED_BYTE, white);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
+    CHECK_FOR_GL_ERROR();
+
+    streamer->Enqueue(texr);
+}
+
+/**
+ * Copy the textures in the filled pixel buffers of the streamer to
+ * their textures. The copy is performed by the driver, the data is
+ * already on its side.
+ */
+void Renderer::UploadStreamedTextures() {
+    std::vector<TextureStreamer::Upload> uploads = streamer->Update();
+    for (unsigned int i = 0; i < uploads.size(); ++i) {
+        ITexture2D* texr = uploads[i].texture.get();
+        GLuint texid = texr->GetID();
+        if (BindlessTextures::HasHandle(texid)) {
+            // The placeholder was used bindless and can no longer be
+            // respecified, swap in a fresh texture object. Shaders
+            // pick up the handle of the new id when applied.
+            BindlessTextures::Forget(texid);
+            GLStateCache::ForgetTexture(texid);
+            glDeleteTextures(1, &texid);
+            glGenTextures(1, &texid);
+            texr->SetID(texid);
+        }
+        GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, uploads[i].buffer);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, texid);
+        SetupTexParameters(texr);
+        SetTextureCompression(texr);
+        glTexImage2D(GL_TEXTURE_2D,
+                     0, // mipmap level
+                     GLInternalColorFormat(texr->GetColorFormat()),
+                     texr->GetWidth(),
+                     texr->GetHeight(),
+                     0, // border
+                     GLColorFormat(texr->GetColorFormat()),
+                     texr->GetType(),
+                     NULL); // offset into the pixel buffer
+        CHECK_FOR_GL_ERROR();
+        RenderStatistics::Current().textureBytes += ResidencyManager::TextureBytes(texr);
+        ResidencyManager::AddTexture(uploads[i].texture, true);
+        streamer->Release(uploads[i]);
+    }
+    if (!uploads.empty()) {
+        GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
+    }
 }
 void Renderer::LoadTexture(ITexture2D* texr) {
+    LoadTextureData(texr);
+}
+
+/**
+ * Upload a texture.
+ *
+ * @return True if the texture has data that can be restored, used
+ * to decide if it can be evicted.
+ */
+bool Renderer::LoadTextureData(ITexture2D* texr) {
     // check for null pointers
-    if (texr == NULL) return;
+    if (texr == NULL) return false;
 
     // check if textures has already been bound.
-    if (texr->GetID() != 0) return;
+    if (texr->GetID() != 0) return false;
 
     // signal we need the texture data if not loaded.
     bool loaded = true;
@@ -442,6 +684,9 @@ void Renderer::LoadTexture(ITexture2D* texr) {
         loaded = false;
         texr->Load(); //@todo: what the #@!%?
     }
+    // textures without data, like frame buffer attachments, are
+    // only filled on the gpu
+    bool reloadable = texr->GetVoidDataPtr() != NULL;
 
 
     // Generate and bind the texture id.
@@ -450,7 +695,7 @@ void Renderer::LoadTexture(ITexture2D* texr) {
     CHECK_FOR_GL_ERROR();
 
     texr->SetID(texid);
-    glBindTexture(GL_TEXTURE_2D, texid);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, texid);
     CHECK_FOR_GL_ERROR();
     
     SetupTexParameters(texr);
@@ -470,12 +715,15 @@ void Renderer::LoadTexture(ITexture2D* texr) {
                  texr->GetType(),
                  texr->GetVoidDataPtr());
     CHECK_FOR_GL_ERROR();
+    if (reloadable)
+        RenderStatistics::Current().textureBytes += ResidencyManager::TextureBytes(texr);
     
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
 
     // Return the texture in the state we got it.
     if (!loaded)
         texr->Unload();
+    return reloadable;
 }
 
 void Renderer::LoadTexture(ITexture3DPtr texr) {
@@ -508,7 +756,7 @@ void Renderer::LoadTexture(ITexture3D* texr) {
     CHECK_FOR_GL_ERROR();
 
     texr->SetID(texid);
-    glBindTexture(texr->GetUseCase(), texid);
+    GLStateCache::BindTexture(texr->GetUseCase(), texid);
     CHECK_FOR_GL_ERROR();
     
     SetupTexParameters(texr);
@@ -528,6 +776,8 @@ void Renderer::LoadTexture(ITexture3D* texr) {
                  texr->GetType(),
                  texr->GetVoidDataPtr());
     CHECK_FOR_GL_ERROR();
+    RenderStatistics::Current().textureBytes += texr->GetWidth() * texr->GetHeight() * 
+        texr->GetDepth() * texr->GetChannels() * texr->GetChannelSize() / 8;
     
     // Return the texture in the state we got it.
     if (!loaded)
@@ -548,11 +798,15 @@ void Renderer::RebindTexture(ITexture2D* texr, unsigned int xOffset, unsigned in
 
     // Bind the texture
     GLuint texid = texr->GetID();
-    glBindTexture(GL_TEXTURE_2D, texid);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, texid);
     CHECK_FOR_GL_ERROR();
 
-    // Setup texture parameters
-    SetupTexParameters(texr);
+    // Setup texture parameters. Those of a texture with a bindless
+    // handle are fixed, only its contents can change.
+    if (BindlessTextures::HasHandle(texid))
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    else
+        SetupTexParameters(texr);
 
     GLenum colorFormat = GLColorFormat(texr->GetColorFormat());
 
@@ -566,6 +820,8 @@ void Renderer::RebindTexture(ITexture2D* texr, unsigned int xOffset, unsigned in
                     texr->GetType(),
                     texr->GetVoidDataPtr());
     CHECK_FOR_GL_ERROR();
+    RenderStatistics::Current().textureBytes += 
+        width * height * texr->GetChannels() * texr->GetChannelSize() / 8;
 
 }
 
@@ -583,11 +839,15 @@ void Renderer::RebindTexture(ITexture3D* texr, unsigned int xOffset, unsigned in
 
     // Bind the texture
     GLuint texid = texr->GetID();
-    glBindTexture(texr->GetUseCase(), texid);
+    GLStateCache::BindTexture(texr->GetUseCase(), texid);
     CHECK_FOR_GL_ERROR();
 
-    // Setup texture parameters
-    SetupTexParameters(texr);
+    // Setup texture parameters. Those of a texture with a bindless
+    // handle are fixed, only its contents can change.
+    if (BindlessTextures::HasHandle(texid))
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    else
+        SetupTexParameters(texr);
 
     GLenum colorFormat = GLColorFormat(texr->GetColorFormat());
 
@@ -603,6 +863,8 @@ void Renderer::RebindTexture(ITexture3D* texr, unsigned int xOffset, unsigned in
                     texr->GetType(),
                     texr->GetVoidDataPtr());
     CHECK_FOR_GL_ERROR();
+    RenderStatistics::Current().textureBytes += 
+        width * height * depth * texr->GetChannels() * texr->GetChannelSize() / 8;
 
 }
 
@@ -617,7 +879,7 @@ void Renderer::BindFrameBuffer(FrameBuffer* fb){
     glGenFramebuffersEXT(1, &fboID);
     CHECK_FOR_GL_ERROR();
     fb->SetID(fboID);
-    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, fboID);
+    GLStateCache::BindFramebuffer(GL_FRAMEBUFFER_EXT, fboID);
     CHECK_FOR_GL_ERROR();
 
     /*
@@ -632,7 +894,7 @@ void Renderer::BindFrameBuffer(FrameBuffer* fb){
     for (unsigned int i = 0; i < fb->GetNumberOfAttachments(); ++i){
         ITexture2DPtr tex = fb->GetTexAttachment(i);
         LoadTexture(tex.get());
-        glBindTexture(GL_TEXTURE_2D, tex->GetID());  // Why is this needed?
+        GLStateCache::BindTexture(GL_TEXTURE_2D, tex->GetID());  // Why is this needed?
         glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, 
                                   GL_COLOR_ATTACHMENT0_EXT + i,
                                   GL_TEXTURE_2D, tex->GetID(), 0);
@@ -641,7 +903,7 @@ void Renderer::BindFrameBuffer(FrameBuffer* fb){
 
     if (fb->GetDepthTexture() != NULL) {
         LoadTexture(fb->GetDepthTexture());
-        glBindTexture(GL_TEXTURE_2D, fb->GetDepthTexture()->GetID()); // Why is this needed?
+        GLStateCache::BindTexture(GL_TEXTURE_2D, fb->GetDepthTexture()->GetID()); // Why is this needed?
         glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT, 
                                   GL_DEPTH_ATTACHMENT_EXT,
                                   GL_TEXTURE_2D, fb->GetDepthTexture()->GetID(), 0);
@@ -660,7 +922,7 @@ void Renderer::BindFrameBuffer(FrameBuffer* fb){
     }
     CHECK_FRAMEBUFFER_STATUS();
 
-    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    GLStateCache::BindFramebuffer(GL_FRAMEBUFFER_EXT, 0);
 }
 
 void Renderer::BindDataBlock(IDataBlock* bo){
@@ -676,7 +938,7 @@ void Renderer::BindDataBlock(IDataBlock* bo){
         CHECK_FOR_GL_ERROR();
     
         bo->SetID(id);
-        glBindBuffer(bo->GetBlockType(), id);
+        GLStateCache::BindBuffer(bo->GetBlockType(), id);
         CHECK_FOR_GL_ERROR();
     
         unsigned int size = GLTypeSize(bo->GetType()) * bo->GetSize() * bo->GetDimension();
@@ -685,6 +947,8 @@ void Renderer::BindDataBlock(IDataBlock* bo){
         glBufferData(bo->GetBlockType(), 
                      size,
                      bo->GetVoidDataPtr(), access);
+        ResidencyManager::AddBuffer(id, size);
+        RenderStatistics::Current().bufferBytes += size;
         
         if (bo->GetUnloadPolicy() == UNLOAD_AUTOMATIC)
             bo->Unload();
@@ -694,41 +958,154 @@ void Renderer::BindDataBlock(IDataBlock* bo){
     // graphics card..
 }
 
+/**
+ * Upload the elements from start to end (exclusive) of a data
+ * block. Changes made before the process phase are collected and
+ * uploaded together when it starts, so several changes to a block in
+ * one frame cost one upload of the ranges they cover.
+ */
 void Renderer::RebindDataBlock(IDataBlockPtr ptr, unsigned int start, unsigned int end) {
     IDataBlock* bo = ptr.get();
-    if (bufferSupport){
-        GLuint id;
-        id = bo->GetID();
+    MeshBounds::Invalidate(bo);
+    // Do not unload if there's no buffer support. We will need the
+    // data in memory client side to be able to pass it to the
+    // graphics card..
+    if (!bufferSupport) return;
 
-        glBindBuffer(bo->GetBlockType(), id);
-        CHECK_FOR_GL_ERROR();
+    if (end > bo->GetSize() || end <= start) {
+        start = 0;
+        end = bo->GetSize();
+    }
     
-        unsigned int size = GLTypeSize(bo->GetType()) * bo->GetSize() * bo->GetDimension();
+    DirtyBlock& dirty = dirtyBlocks[bo];
+    dirty.block = ptr;
+    dirty.ranges.push_back(std::make_pair(start, end));
+
+    // Inside a frame the block is needed right away.
+    if (!deferUploads || stage != RENDERER_PREPROCESS) {
+        if (!StreamDataBlock(ptr))
+            UploadDataBlock(bo, dirty.ranges);
+        dirtyBlocks.erase(bo);
+    }
+}
+
+void Renderer::UploadDataBlocks() {
+    if (streamBuffer) {
+        streamBuffer->BeginFrame();
+        // Blocks that did not change since the last frame go back
+        // to their own buffers.
+        std::map<IDataBlock*, IDataBlockPtr>::iterator s = streamedBlocks.begin();
+        while (s != streamedBlocks.end()) {
+            if (dirtyBlocks.find(s->first) == dirtyBlocks.end()) {
+                Ranges all(1, std::make_pair(0u, s->first->GetSize()));
+                UploadDataBlock(s->first, all);
+                streamedBlocks.erase(s++);
+            } else ++s;
+        }
+    }
+
+    std::map<IDataBlock*, DirtyBlock>::iterator itr = dirtyBlocks.begin();
+    for (; itr != dirtyBlocks.end(); ++itr)
+        if (!StreamDataBlock(itr->second.block))
+            UploadDataBlock(itr->first, itr->second.ranges);
+    dirtyBlocks.clear();
+    deferUploads = false;
+}
+
+/**
+ * Copy a dynamic vertex data block into the stream buffer.
+ *
+ * @return False if the block is not streamed and must be uploaded
+ * to its own buffer.
+ */
+bool Renderer::StreamDataBlock(IDataBlockPtr block) {
+    if (streamBuffer == NULL || 
+        block->GetUpdateMode() != DYNAMIC ||
+        (GLenum)block->GetBlockType() != GL_ARRAY_BUFFER)
+        return false;
+    unsigned int size = GLTypeSize(block->GetType()) * block->GetSize() * block->GetDimension();
+    if (!streamBuffer->Stream(block.get(), size)) {
+        // The stream buffer is full. The own buffer of a block that
+        // was streamed is out of date as a whole.
+        if (streamedBlocks.erase(block.get()) > 0) {
+            Ranges all(1, std::make_pair(0u, block->GetSize()));
+            UploadDataBlock(block.get(), all);
+            return true;
+        }
+        return false;
+    }
+    // The cpu copy is kept while streaming.
+    streamedBlocks[block.get()] = block;
+    RenderStatistics::Current().bufferBytes += size;
+    return true;
+}
+
+/**
+ * Upload the changed ranges of a block. Overlapping and nearby
+ * ranges are merged, and when most of the block changed it is
+ * replaced as a whole, orphaning the old storage of dynamic blocks
+ * so the driver does not wait for draws still reading it.
+ */
+void Renderer::UploadDataBlock(IDataBlock* bo, Ranges& ranges) {
+    GLenum target = bo->GetBlockType();
+    GLuint id = bo->GetID();
+    unsigned int element = GLTypeSize(bo->GetType()) * bo->GetDimension();
+    unsigned int size = element * bo->GetSize();
+    char* data = (char*)bo->GetVoidDataPtr();
+#if OE_SAFE
+    if (id == 0) throw Exception("Cannot rebind unbound data block.");
+    if (data == NULL) throw Exception("Cannot rebind data block with no data.");
+#endif
+
+    // Merge ranges closer than this many bytes, a separate call
+    // costs more than sending the gap.
+    const unsigned int gap = 4096 / std::max(element, 1u);
+    std::sort(ranges.begin(), ranges.end());
+    Ranges merged;
+    unsigned int covered = 0;
+    for (unsigned int i = 0; i < ranges.size(); ++i) {
+        if (!merged.empty() && ranges[i].first <= merged.back().second + gap)
+            merged.back().second = std::max(merged.back().second, ranges[i].second);
+        else
+            merged.push_back(ranges[i]);
+    }
+    for (unsigned int i = 0; i < merged.size(); ++i)
+        covered += merged[i].second - merged[i].first;
+
+    GLStateCache::BindBuffer(target, id);
+    CHECK_FOR_GL_ERROR();
+    if (covered * 2 > bo->GetSize()) {
         GLenum access = GLAccessType(bo->GetBlockType(), bo->GetUpdateMode());
-        // glBufferSubData(bo->GetBlockType(), 
-        //                 start,
-        //                 end-start,
-        //                 bo->GetVoidDataPtr());
-        glBufferData(bo->GetBlockType(), 
-                     size,
-                     bo->GetVoidDataPtr(), access);
-        
-        if (bo->GetUnloadPolicy() == UNLOAD_AUTOMATIC)
-            bo->Unload();
+        if (bo->GetUpdateMode() == DYNAMIC) {
+            glBufferData(target, size, NULL, access);
+            glBufferSubData(target, 0, size, data);
+        } else
+            glBufferData(target, size, data, access);
+        ResidencyManager::AddBuffer(id, size);
+        RenderStatistics::Current().bufferBytes += size;
+    } else {
+        for (unsigned int i = 0; i < merged.size(); ++i) {
+            unsigned int offset = merged[i].first * element;
+            glBufferSubData(target, offset, 
+                            (merged[i].second - merged[i].first) * element, 
+                            data + offset);
+        }
+        RenderStatistics::Current().bufferBytes += covered * element;
     }
-    // Do not unload if there's no buffer support. We will need the
-    // data in memory client side to be able to pass it to the
-    // graphics card..
+    CHECK_FOR_GL_ERROR();
+        
+    if (bo->GetUnloadPolicy() == UNLOAD_AUTOMATIC)
+        bo->Unload();
 }
 
 
 void Renderer::DrawFace(FacePtr f) {
     if (f->mat->Get2DTextures().size() == 0) {
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glDisable(GL_TEXTURE_2D);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
+        GLStateCache::Disable(GL_TEXTURE_2D);
     } else {
-        glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, (*f->mat->Get2DTextures().begin()).second->GetID());
+        GLStateCache::Enable(GL_TEXTURE_2D);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, (*f->mat->Get2DTextures().begin()).second->GetID());
     }
     float col[4];
     f->mat->diffuse.ToArray(col);
@@ -753,7 +1130,7 @@ void Renderer::DrawFace(FacePtr f) {
         glVertex3f(v[0],v[1],v[2]);
     }
     glEnd();
-    glDisable(GL_TEXTURE_2D);
+    GLStateCache::Disable(GL_TEXTURE_2D);
 }
 
 /**
@@ -764,11 +1141,11 @@ void Renderer::DrawFace(FacePtr f) {
  * @param width line width, default i one.
  */
 void Renderer::DrawFace(FacePtr face, Vector<3,float> color, float width) {
-    GLboolean t = glIsEnabled(GL_TEXTURE_2D);
-    GLboolean l = glIsEnabled(GL_LIGHTING);
+    GLboolean t = GLStateCache::IsEnabled(GL_TEXTURE_2D);
+    GLboolean l = GLStateCache::IsEnabled(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_LIGHTING);
+    GLStateCache::Disable(GL_TEXTURE_2D);
+    GLStateCache::Disable(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
 
     glLineWidth(width);
@@ -788,8 +1165,8 @@ void Renderer::DrawFace(FacePtr face, Vector<3,float> color, float width) {
     CHECK_FOR_GL_ERROR();
 
     // reset state
-    if (t) glEnable(GL_TEXTURE_2D);
-    if (l) glEnable(GL_LIGHTING);
+    if (t) GLStateCache::Enable(GL_TEXTURE_2D);
+    if (l) GLStateCache::Enable(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
 }
 
@@ -801,11 +1178,11 @@ void Renderer::DrawFace(FacePtr face, Vector<3,float> color, float width) {
  * @param width line width, default i one.
  */
 void Renderer::DrawLine(Line line, Vector<3,float> color, float width) {
-    GLboolean t = glIsEnabled(GL_TEXTURE_2D);
-    GLboolean l = glIsEnabled(GL_LIGHTING);
+    GLboolean t = GLStateCache::IsEnabled(GL_TEXTURE_2D);
+    GLboolean l = GLStateCache::IsEnabled(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_LIGHTING);
+    GLStateCache::Disable(GL_TEXTURE_2D);
+    GLStateCache::Disable(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
 
     glLineWidth(width);
@@ -819,8 +1196,8 @@ void Renderer::DrawLine(Line line, Vector<3,float> color, float width) {
     CHECK_FOR_GL_ERROR();
 
     // reset state 
-    if (t) glEnable(GL_TEXTURE_2D);
-    if (l) glEnable(GL_LIGHTING);
+    if (t) GLStateCache::Enable(GL_TEXTURE_2D);
+    if (l) GLStateCache::Enable(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
 }
 
@@ -832,11 +1209,11 @@ void Renderer::DrawLine(Line line, Vector<3,float> color, float width) {
  * @param size dot size, default i one.
  */
 void Renderer::DrawPoint(Vector<3,float> point, Vector<3,float> color , float size) {
-    GLboolean t = glIsEnabled(GL_TEXTURE_2D);
-    GLboolean l = glIsEnabled(GL_LIGHTING);
+    GLboolean t = GLStateCache::IsEnabled(GL_TEXTURE_2D);
+    GLboolean l = GLStateCache::IsEnabled(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_LIGHTING);
+    GLStateCache::Disable(GL_TEXTURE_2D);
+    GLStateCache::Disable(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
 
     glPointSize(size);
@@ -849,8 +1226,8 @@ void Renderer::DrawPoint(Vector<3,float> point, Vector<3,float> color , float si
     CHECK_FOR_GL_ERROR();
 
     // reset state
-    if (t) glEnable(GL_TEXTURE_2D);
-    if (l) glEnable(GL_LIGHTING);
+    if (t) GLStateCache::Enable(GL_TEXTURE_2D);
+    if (l) GLStateCache::Enable(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
 }
 
@@ -870,11 +1247,11 @@ Vector<4,float> Renderer::GetBackgroundColor() {
  * @param color  Color of sphere.
  */
     void Renderer::DrawSphere(Vector<3,float> center, float radius, Vector<3,float> color) {
-    GLboolean t = glIsEnabled(GL_TEXTURE_2D);
-    GLboolean l = glIsEnabled(GL_LIGHTING);
+    GLboolean t = GLStateCache::IsEnabled(GL_TEXTURE_2D);
+    GLboolean l = GLStateCache::IsEnabled(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_LIGHTING);
+    GLStateCache::Disable(GL_TEXTURE_2D);
+    GLStateCache::Disable(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
 
     glPushMatrix();
@@ -890,8 +1267,8 @@ Vector<4,float> Renderer::GetBackgroundColor() {
     glPopMatrix();
 
     // reset state
-    if (t) glEnable(GL_TEXTURE_2D);
-    if (l) glEnable(GL_LIGHTING);
+    if (t) GLStateCache::Enable(GL_TEXTURE_2D);
+    if (l) GLStateCache::Enable(GL_LIGHTING);
     CHECK_FOR_GL_ERROR();
 }
 
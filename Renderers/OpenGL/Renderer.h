@@ -16,9 +16,11 @@
 #include <Math/Matrix.h>
 #include <Geometry/Face.h>
 #include <vector>
+#include <map>
 #include <Resources/ITexture.h>
 #include <Resources/IDataBlock.h>
 #include <Meta/OpenGL.h>
+#include <Renderers/OpenGL/RenderStatistics.h>
 
 namespace OpenEngine {
 
@@ -39,6 +41,8 @@ namespace Renderers {
  */
 namespace OpenGL {
 
+class TextureStreamer;
+class StreamBuffer;
 
 using OpenEngine::Math::Matrix;
 using OpenEngine::Geometry::FacePtr;
@@ -63,12 +67,38 @@ enum GLSLVersion { GLSL_UNKNOWN, GLSL_NONE, GLSL_14, GLSL_20 };
 class Renderer : public IRenderer {
 private:
     static GLSLVersion glslversion;
+    static bool vertexArraySupport;
+    static bool instancingSupport;
+    static bool uniformBufferSupport;
     bool texture2DArraySupport;
     bool compressionSupport;
     bool bufferSupport;
     bool fboSupport;
     bool init;
     Vector<4,float> backgroundColor;
+    float time;
+    bool streaming;
+    TextureStreamer* streamer;
+
+    // Element ranges of data blocks changed between frames, uploaded
+    // together when the next frame starts. Within the frame blocks
+    // are uploaded right away.
+    bool deferUploads;
+    typedef std::vector<std::pair<unsigned int, unsigned int> > Ranges;
+    struct DirtyBlock {
+        Resources::IDataBlockPtr block;
+        Ranges ranges;
+    };
+    std::map<IDataBlock*, DirtyBlock> dirtyBlocks;
+
+    // Dynamic blocks changing every frame are drawn from the stream
+    // buffer instead of their own buffer.
+    unsigned int streamBufferSize;
+    StreamBuffer* streamBuffer;
+    std::map<IDataBlock*, Resources::IDataBlockPtr> streamedBlocks;
+
+    // statistics of the last complete frame
+    RenderStatistics statistics;
 
     // Event lists for the rendering phases.
     Event<RenderingEventArg> initialize;
@@ -81,6 +111,11 @@ private:
     inline void SetupTexParameters(ITexture2D* tex);
     inline void SetupTexParameters(ITexture3D* tex);
     inline void SetTextureCompression(ITexture* tex);
+    void UploadStreamedTextures();
+    bool LoadTextureData(ITexture2D* texr);
+    void UploadDataBlocks();
+    void UploadDataBlock(IDataBlock* bo, Ranges& ranges);
+    bool StreamDataBlock(Resources::IDataBlockPtr block);
 
     inline unsigned int GLTypeSize(Type t);
     inline GLenum GLAccessType(BlockType b, UpdateMode u);
@@ -113,6 +148,30 @@ public:
      */
     static bool IsGLSLSupported();
 
+    /**
+     * Test if vertex array objects are supported.
+     *
+     * @return True if support is found.
+     */
+    static bool IsVertexArraySupported();
+
+    /**
+     * Test if instanced drawing with per instance attributes is
+     * supported.
+     *
+     * @return True if support is found.
+     */
+    static bool IsInstancingSupported();
+
+    /**
+     * Test if uniform buffer objects are supported. If so the shared
+     * uniform blocks are updated every frame.
+     *
+     * @see UniformBlocks
+     * @return True if support is found.
+     */
+    static bool IsUniformBufferSupported();
+
     virtual bool BufferSupport();
     virtual bool FrameBufferSupport();
 
@@ -123,6 +182,50 @@ public:
      */
     static GLSLVersion GetGLSLVersion();
 
+    /**
+     * Load textures asynchronously. Textures loaded through a
+     * shared pointer get their id right away, but show a white
+     * placeholder until their data has been loaded by a worker
+     * thread and streamed to the gpu, usually a frame or two later.
+     * Must be set before the renderer is initialized and requires
+     * pixel buffer objects.
+     *
+     * @see TextureStreamer
+     */
+    void SetTextureStreaming(bool enabled);
+
+    /**
+     * Number of streamed textures not yet uploaded.
+     */
+    unsigned int GetPendingTextureCount();
+
+    /**
+     * Draw vertex data of dynamic data blocks that change every
+     * frame from a persistently mapped ring buffer, instead of
+     * updating the buffers of the blocks. A block leaves the ring
+     * buffer, and is uploaded to its own buffer, the first frame it
+     * is not rebound. Must be set before the renderer is
+     * initialized and requires buffer storage and sync objects.
+     *
+     * @see StreamBuffer
+     * @param bytes The size available to each frame, 0 disables the
+     * stream buffer.
+     */
+    void SetStreamBufferSize(unsigned int bytes);
+
+    /**
+     * The stream buffer, or NULL if not in use.
+     */
+    StreamBuffer* GetStreamBuffer();
+
+    /**
+     * The draw calls, state changes and uploads of the last
+     * complete frame. Uploads made between frames, like loading
+     * textures in the initialization phase, are counted in the
+     * following frame.
+     */
+    const RenderStatistics& GetStatistics() const;
+
     virtual void SetBackgroundColor(Vector<4,float> color);
     virtual Vector<4,float> GetBackgroundColor();
 
@@ -9,6 +9,12 @@
 
 #include <Renderers/OpenGL/RenderingView.h>
 #include <Renderers/OpenGL/Renderer.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Renderers/OpenGL/VertexArrayCache.h>
+#include <Renderers/OpenGL/MeshBounds.h>
+#include <Renderers/OpenGL/ResidencyManager.h>
+#include <Renderers/OpenGL/GPUProfiler.h>
+#include <Renderers/OpenGL/RenderStatistics.h>
 #include <Geometry/FaceSet.h>
 #include <Geometry/VertexArray.h>
 #include <Scene/GeometryNode.h>
@@ -18,6 +24,7 @@
 #include <Scene/RenderNode.h>
 #include <Scene/PostProcessNode.h>
 #include <Resources/IShaderResource.h>
+#include <Resources/OpenGLShader.h>
 #include <Resources/ITexture2D.h>
 #include <Display/Viewport.h>
 #include <Display/IViewingVolume.h>
@@ -42,11 +49,18 @@ using OpenEngine::Geometry::GeometrySet;
 using OpenEngine::Geometry::Mesh;
 using OpenEngine::Geometry::VertexArray;
 using OpenEngine::Resources::IShaderResource;
+using OpenEngine::Resources::OpenGLShader;
 using OpenEngine::Resources::ITexture2D;
 using OpenEngine::Display::Viewport;
 using OpenEngine::Display::IViewingVolume;
 using OpenEngine::Scene::RenderStateNode;
 
+// Cached bounds not refreshed for this many frames are forgotten.
+static const unsigned int BOUNDS_PRUNE_FRAMES = 256;
+// Culled subtrees are bounded again after this many frames, to see
+// if something below them moved into view.
+static const unsigned int BOUNDS_REFRESH_FRAMES = 16;
+
 /**
  * Rendering view constructor.
  *
@@ -65,14 +79,40 @@ RenderingView::RenderingView() {
     
     currentGeom = GeometrySetPtr(new GeometrySet());
     indexBuffer = IndicesPtr();
+    currentTexture = 0;
+
+    stateBits = stateMask = glStateBits = glStateMask = 0;
+    sortedRendering = false;
+    orderedDepth = 0;
+    instancing = true;
+    instanceBuffer = 0;
+    streamBuffer = NULL;
+    frustumCulling = false;
+    localMeshes = boundsFrame = 0;
+    insideDepth = uncullDepth = 0;
+    visibleCount = culledCount = 0;
+    postProcessIndex = 0;
 }
 
 /**
  * Rendering view destructor.
  */
-RenderingView::~RenderingView() {}
+RenderingView::~RenderingView() {
+    DeleteInstanceBuffer();
+}
+
+void RenderingView::DeleteInstanceBuffer() {
+    if (instanceBuffer == 0) return;
+    GLStateCache::ForgetBuffer(instanceBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+    instanceBuffer = 0;
+}
 
 void RenderingView::Handle(RenderingEventArg arg) {
+    // Views attached to the deinitialize event release their
+    // buffers with the context, others when they are destroyed.
+    if (arg.renderer.GetCurrentStage() == IRenderer::RENDERER_DEINITIALIZE)
+        DeleteInstanceBuffer();
     if (arg.renderer.GetCurrentStage() == IRenderer::RENDERER_PROCESS){
 #if OE_SAFE
         if (arg.canvas.GetScene() == NULL) 
@@ -80,13 +120,34 @@ void RenderingView::Handle(RenderingEventArg arg) {
 #endif
         
         this->arg = &arg;
+        Renderer* renderer = dynamic_cast<Renderer*>(&arg.renderer);
+        streamBuffer = renderer ? renderer->GetStreamBuffer() : NULL;
+        // Streamed blocks move every frame, so the client states
+        // must be set up again.
+        if (streamBuffer) ApplyGeometrySet(GeometrySetPtr());
         currentModelViewMatrix = arg.canvas.GetViewingVolume()->GetViewMatrix();
+
+        visibleCount = culledCount = 0;
+        insideDepth = uncullDepth = 0;
+        postProcessIndex = 0;
+        if (frustumCulling) {
+            // Bounds are tested in eye space.
+            frustum.SetMatrix(arg.canvas.GetViewingVolume()->GetProjectionMatrix());
+            localBounds = BoundingSphere();
+            localMeshes = 0;
+            ++boundsFrame;
+        }
         
         // setup default render state
         // RenderStateNode* renderStateNode = new RenderStateNode();
+        stateBits = stateMask = glStateBits = glStateMask = 0;
         ApplyRenderState(currentRenderState);
         arg.canvas.GetScene()->Accept(*this);
+        if (sortedRendering) FlushQueue();
+        ReleaseVertexArray();
         this->arg = NULL;
+        if (frustumCulling && boundsFrame % BOUNDS_PRUNE_FRAMES == 0)
+            PruneBounds();
         
         // cleanup
         if (currentShader != NULL) {
@@ -94,8 +155,8 @@ void RenderingView::Handle(RenderingEventArg arg) {
             currentShader.reset();
         }
         if (currentTexture != 0) {
-            glBindTexture(GL_TEXTURE_2D, 0);
-            glDisable(GL_TEXTURE_2D);
+            GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
+            GLStateCache::Disable(GL_TEXTURE_2D);
             CHECK_FOR_GL_ERROR();
             currentTexture = 0;
         }
@@ -107,54 +168,83 @@ void RenderingView::Handle(RenderingEventArg arg) {
  * @param node Rendering node to apply.
  */
 void RenderingView::VisitRenderNode(RenderNode* node) {
+    // nodes the bounds cannot describe are never culled
+    localBounds = BoundingSphere::Infinite();
+    if (sortedRendering) FlushQueue();
+    ReleaseVertexArray();
     node->Apply(*arg, *this);
 }
 
-void RenderingView::ApplyRenderState(RenderStateNode* node) {
-    if (node->IsOptionEnabled(RenderStateNode::WIREFRAME)) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        CHECK_FOR_GL_ERROR();
-    }
-    else if (node->IsOptionDisabled(RenderStateNode::WIREFRAME)) {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        CHECK_FOR_GL_ERROR();
-    }
+void RenderingView::SetSortedRendering(bool enabled) {
+    sortedRendering = enabled;
+}
 
-    if (node->IsOptionEnabled(RenderStateNode::BACKFACE)) {
-        glDisable(GL_CULL_FACE);
-        CHECK_FOR_GL_ERROR();
-    }
-    else if (node->IsOptionDisabled(RenderStateNode::BACKFACE)) {
-        glEnable(GL_CULL_FACE);
-        CHECK_FOR_GL_ERROR();
-    }
+bool RenderingView::IsSortedRendering() const {
+    return sortedRendering;
+}
 
-    if (node->IsOptionEnabled(RenderStateNode::LIGHTING)) {
-        glEnable(GL_LIGHTING);
-        CHECK_FOR_GL_ERROR();
-    }
-    else if (node->IsOptionDisabled(RenderStateNode::LIGHTING)) {
-        glDisable(GL_LIGHTING);
-        CHECK_FOR_GL_ERROR();
-    }
+void RenderingView::SetInstancing(bool enabled) {
+    instancing = enabled;
+}
 
-    if (node->IsOptionEnabled(RenderStateNode::DEPTH_TEST)) {
-        glEnable(GL_DEPTH_TEST);
-        CHECK_FOR_GL_ERROR();
-    }
-    else if (node->IsOptionDisabled(RenderStateNode::DEPTH_TEST)) {
-        glDisable(GL_DEPTH_TEST);
-        CHECK_FOR_GL_ERROR();
-    }
-    
-    if (node->IsOptionEnabled(RenderStateNode::COLOR_MATERIAL)) {
-        glEnable(GL_COLOR_MATERIAL);
-        CHECK_FOR_GL_ERROR();
+bool RenderingView::IsInstancing() const {
+    return instancing;
+}
+
+void RenderingView::SetFrustumCulling(bool enabled) {
+    frustumCulling = enabled;
+}
+
+bool RenderingView::IsFrustumCulling() const {
+    return frustumCulling;
+}
+
+unsigned int RenderingView::GetVisibleCount() const {
+    return visibleCount;
+}
+
+unsigned int RenderingView::GetCulledCount() const {
+    return culledCount;
+}
+
+void RenderingView::RecordOption(bool enabled, bool disabled, unsigned int bit) {
+    if (enabled) {
+        stateBits |= bit;
+        stateMask |= bit;
     }
-    else if (node->IsOptionDisabled(RenderStateNode::COLOR_MATERIAL)) {
-        glDisable(GL_COLOR_MATERIAL);
-        CHECK_FOR_GL_ERROR();
+    else if (disabled) {
+        stateBits &= ~bit;
+        stateMask |= bit;
     }
+}
+
+void RenderingView::ApplyRenderState(RenderStateNode* node) {
+    unsigned int prevMask = stateMask;
+    stateMask = 0;
+    RecordOption(node->IsOptionEnabled(RenderStateNode::WIREFRAME),
+                 node->IsOptionDisabled(RenderStateNode::WIREFRAME),
+                 STATE_WIREFRAME);
+    RecordOption(node->IsOptionEnabled(RenderStateNode::BACKFACE),
+                 node->IsOptionDisabled(RenderStateNode::BACKFACE),
+                 STATE_BACKFACE);
+    RecordOption(node->IsOptionEnabled(RenderStateNode::LIGHTING),
+                 node->IsOptionDisabled(RenderStateNode::LIGHTING),
+                 STATE_LIGHTING);
+    RecordOption(node->IsOptionEnabled(RenderStateNode::DEPTH_TEST),
+                 node->IsOptionDisabled(RenderStateNode::DEPTH_TEST),
+                 STATE_DEPTH_TEST);
+    RecordOption(node->IsOptionEnabled(RenderStateNode::COLOR_MATERIAL),
+                 node->IsOptionDisabled(RenderStateNode::COLOR_MATERIAL),
+                 STATE_COLOR_MATERIAL);
+    RecordOption(node->IsOptionEnabled(RenderStateNode::TEXTURE),
+                 node->IsOptionDisabled(RenderStateNode::TEXTURE),
+                 STATE_TEXTURE);
+    RecordOption(node->IsOptionEnabled(RenderStateNode::SHADER),
+                 node->IsOptionDisabled(RenderStateNode::SHADER),
+                 STATE_SHADER);
+    // the options given by this node
+    unsigned int nodeMask = stateMask;
+    stateMask |= prevMask;
 
     if (node->IsOptionEnabled(RenderStateNode::BINORMAL))
         renderBinormal = true;
@@ -176,17 +266,96 @@ void RenderingView::ApplyRenderState(RenderStateNode* node) {
     else if (node->IsOptionDisabled(RenderStateNode::HARD_NORMAL))
         renderHardNormal = false;
 
-    if (node->IsOptionEnabled(RenderStateNode::TEXTURE))
-        renderTexture = true;
-    else if (node->IsOptionDisabled(RenderStateNode::TEXTURE))
-        renderTexture = false;
+    if (nodeMask & STATE_TEXTURE)
+        renderTexture = (stateBits & STATE_TEXTURE) != 0;
+
+    if (nodeMask & STATE_SHADER)
+        renderShader = (stateBits & STATE_SHADER) != 0;
 
-    if (node->IsOptionEnabled(RenderStateNode::SHADER))
-        renderShader = true;
-    else if (node->IsOptionDisabled(RenderStateNode::SHADER))
-        renderShader = false;
+    // When rendering sorted the gl state is applied per draw item,
+    // otherwise apply every option given by the node right away.
+    if (!sortedRendering) {
+        glStateMask &= ~nodeMask;
+        SubmitRenderState(stateBits, nodeMask);
+    }
 }
 
+/**
+ * Apply the gl options given by bits and mask. Capabilities are
+ * filtered by the state cache, the polygon mode is filtered here.
+ */
+void RenderingView::SubmitRenderState(unsigned int bits, unsigned int mask) {
+    unsigned int changed = mask & (~glStateMask | (glStateBits ^ bits));
+
+    if (changed & STATE_WIREFRAME) {
+        glPolygonMode(GL_FRONT_AND_BACK, (bits & STATE_WIREFRAME) ? GL_LINE : GL_FILL);
+        CHECK_FOR_GL_ERROR();
+    }
+
+    if (mask & STATE_BACKFACE)
+        GLStateCache::SetCapability(GL_CULL_FACE, !(bits & STATE_BACKFACE));
+    if (mask & STATE_LIGHTING)
+        GLStateCache::SetCapability(GL_LIGHTING, bits & STATE_LIGHTING);
+    if (mask & STATE_DEPTH_TEST)
+        GLStateCache::SetCapability(GL_DEPTH_TEST, bits & STATE_DEPTH_TEST);
+    if (mask & STATE_COLOR_MATERIAL)
+        GLStateCache::SetCapability(GL_COLOR_MATERIAL, bits & STATE_COLOR_MATERIAL);
+    CHECK_FOR_GL_ERROR();
+
+    glStateBits = (glStateBits & ~mask) | (bits & mask);
+    glStateMask |= mask;
+}
+
+/**
+ * Sort and draw the queued meshes, then restore the gl state to
+ * the current traversal state.
+ */
+void RenderingView::FlushQueue() {
+    if (!queue.IsEmpty()) {
+        queue.Sort();
+
+        bool texture = renderTexture;
+        bool shader = renderShader;
+        bool instance = instancing && Renderer::IsInstancingSupported();
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        for (unsigned int i = 0; i < queue.GetSize(); ) {
+            DrawItem& item = queue.GetItem(i);
+            SubmitRenderState(item.state, item.stateMask);
+            renderTexture = !(item.stateMask & STATE_TEXTURE) || (item.state & STATE_TEXTURE);
+            renderShader = !(item.stateMask & STATE_SHADER) || (item.state & STATE_SHADER);
+
+            // find the run of items that can be drawn as instances
+            unsigned int count = 1;
+            if (instance && renderShader)
+                while (i + count < queue.GetSize() &&
+                       IsInstanceOf(item, queue.GetItem(i + count)))
+                    ++count;
+
+            if (count == 1 || !ApplyInstancedMesh(i, count)) {
+                for (unsigned int j = i; j < i + count; ++j) {
+                    float f[16];
+                    queue.GetItem(j).modelView.ToArray(f);
+                    glLoadMatrixf(f);
+                    ApplyMesh(queue.GetItem(j).mesh);
+                }
+            }
+            i += count;
+        }
+        glPopMatrix();
+        CHECK_FOR_GL_ERROR();
+
+        // release the last shader of the queue
+        if (currentShader != NULL) {
+            currentShader->ReleaseShader();
+            currentShader.reset();
+        }
+        renderTexture = texture;
+        renderShader = shader;
+        queue.Clear();
+    }
+    SubmitRenderState(stateBits, stateMask);
+}
 
 /**
  * Process a render state node.
@@ -216,8 +385,53 @@ void RenderingView::ApplyRenderState(RenderStateNode* node) {
  * @param node Transformation node to apply.
  */
 void RenderingView::VisitTransformationNode(TransformationNode* node) {
-    // push transformation matrix
     Matrix<4,4,float> m = node->GetTransformationMatrix();
+
+    // cull the subtree, or skip the tests below it if it is inside
+    bool inside = false;
+    if (frustumCulling && insideDepth == 0 && uncullDepth == 0) {
+        std::map<ISceneNode*, CachedBounds>::iterator itr = bounds.find(node);
+        if (itr != bounds.end()) {
+            // The bounds below the node are cached, so moving the
+            // node itself is always accounted for.
+            CachedBounds& cached = itr->second;
+            cached.seen = boundsFrame;
+            BoundingSphere sphere = cached.sphere.Transform(m);
+            Frustum::Result r = frustum.Test(sphere.Transform(currentModelViewMatrix));
+            if (r == Frustum::OUTSIDE && 
+                boundsFrame - cached.bounded >= BOUNDS_REFRESH_FRAMES) {
+                // Something below the node may have moved since its
+                // bounds were cached, bound it again before culling
+                // it.
+                Matrix<4,4,float> identity(1, 0, 0, 0,
+                                           0, 1, 0, 0,
+                                           0, 0, 1, 0,
+                                           0, 0, 0, 1);
+                sceneBounds.ComputeSubNodes(node, identity);
+                sceneBounds.GetTotal(cached.sphere, cached.meshes);
+                cached.bounded = boundsFrame;
+                sphere = cached.sphere.Transform(m);
+                r = frustum.Test(sphere.Transform(currentModelViewMatrix));
+            }
+            if (r == Frustum::OUTSIDE) {
+                culledCount += cached.meshes;
+                localBounds.Expand(sphere);
+                localMeshes += cached.meshes;
+                return;
+            }
+            inside = r == Frustum::INSIDE;
+        }
+    }
+    if (inside) ++insideDepth;
+
+    // bound the subtree on its own, it is merged into the parent
+    // below
+    BoundingSphere parentBounds = localBounds;
+    unsigned int parentMeshes = localMeshes;
+    localBounds = BoundingSphere();
+    localMeshes = 0;
+
+    // push transformation matrix
     float f[16];
     m.ToArray(f);
     glPushMatrix();
@@ -231,16 +445,55 @@ void RenderingView::VisitTransformationNode(TransformationNode* node) {
     // pop transformation matrix
     glPopMatrix();
     currentModelViewMatrix = oldModelView;
+    if (inside) --insideDepth;
     CHECK_FOR_GL_ERROR();
+
+    if (frustumCulling) {
+        CachedBounds& cached = bounds[node];
+        cached.sphere = localBounds;
+        cached.meshes = localMeshes;
+        cached.bounded = cached.seen = boundsFrame;
+        parentBounds.Expand(localBounds.Transform(m));
+        parentMeshes += localMeshes;
+    }
+    localBounds = parentBounds;
+    localMeshes = parentMeshes;
+}
+
+/**
+ * Forget the bounds of subtrees not seen for a while, e.g. nodes
+ * removed from the scene.
+ */
+void RenderingView::PruneBounds() {
+    std::map<ISceneNode*, CachedBounds>::iterator itr = bounds.begin();
+    while (itr != bounds.end()) {
+        if (boundsFrame - itr->second.seen >= BOUNDS_PRUNE_FRAMES)
+            bounds.erase(itr++);
+        else
+            ++itr;
+    }
+}
+
+/**
+ * The program of a shader, zero if it is not an OpenGL shader.
+ */
+static GLuint ProgramOf(IShaderResourcePtr shad) {
+    OpenGLShader* glShader = dynamic_cast<OpenGLShader*>(shad.get());
+    return glShader ? glShader->GetProgramID() : 0;
 }
 
 void RenderingView::ApplyMaterial(MaterialPtr mat) {
     // check if shaders should be applied
     if (Renderer::IsGLSLSupported()) {
             
-        // if the shader changes release the old shader
+        // if the shader changes release the old shader, unless the
+        // new one shares its program. Applying the new shader then
+        // only restores its uniforms.
         if (currentShader != NULL && currentShader != mat->shad) {
-            currentShader->ReleaseShader();
+            GLuint program = ProgramOf(currentShader);
+            if (!renderShader || mat->shad == NULL || program == 0 ||
+                program != ProgramOf(mat->shad))
+                currentShader->ReleaseShader();
             // logger.info << "release shader" << logger.end;
             currentShader.reset();
         }
@@ -260,14 +513,19 @@ void RenderingView::ApplyMaterial(MaterialPtr mat) {
         }
     }
     
+    // Mark the texture as used, loading it again if it was
+    // evicted.
+    if (currentShader == NULL && renderTexture && mat->Get2DTextures().size() > 0)
+        ResidencyManager::Touch((*mat->Get2DTextures().begin()).second);
+
     // if a shader is in use reset the current texture,
     // but dont disable in GL because the shader may use textures. 
     if (currentShader != NULL) currentTexture = 0;
     
     // if the face has no texture reset the current texture 
     else if (mat->Get2DTextures().size() == 0) {
-        glBindTexture(GL_TEXTURE_2D, 0); // @todo, remove this if not needed, release texture
-        glDisable(GL_TEXTURE_2D);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, 0); // @todo, remove this if not needed, release texture
+        GLStateCache::Disable(GL_TEXTURE_2D);
         CHECK_FOR_GL_ERROR();
         currentTexture = 0;
     }
@@ -276,12 +534,12 @@ void RenderingView::ApplyMaterial(MaterialPtr mat) {
     else if (renderTexture &&
              currentTexture != (*mat->Get2DTextures().begin()).second->GetID()) {  // and face texture is different then the current one
         currentTexture = (*mat->Get2DTextures().begin()).second->GetID();
-        glEnable(GL_TEXTURE_2D);
+        GLStateCache::Enable(GL_TEXTURE_2D);
 #ifdef DEBUG
         if (!glIsTexture(currentTexture)) //@todo: ifdef to debug
             throw Exception("texture not bound, id: " + currentTexture);
 #endif
-        glBindTexture(GL_TEXTURE_2D, currentTexture);
+        GLStateCache::BindTexture(GL_TEXTURE_2D, currentTexture);
         CHECK_FOR_GL_ERROR();
     }
         
@@ -308,11 +566,69 @@ void RenderingView::ApplyGeometrySet(GeometrySetPtr geom,
     }
 }
 
+/**
+ * Bind the default vertex array object, so gl calls outside the
+ * rendering view do not alter the baked vertex array objects.
+ */
+void RenderingView::ReleaseVertexArray() {
+    if (Renderer::IsVertexArraySupported())
+        GLStateCache::BindVertexArray(0);
+}
+
+/**
+ * Bind the buffer holding a data block.
+ *
+ * @return The pointer to pass to the gl*Pointer functions, an offset
+ * into the bound buffer or the client side data.
+ */
+const GLvoid* RenderingView::BindDataBlock(IDataBlockPtr block, bool bufferSupport) {
+    unsigned int offset;
+    if (streamBuffer && streamBuffer->Lookup(block.get(), offset)) {
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, streamBuffer->GetID());
+        return (const GLvoid*)(size_t)offset;
+    }
+    if (bufferSupport) GLStateCache::BindBuffer(GL_ARRAY_BUFFER, block->GetID());
+    if (block->GetID() != 0) return NULL;
+    return block->GetVoidDataPtr();
+}
+
+/**
+ * Test if any data block of a geometry set is drawn from the stream
+ * buffer in this frame.
+ */
+bool RenderingView::IsStreamed(GeometrySetPtr geom) {
+    if (streamBuffer == NULL) return false;
+    unsigned int offset;
+    if ((geom->GetVertices() && streamBuffer->Lookup(geom->GetVertices().get(), offset)) ||
+        (geom->GetNormals() && streamBuffer->Lookup(geom->GetNormals().get(), offset)) ||
+        (geom->GetColors() && streamBuffer->Lookup(geom->GetColors().get(), offset)))
+        return true;
+    IDataBlockList texCoords = geom->GetTexCoords();
+    for (IDataBlockList::iterator itr = texCoords.begin(); itr != texCoords.end(); ++itr)
+        if (streamBuffer->Lookup(itr->get(), offset)) return true;
+    return false;
+}
+
 /**
  * Applies the geometry set. Applying the empty or NULL geometry set
  * will disable enabled client states.
+ *
+ * Geometry sets whose data blocks are all bound to buffer objects
+ * are baked into a vertex array object, which is then all there is
+ * to bind. Other geometry sets set up the client states of the
+ * default vertex array object.
  */
 void RenderingView::ApplyGeometrySet(GeometrySetPtr geom){
+    if (geom != NULL && Renderer::IsVertexArraySupported() && !IsStreamed(geom)) {
+        GLuint vao = VertexArrayCache::Lookup(geom);
+        if (vao != 0) {
+            GLStateCache::BindVertexArray(vao);
+            return;
+        }
+    }
+    // currentGeom tracks the client states of the default vertex array.
+    ReleaseVertexArray();
+
     if (geom == NULL){
         // Disable client states enabled by previous geom.
         if (currentGeom->GetVertices() != NULL) {
@@ -343,11 +659,7 @@ void RenderingView::ApplyGeometrySet(GeometrySetPtr geom){
             // new vertices, bind them
             glEnableClientState(GL_VERTEX_ARRAY);
             // Only bind the buffer if it is supported
-            if (bufferSupport) glBindBuffer(GL_ARRAY_BUFFER, v->GetID());
-            if (v->GetID() != 0)
-                glVertexPointer(v->GetDimension(), GL_FLOAT, 0, 0);
-            else
-                glVertexPointer(v->GetDimension(), GL_FLOAT, 0, v->GetVoidDataPtr());
+            glVertexPointer(v->GetDimension(), GL_FLOAT, 0, BindDataBlock(v, bufferSupport));
         }else{
             glEnableClientState(GL_VERTEX_ARRAY);
         }
@@ -358,11 +670,7 @@ void RenderingView::ApplyGeometrySet(GeometrySetPtr geom){
             glDisableClientState(GL_NORMAL_ARRAY);
         }else if (n != currentGeom->GetNormals()){
             glEnableClientState(GL_NORMAL_ARRAY);
-            if (bufferSupport) glBindBuffer(GL_ARRAY_BUFFER, n->GetID());
-            if (n->GetID() != 0)
-                glNormalPointer(GL_FLOAT, 0, 0);
-            else
-                glNormalPointer(GL_FLOAT, 0, n->GetVoidDataPtr());
+            glNormalPointer(GL_FLOAT, 0, BindDataBlock(n, bufferSupport));
         }
         CHECK_FOR_GL_ERROR();
 
@@ -371,11 +679,7 @@ void RenderingView::ApplyGeometrySet(GeometrySetPtr geom){
             glDisableClientState(GL_COLOR_ARRAY);
         }else if (c != currentGeom->GetColors()){
             glEnableClientState(GL_COLOR_ARRAY);
-            if (bufferSupport) glBindBuffer(GL_ARRAY_BUFFER, c->GetID());
-            if (c->GetID() != 0)
-                glColorPointer(c->GetDimension(), GL_FLOAT, 0, 0);
-            else
-                glColorPointer(c->GetDimension(), GL_FLOAT, 0, c->GetVoidDataPtr());
+            glColorPointer(c->GetDimension(), GL_FLOAT, 0, BindDataBlock(c, bufferSupport));
         }
         CHECK_FOR_GL_ERROR();
 
@@ -391,13 +695,8 @@ void RenderingView::ApplyGeometrySet(GeometrySetPtr geom){
             glClientActiveTexture(GL_TEXTURE0 + count);
             IDataBlockPtr newTc = (*newItr);
             IDataBlockPtr oldTc = (*oldItr);
-            if (newTc != oldTc){
-                if (bufferSupport) glBindBuffer(GL_ARRAY_BUFFER, newTc->GetID());
-                if (newTc->GetID() != 0){
-                    glTexCoordPointer(newTc->GetDimension(), GL_FLOAT, 0, 0);
-                }else
-                    glTexCoordPointer(newTc->GetDimension(), GL_FLOAT, 0, newTc->GetVoidDataPtr());
-            }
+            if (newTc != oldTc)
+                glTexCoordPointer(newTc->GetDimension(), GL_FLOAT, 0, BindDataBlock(newTc, bufferSupport));
         }
 
         if (newItr == newTexCoords.end()){
@@ -412,17 +711,13 @@ void RenderingView::ApplyGeometrySet(GeometrySetPtr geom){
                 IDataBlockPtr newTc = (*newItr);
                 glClientActiveTexture(GL_TEXTURE0 + c);
                 glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-                if (bufferSupport) glBindBuffer(GL_ARRAY_BUFFER, newTc->GetID());
-                if (newTc->GetID() != 0){
-                    glTexCoordPointer(newTc->GetDimension(), GL_FLOAT, 0, 0);
-                }else
-                    glTexCoordPointer(newTc->GetDimension(), GL_FLOAT, 0, newTc->GetVoidDataPtr());
+                glTexCoordPointer(newTc->GetDimension(), GL_FLOAT, 0, BindDataBlock(newTc, bufferSupport));
             }
             
         }
         CHECK_FOR_GL_ERROR();
 
-        if (bufferSupport) glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (bufferSupport) GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
         CHECK_FOR_GL_ERROR();
 
 
@@ -448,30 +743,132 @@ void RenderingView::ApplyMesh(Mesh* prim) {
 
             
 
-        bool bufferSupport = arg->renderer.BufferSupport();
-        
-        // Apply the index buffer and draw
-        indexBuffer = prim->GetIndices();
-        GLsizei count = prim->GetDrawingRange();
-        unsigned int offset = prim->GetIndexOffset();
-        Geometry::Type type = prim->GetType();
-        if (bufferSupport) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer->GetID());
-        if (indexBuffer->GetID() != 0){
-            glDrawElements(type, count, GL_UNSIGNED_INT, (GLvoid*)(offset * sizeof(GLuint)));
-        }else{
-            glDrawElements(type, count, GL_UNSIGNED_INT, indexBuffer->GetData() + offset);
-        }
+        DrawIndices(prim, 1);
+    }
+    CHECK_FOR_GL_ERROR();
+}
+
+/**
+ * Bind the index buffer of the mesh and draw it.
+ *
+ * @param prim Mesh to draw.
+ * @param instances Number of instances, more than one requires
+ * instancing support.
+ */
+void RenderingView::DrawIndices(Mesh* prim, GLsizei instances) {
+    bool bufferSupport = arg->renderer.BufferSupport();
+
+    // Apply the index buffer and draw
+    indexBuffer = prim->GetIndices();
+    GLsizei count = prim->GetDrawingRange();
+    unsigned int offset = prim->GetIndexOffset();
+    Geometry::Type type = prim->GetType();
+    if (bufferSupport) GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer->GetID());
+    const GLvoid* indices;
+    if (indexBuffer->GetID() != 0)
+        indices = (GLvoid*)(offset * sizeof(GLuint));
+    else
+        indices = indexBuffer->GetData() + offset;
+    if (instances == 1)
+        glDrawElements(type, count, GL_UNSIGNED_INT, indices);
+    else
+        glDrawElementsInstancedARB(type, count, GL_UNSIGNED_INT, indices, instances);
+    RenderStatistics& stats = RenderStatistics::Current();
+    if (instances == 1) ++stats.drawElements;
+    else ++stats.drawInstanced;
+    stats.Draw(type, count, instances);
+
+    // The index binding of a vertex array object is left as is.
+    if (bufferSupport && !(Renderer::IsVertexArraySupported() &&
+                           GLStateCache::GetVertexArray() != 0))
+        GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    CHECK_FOR_GL_ERROR();
+}
 
-        if (bufferSupport) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+/**
+ * Two queued items are instances of the same mesh if they draw the
+ * same geometry and indices with the same material and render state.
+ */
+bool RenderingView::IsInstanceOf(DrawItem& first, DrawItem& item) {
+    if (first.state != item.state || first.stateMask != item.stateMask)
+        return false;
+    Mesh* a = first.mesh;
+    Mesh* b = item.mesh;
+    return a == b ||
+        (a->GetGeometrySet() == b->GetGeometrySet() &&
+         a->GetIndices() == b->GetIndices() &&
+         a->GetMaterial() == b->GetMaterial() &&
+         a->GetIndexOffset() == b->GetIndexOffset() &&
+         a->GetDrawingRange() == b->GetDrawingRange() &&
+         a->GetType() == b->GetType());
+}
+
+/**
+ * Draw count queued items, starting at first, with one instanced
+ * draw call. The model view matrices are streamed to the
+ * instanceModelView attribute of the shader.
+ *
+ * @return False if the material shader does not support instancing,
+ * in which case nothing has been drawn.
+ */
+bool RenderingView::ApplyInstancedMesh(unsigned int first, unsigned int count) {
+    Mesh* prim = queue.GetItem(first).mesh;
+    MaterialPtr mat = prim->GetMaterial();
+    if (!Renderer::IsGLSLSupported()) return false;
+    OpenGLShader* shader = dynamic_cast<OpenGLShader*>(mat->shad.get());
+    if (shader == NULL) return false;
+
+    // Applying the material selects the program variant the
+    // attribute location belongs to. The location is looked up once
+    // per program.
+    ApplyGeometrySet(prim->GetGeometrySet());
+    ApplyMaterial(mat);
+    GLint loc = shader->GetAttributeID("instanceModelView");
+    if (loc < 0) return false;
+
+    // Pack the matrices, straight into the mapped stream buffer if
+    // there is one. They are column major like glLoadMatrixf
+    // expects, so each column becomes one attribute.
+    unsigned int size = count * 16 * sizeof(float);
+    unsigned int offset = 0;
+    float* dst = streamBuffer ? (float*)streamBuffer->Allocate(size, offset) : NULL;
+    bool streamed = dst != NULL;
+    if (!streamed) {
+        instanceData.resize(count * 16);
+        dst = &instanceData[0];
     }
-        // last we release the final shader
-    if (currentShader != NULL) {
-        currentShader->ReleaseShader();
-        currentShader.reset();
+    for (unsigned int i = 0; i < count; ++i)
+        queue.GetItem(first + i).modelView.ToArray(dst + i * 16);
+
+    if (streamed)
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, streamBuffer->GetID());
+    else {
+        if (instanceBuffer == 0) glGenBuffers(1, &instanceBuffer);
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        // Respecifying the whole store lets the driver orphan the data
+        // used by the previous draw instead of waiting for it.
+        glBufferData(GL_ARRAY_BUFFER, size, &instanceData[0], GL_STREAM_DRAW);
     }
+    RenderStatistics::Current().bufferBytes += size;
+    for (unsigned int c = 0; c < 4; ++c) {
+        glEnableVertexAttribArray(loc + c);
+        glVertexAttribPointer(loc + c, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                              (GLvoid*)(offset + c * 4 * sizeof(float)));
+        glVertexAttribDivisorARB(loc + c, 1);
+    }
+    GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+    CHECK_FOR_GL_ERROR();
 
+    shader->SetUniform("instanced", 1, true);
+    DrawIndices(prim, count);
+    shader->SetUniform("instanced", 0, true);
 
+    for (unsigned int c = 0; c < 4; ++c) {
+        glVertexAttribDivisorARB(loc + c, 0);
+        glDisableVertexAttribArray(loc + c);
+    }
     CHECK_FOR_GL_ERROR();
+    return true;
 }
 
 /**
@@ -480,7 +877,33 @@ void RenderingView::ApplyMesh(Mesh* prim) {
  * @param node Mesh node to render
  */
 void RenderingView::VisitMeshNode(MeshNode* node) {
-    ApplyMesh(node->GetMesh().get());
+    Mesh* mesh = node->GetMesh().get();
+    if (mesh != NULL && frustumCulling) {
+        localBounds.Expand(MeshBounds::GetSphere(mesh));
+        ++localMeshes;
+    }
+    if (mesh != NULL && frustumCulling && insideDepth == 0 && uncullDepth == 0 &&
+        frustum.Test(MeshBounds::GetSphere(mesh).Transform(currentModelViewMatrix))
+        == Frustum::OUTSIDE) {
+        ++culledCount;
+        node->VisitSubNodes(*this);
+        return;
+    }
+    if (mesh != NULL) ++visibleCount;
+
+    if (sortedRendering && orderedDepth == 0) {
+        // defer the drawing to the next queue flush
+        if (mesh != NULL)
+            queue.Add(mesh, currentModelViewMatrix, stateBits, stateMask);
+    } else {
+        if (sortedRendering) SubmitRenderState(stateBits, stateMask);
+        ApplyMesh(mesh);
+        // last we release the final shader
+        if (currentShader != NULL) {
+            currentShader->ReleaseShader();
+            currentShader.reset();
+        }
+    }
     node->VisitSubNodes(*this);
     CHECK_FOR_GL_ERROR();
 }
@@ -491,6 +914,9 @@ void RenderingView::VisitMeshNode(MeshNode* node) {
  * @param node Geometry node to render
  */
 void RenderingView::VisitGeometryNode(GeometryNode* node) {
+    localBounds = BoundingSphere::Infinite();
+    if (sortedRendering) FlushQueue();
+
     // reset last state for matrial applying
     currentTexture = 0;
     currentShader.reset();
@@ -532,8 +958,8 @@ void RenderingView::VisitGeometryNode(GeometryNode* node) {
         currentShader->ReleaseShader();
 
     // disable textures if it has been enabled
-    glBindTexture(GL_TEXTURE_2D, 0); // @todo, remove this if not needed, release texture
-    glDisable(GL_TEXTURE_2D);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0); // @todo, remove this if not needed, release texture
+    GLStateCache::Disable(GL_TEXTURE_2D);
     CHECK_FOR_GL_ERROR();
 }
 
@@ -542,6 +968,9 @@ void RenderingView::VisitGeometryNode(GeometryNode* node) {
  *   sorted by texture id.
  */
 void RenderingView::VisitVertexArrayNode(VertexArrayNode* node){
+    localBounds = BoundingSphere::Infinite();
+    if (sortedRendering) FlushQueue();
+
     // reset last state for matrial applying
     currentTexture = 0;
     currentShader.reset();
@@ -556,7 +985,7 @@ void RenderingView::VisitVertexArrayNode(VertexArrayNode* node){
     glEnableClientState(GL_NORMAL_ARRAY);
     glEnableClientState(GL_COLOR_ARRAY);
     glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-    glEnable(GL_TEXTURE_2D);
+    GLStateCache::Enable(GL_TEXTURE_2D);
     CHECK_FOR_GL_ERROR();
 
     // Get vertex array from the vertex array node
@@ -572,6 +1001,8 @@ void RenderingView::VisitVertexArrayNode(VertexArrayNode* node){
         glTexCoordPointer(2, GL_FLOAT, 0, va->GetTexCoords());
         glVertexPointer(3, GL_FLOAT, 0, va->GetVertices());
         glDrawArrays(GL_TRIANGLES, 0, va->GetNumFaces()*3);
+        ++RenderStatistics::Current().drawArrays;
+        RenderStatistics::Current().Draw(GL_TRIANGLES, va->GetNumFaces()*3);
     }
     CHECK_FOR_GL_ERROR();
 
@@ -583,8 +1014,8 @@ void RenderingView::VisitVertexArrayNode(VertexArrayNode* node){
         currentShader->ReleaseShader();
 
     // Disable all state changes
-    glBindTexture(GL_TEXTURE_2D, 0); // @todo, remove this if not needed, release texture
-    glDisable(GL_TEXTURE_2D);
+    GLStateCache::BindTexture(GL_TEXTURE_2D, 0); // @todo, remove this if not needed, release texture
+    GLStateCache::Disable(GL_TEXTURE_2D);
 	glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_NORMAL_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
@@ -593,44 +1024,59 @@ void RenderingView::VisitVertexArrayNode(VertexArrayNode* node){
 }
 
 void RenderingView::VisitDisplayListNode(DisplayListNode* node) {
+    localBounds = BoundingSphere::Infinite();
+    if (sortedRendering) FlushQueue();
     glCallList(node->GetID());
+    ++RenderStatistics::Current().drawLists;
     CHECK_FOR_GL_ERROR();
 }
 
 void RenderingView::VisitPostProcessNode(PostProcessNode* node) {
+    // Post process nodes are told apart by their order in the
+    // traversal.
+    string label;
+    if (GPUProfiler::IsEnabled())
+        label = "PostProcessNode " + Utils::Convert::ToString<unsigned int>(postProcessIndex);
+    ++postProcessIndex;
+    GPUProfiler::Scope profile(label);
+    localBounds = BoundingSphere::Infinite();
+    if (sortedRendering) FlushQueue();
+    ReleaseVertexArray();
     node->PreEffect(arg, &currentModelViewMatrix);
     
     // if the node isn't enabled or there is no fbo
     // support then just proceed as usual.
+    // The effect may change the matrices, so do not cull below it.
+    ++uncullDepth;
     if (arg->renderer.FrameBufferSupport() == false ||
         node->GetEnabled() == false ||
         !renderShader) {
         node->VisitSubNodes(*this);
+        --uncullDepth;
         return;
     }
     
     // Save the previous state
-    GLint prevFbo;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &prevFbo);
-    Vector<4, GLint> prevDims;
-    glGetIntegerv(GL_VIEWPORT, prevDims.ToArray());
-    CHECK_FOR_GL_ERROR();
+    GLuint prevFbo = GLStateCache::GetFramebuffer();
+    Vector<4, GLint> prevDims = GLStateCache::GetViewport();
     
     // Setup the new frame buffer
     Vector<2, int> dims = node->GetDimension();
-    glViewport(0, 0, dims[0], dims[1]);
+    GLStateCache::Viewport(0, 0, dims[0], dims[1]);
     CHECK_FOR_GL_ERROR();
-    glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, node->GetSceneFrameBuffer()->GetID());
+    GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER_EXT, node->GetSceneFrameBuffer()->GetID());
     // Blit the previous framebuffer depth for merging instead of sorting.
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     CHECK_FOR_GL_ERROR();
     
     // Render to the scene frame buffer
     node->VisitSubNodes(*this);
+    if (sortedRendering) FlushQueue();
+    --uncullDepth;
 
     // Bind the previous frame buffer as both draw and read buffer.
-    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, prevFbo);
-    glViewport(prevDims[0], prevDims[1], prevDims[2], prevDims[3]);
+    GLStateCache::BindFramebuffer(GL_FRAMEBUFFER_EXT, prevFbo);
+    GLStateCache::Viewport(prevDims[0], prevDims[1], prevDims[2], prevDims[3]);
     CHECK_FOR_GL_ERROR();
 
     // Gently disable the depth func (while preserving depth writes)
@@ -639,6 +1085,7 @@ void RenderingView::VisitPostProcessNode(PostProcessNode* node) {
     // Then render the effect
     node->GetEffect()->ApplyShader();
     glRecti(-1,-1,1,1);
+    ++RenderStatistics::Current().drawQuads;
     node->GetEffect()->ReleaseShader();
     // @TODO reset to previous depth func, not just less
     glDepthFunc(GL_LESS);
@@ -658,7 +1105,7 @@ void RenderingView::VisitPostProcessNode(PostProcessNode* node) {
             }
         }
         // Blit the images from the previous framebuffer to the final framebuffer
-        glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, finalFb->GetID());
+        GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER_EXT, finalFb->GetID());
         // @TODO Blit the depth buffer with nearest and color buffers
         // with linear filtering?
         glBlitFramebufferEXT(prevDims[0], prevDims[1], prevDims[2], prevDims[3], 
@@ -667,7 +1114,7 @@ void RenderingView::VisitPostProcessNode(PostProcessNode* node) {
         CHECK_FOR_GL_ERROR();
         
         // Reset to previous fbo
-        glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, prevFbo);
+        GLStateCache::BindFramebuffer(GL_FRAMEBUFFER_EXT, prevFbo);
     }
 
     currentShader.reset();
@@ -675,21 +1122,25 @@ void RenderingView::VisitPostProcessNode(PostProcessNode* node) {
     
 void RenderingView::VisitBlendingNode(BlendingNode* node) {
     // save original blend state
-    GLboolean blending = glIsEnabled(GL_BLEND);
-    GLenum source, destination, equation;
-    glGetIntegerv(GL_BLEND_SRC, (GLint*) &source);
-    glGetIntegerv(GL_BLEND_DST, (GLint*) &destination);
-    glGetIntegerv(GL_BLEND_EQUATION, (GLint*) &equation);
+    bool blending = GLStateCache::IsEnabled(GL_BLEND);
+    GLenum source, destination;
+    GLStateCache::GetBlendFunc(source, destination);
+    GLenum equation = GLStateCache::GetBlendEquation();
 
-    glEnable(GL_BLEND);
+    // Blended geometry must be drawn in scene order.
+    if (sortedRendering) FlushQueue();
+    ++orderedDepth;
+
+    GLStateCache::Enable(GL_BLEND);
     SwitchBlending(node->GetSource(),
                    node->GetDestination(),
                    node->GetEquation());
     node->VisitSubNodes(*this);
+    --orderedDepth;
 
     // apply original blend state
     SwitchBlending(source, destination, equation);
-    if (!blending) glDisable(GL_BLEND);
+    if (!blending) GLStateCache::Disable(GL_BLEND);
     CHECK_FOR_GL_ERROR();
 }
 
@@ -733,16 +1184,15 @@ GLenum RenderingView::ConvertBlendingEquation(BlendingNode::BlendingEquation equ
 
 void RenderingView::SwitchBlending(GLenum source, GLenum destination,
                                      GLenum equation) {
-    glBlendFunc(source, destination);
-    glBlendEquationEXT(equation);
+    GLStateCache::BlendFunc(source, destination);
+    GLStateCache::BlendEquation(equation);
     CHECK_FOR_GL_ERROR();
 }
 
 void RenderingView::RenderDebugGeometry(FacePtr f) {
         // Render normal if enabled
-        GLboolean l = glIsEnabled(GL_LIGHTING);
-        CHECK_FOR_GL_ERROR();
-        glDisable(GL_LIGHTING);
+        bool l = GLStateCache::IsEnabled(GL_LIGHTING);
+        GLStateCache::Disable(GL_LIGHTING);
         CHECK_FOR_GL_ERROR();
 
         if (renderBinormal)
@@ -753,7 +1203,7 @@ void RenderingView::RenderDebugGeometry(FacePtr f) {
             RenderNormals(f);
         if (renderHardNormal)
             RenderHardNormal(f);
-        if (l) glEnable(GL_LIGHTING);
+        if (l) GLStateCache::Enable(GL_LIGHTING);
         CHECK_FOR_GL_ERROR();
 }
 
@@ -15,7 +15,13 @@
 #include <Renderers/IRenderingView.h>
 #include <Scene/RenderStateNode.h>
 #include <Scene/BlendingNode.h>
+#include <Renderers/OpenGL/RenderQueue.h>
+#include <Renderers/OpenGL/Frustum.h>
+#include <Renderers/OpenGL/SceneBounds.h>
+#include <Renderers/OpenGL/StreamBuffer.h>
 #include <list>
+#include <map>
+#include <vector>
 
 namespace OpenEngine {
     // Forward declarations.
@@ -67,6 +73,48 @@ public:
     void VisitBlendingNode(BlendingNode* node);
     void VisitPostProcessNode(PostProcessNode* node);
     virtual void Handle(RenderingEventArg arg);
+
+    /**
+     * Enable or disable sorted rendering. When enabled mesh nodes
+     * are collected into a render queue during traversal and
+     * submitted sorted by render state, shader, texture set,
+     * geometry set and depth. Nodes that must be drawn in scene
+     * order (blending, post processing, render nodes, ...) flush
+     * the queue before they are drawn.
+     */
+    void SetSortedRendering(bool enabled);
+    bool IsSortedRendering() const;
+
+    /**
+     * Enable or disable instancing of sorted meshes. Consecutive
+     * queued meshes sharing geometry, indices, material and render
+     * state are drawn with a single instanced draw call when their
+     * shader declares a mat4 instanceModelView attribute and an int
+     * instanced uniform. Enabled by default, but only has an effect
+     * with sorted rendering.
+     */
+    void SetInstancing(bool enabled);
+    bool IsInstancing() const;
+
+    /**
+     * Enable or disable view frustum culling. When enabled the
+     * bounds of every transformation node subtree are cached during
+     * traversal, and subtrees and meshes outside the frustum of the
+     * viewing volume are skipped. Subtrees are bounded again when
+     * they are drawn. Culled subtrees are skipped, and only bounded
+     * again every few frames to find nodes below them that moved
+     * into view, which may therefore appear a few frames late.
+     * Moving the transformation node of a culled subtree itself is
+     * always seen.
+     */
+    void SetFrustumCulling(bool enabled);
+    bool IsFrustumCulling() const;
+
+    /**
+     * Number of meshes drawn and culled during the last frame.
+     */
+    unsigned int GetVisibleCount() const;
+    unsigned int GetCulledCount() const;
     
 protected:
     Matrix<4, 4, float> currentModelViewMatrix;
@@ -80,6 +128,49 @@ protected:
 
     RenderStateNode* currentRenderState;
 
+    // Render state options packed as bits. The traversal state is
+    // what the scene graph currently dictates, the gl state is what
+    // has actually been applied.
+    enum StateOption {
+        STATE_WIREFRAME      = 1 << 0,
+        STATE_BACKFACE       = 1 << 1,
+        STATE_LIGHTING       = 1 << 2,
+        STATE_DEPTH_TEST     = 1 << 3,
+        STATE_COLOR_MATERIAL = 1 << 4,
+        STATE_TEXTURE        = 1 << 5,
+        STATE_SHADER         = 1 << 6
+    };
+    unsigned int stateBits, stateMask;
+    unsigned int glStateBits, glStateMask;
+
+    bool sortedRendering;
+    unsigned int orderedDepth; // > 0 when meshes must be drawn in scene order
+    RenderQueue queue;
+
+    bool instancing;
+    GLuint instanceBuffer;
+    vector<float> instanceData;
+    StreamBuffer* streamBuffer;
+
+    bool frustumCulling;
+    Frustum frustum;
+    // Bounds of the nodes below each transformation node, in the
+    // space of the node, and of the subtree currently traversed.
+    struct CachedBounds {
+        BoundingSphere sphere;
+        unsigned int meshes;
+        unsigned int bounded, seen; // frames
+    };
+    std::map<ISceneNode*, CachedBounds> bounds;
+    BoundingSphere localBounds;
+    unsigned int localMeshes;
+    unsigned int boundsFrame;
+    SceneBounds sceneBounds; // bounds subtrees about to be culled
+    unsigned int insideDepth; // > 0 when inside a subtree known to be visible
+    unsigned int uncullDepth; // > 0 when the frustum does not apply
+    unsigned int visibleCount, culledCount;
+    unsigned int postProcessIndex; // of the next post process node
+
     void SwitchBlending(BlendingNode::BlendingFactor source, 
                         BlendingNode::BlendingFactor destination,
                         BlendingNode::BlendingEquation equation);
@@ -95,9 +186,20 @@ protected:
     inline void ApplyMaterial(Geometry::MaterialPtr mat);
     void ApplyGeometrySet(GeometrySetPtr geom, IShaderResourcePtr shader);
     void ApplyGeometrySet(GeometrySetPtr geom);
+    inline void ReleaseVertexArray();
+    const GLvoid* BindDataBlock(IDataBlockPtr block, bool bufferSupport);
+    bool IsStreamed(GeometrySetPtr geom);
     void ApplyMesh(Mesh* prim);
+    void DrawIndices(Mesh* prim, GLsizei instances);
+    inline bool IsInstanceOf(DrawItem& first, DrawItem& item);
+    bool ApplyInstancedMesh(unsigned int first, unsigned int count);
+    void DeleteInstanceBuffer();
+    void PruneBounds();
     inline void ApplyModel(Model* model);
+    inline void RecordOption(bool enabled, bool disabled, unsigned int bit);
     inline void ApplyRenderState(RenderStateNode* node);
+    void SubmitRenderState(unsigned int bits, unsigned int mask);
+    void FlushQueue();
 };
 
 } // NS OpenGL
@@ -0,0 +1,183 @@
+// OpenGL texture and buffer residency.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/ResidencyManager.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Renderers/OpenGL/BindlessTextures.h>
+#include <Renderers/IRenderer.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+IRenderer* ResidencyManager::renderer = NULL;
+std::map<ITexture2D*, ResidencyManager::Entry> ResidencyManager::textures;
+std::map<GLuint, unsigned int> ResidencyManager::buffers;
+unsigned int ResidencyManager::budget = 0;
+unsigned int ResidencyManager::resident = 0;
+unsigned int ResidencyManager::bufferBytes = 0;
+unsigned int ResidencyManager::frame = 0;
+unsigned int ResidencyManager::evictions = 0;
+
+/**
+ * The renderer used to load evicted textures again.
+ */
+void ResidencyManager::SetRenderer(IRenderer* r) {
+    renderer = r;
+}
+
+void ResidencyManager::SetBudget(unsigned int bytes) {
+    budget = bytes;
+    Enforce();
+}
+
+unsigned int ResidencyManager::GetBudget() {
+    return budget;
+}
+
+/**
+ * Bytes of the loaded textures, the amount kept within the budget.
+ */
+unsigned int ResidencyManager::GetResidentBytes() {
+    return resident;
+}
+
+/**
+ * Bytes of the buffers uploaded by the renderer.
+ */
+unsigned int ResidencyManager::GetBufferBytes() {
+    return bufferBytes;
+}
+
+unsigned int ResidencyManager::GetEvictionCount() {
+    return evictions;
+}
+
+/**
+ * Size of a texture on the gpu, including its mipmap chain.
+ */
+unsigned int ResidencyManager::TextureBytes(ITexture2D* texture) {
+    unsigned int bytes = texture->GetWidth() * texture->GetHeight() * 
+        texture->GetChannels() * texture->GetChannelSize() / 8;
+    // the mipmaps add a third
+    if (texture->UseMipmapping())
+        bytes += bytes / 3;
+    return bytes;
+}
+
+/**
+ * Account a texture that has just been loaded.
+ *
+ * @param reloadable True if the texture data can be restored after
+ * eviction, either from memory or by loading the texture again.
+ */
+void ResidencyManager::AddTexture(ITexture2DPtr texture, bool reloadable) {
+    if (texture == NULL || texture->GetID() == 0) return;
+    std::map<ITexture2D*, Entry>::iterator itr = textures.find(texture.get());
+    if (itr != textures.end()) {
+        // a destroyed texture may have left an entry at the address
+        if (itr->second.texture.expired())
+            Release(itr->second);
+        else if (itr->second.id != 0)
+            resident -= itr->second.bytes;
+    }
+    Entry& entry = textures[texture.get()];
+    entry.texture = texture;
+    entry.id = texture->GetID();
+    entry.bytes = TextureBytes(texture.get());
+    entry.lastUse = frame;
+    entry.reloadable = reloadable;
+    resident += entry.bytes;
+    Enforce();
+}
+
+void ResidencyManager::AddBuffer(GLuint id, unsigned int bytes) {
+    std::map<GLuint, unsigned int>::iterator itr = buffers.find(id);
+    if (itr != buffers.end())
+        bufferBytes -= itr->second;
+    buffers[id] = bytes;
+    bufferBytes += bytes;
+}
+
+/**
+ * Mark a texture as used in this frame, loading it again if it has
+ * been evicted.
+ */
+void ResidencyManager::Touch(ITexture2DPtr texture) {
+    std::map<ITexture2D*, Entry>::iterator itr = textures.find(texture.get());
+    if (itr == textures.end()) return;
+    itr->second.lastUse = frame;
+    if (texture->GetID() == 0 && renderer != NULL)
+        renderer->LoadTexture(texture);
+}
+
+/**
+ * Start a new frame. Deletes the texture objects of destroyed
+ * textures and evicts textures until the budget is met.
+ */
+void ResidencyManager::NextFrame() {
+    ++frame;
+    std::map<ITexture2D*, Entry>::iterator itr = textures.begin();
+    while (itr != textures.end()) {
+        if (itr->second.texture.expired()) {
+            Release(itr->second);
+            textures.erase(itr++);
+        } else
+            ++itr;
+    }
+    Enforce();
+}
+
+/**
+ * Forget all accounting, without deleting anything. Used when the
+ * context is destroyed.
+ */
+void ResidencyManager::Clear() {
+    textures.clear();
+    buffers.clear();
+    resident = 0;
+    bufferBytes = 0;
+}
+
+/**
+ * Delete the texture object of an entry.
+ */
+void ResidencyManager::Release(Entry& entry) {
+    if (entry.id == 0) return;
+    BindlessTextures::Forget(entry.id);
+    GLStateCache::ForgetTexture(entry.id);
+    glDeleteTextures(1, &entry.id);
+    resident -= entry.bytes;
+    entry.id = 0;
+}
+
+void ResidencyManager::Enforce() {
+    while (budget != 0 && resident > budget) {
+        // the least recently used reloadable texture not used in
+        // this frame
+        std::map<ITexture2D*, Entry>::iterator victim = textures.end();
+        std::map<ITexture2D*, Entry>::iterator itr = textures.begin();
+        for (; itr != textures.end(); ++itr) {
+            const Entry& e = itr->second;
+            if (e.id == 0 || !e.reloadable || e.lastUse == frame) continue;
+            if (victim == textures.end() || e.lastUse < victim->second.lastUse)
+                victim = itr;
+        }
+        if (victim == textures.end()) return;
+
+        ITexture2DPtr texture = victim->second.texture.lock();
+        Release(victim->second);
+        if (texture) texture->SetID(0);
+        ++evictions;
+    }
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
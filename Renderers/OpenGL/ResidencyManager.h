@@ -0,0 +1,87 @@
+// OpenGL texture and buffer residency.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_RESIDENCY_MANAGER_H_
+#define _OPENGL_RESIDENCY_MANAGER_H_
+
+#include <Meta/OpenGL.h>
+#include <Resources/ITexture2D.h>
+#include <boost/weak_ptr.hpp>
+#include <map>
+
+namespace OpenEngine {
+namespace Renderers {
+
+class IRenderer;
+
+namespace OpenGL {
+
+using Resources::ITexture2D;
+using Resources::ITexture2DPtr;
+
+/**
+ * Accounts the gpu memory of textures and buffers and keeps it
+ * within a budget.
+ *
+ * When the loaded textures exceed the budget, the least recently
+ * used textures whose data can be restored from the cpu side are
+ * deleted. An evicted texture loses its id and is loaded again the
+ * next time it is used. Textures used in the current frame are never
+ * evicted. The texture objects of textures that have been destroyed
+ * are deleted at the start of the next frame.
+ *
+ * Buffers are accounted separately and do not count against the
+ * budget. They cannot be evicted, their data is normally released
+ * after the upload, and data blocks are bound without a reference
+ * that would tell when they are destroyed.
+ *
+ * @class ResidencyManager ResidencyManager.h Renderers/OpenGL/ResidencyManager.h
+ */
+class ResidencyManager {
+private:
+    struct Entry {
+        boost::weak_ptr<ITexture2D> texture;
+        GLuint id;
+        unsigned int bytes;
+        unsigned int lastUse;
+        bool reloadable;
+    };
+
+    static IRenderer* renderer;
+    static std::map<ITexture2D*, Entry> textures;
+    static std::map<GLuint, unsigned int> buffers;
+    static unsigned int budget, resident, bufferBytes, frame, evictions;
+
+    static void Release(Entry& entry);
+    static void Enforce();
+public:
+    static void SetRenderer(IRenderer* renderer);
+
+    /**
+     * Set the texture budget in bytes, 0 means unlimited.
+     */
+    static void SetBudget(unsigned int bytes);
+    static unsigned int GetBudget();
+    static unsigned int GetResidentBytes();
+    static unsigned int GetBufferBytes();
+    static unsigned int GetEvictionCount();
+
+    static unsigned int TextureBytes(ITexture2D* texture);
+    static void AddTexture(ITexture2DPtr texture, bool reloadable);
+    static void AddBuffer(GLuint id, unsigned int bytes);
+    static void Touch(ITexture2DPtr texture);
+    static void NextFrame();
+    static void Clear();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_RESIDENCY_MANAGER_H_
@@ -0,0 +1,136 @@
+// Hierarchical scene bounds.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/SceneBounds.h>
+#include <Renderers/OpenGL/MeshBounds.h>
+#include <Scene/TransformationNode.h>
+#include <Scene/MeshNode.h>
+#include <Scene/GeometryNode.h>
+#include <Scene/VertexArrayNode.h>
+#include <Scene/DisplayListNode.h>
+#include <Scene/RenderNode.h>
+#include <Scene/PostProcessNode.h>
+#include <Geometry/Mesh.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+SceneBounds::SceneBounds() : meshes(0) {}
+
+SceneBounds::~SceneBounds() {}
+
+/**
+ * Recompute the bounds of the scene.
+ *
+ * @param root Scene root.
+ * @param base Matrix the bounds are expressed relative to.
+ */
+void SceneBounds::Compute(ISceneNode* root, Matrix<4, 4, float> base) {
+    bounds.clear();
+    current = base;
+    sphere = BoundingSphere();
+    meshes = 0;
+    root->Accept(*this);
+}
+
+/**
+ * Recompute the bounds of the scene below root, without visiting
+ * root itself.
+ */
+void SceneBounds::ComputeSubNodes(ISceneNode* root, Matrix<4, 4, float> base) {
+    bounds.clear();
+    current = base;
+    sphere = BoundingSphere();
+    meshes = 0;
+    root->VisitSubNodes(*this);
+}
+
+/**
+ * Get the bounds of a transformation node subtree, including the
+ * transformation of the node itself.
+ *
+ * @return False if the node was not seen by the last computation.
+ */
+bool SceneBounds::Get(ISceneNode* node, BoundingSphere& s, unsigned int& m) {
+    std::map<ISceneNode*, Entry>::iterator itr = bounds.find(node);
+    if (itr == bounds.end()) return false;
+    s = itr->second.sphere;
+    m = itr->second.meshes;
+    return true;
+}
+
+/**
+ * Get the bounds of everything below the root of the last
+ * computation.
+ */
+void SceneBounds::GetTotal(BoundingSphere& s, unsigned int& m) {
+    s = sphere;
+    m = meshes;
+}
+
+void SceneBounds::VisitTransformationNode(TransformationNode* node) {
+    // bound the subtree on its own and merge it into the parent
+    BoundingSphere parentSphere = sphere;
+    unsigned int parentMeshes = meshes;
+    Matrix<4, 4, float> parent = current;
+    sphere = BoundingSphere();
+    meshes = 0;
+    current = node->GetTransformationMatrix() * current;
+    node->VisitSubNodes(*this);
+
+    Entry& e = bounds[node];
+    e.sphere = sphere;
+    e.meshes = meshes;
+
+    current = parent;
+    parentSphere.Expand(sphere);
+    sphere = parentSphere;
+    meshes += parentMeshes;
+}
+
+void SceneBounds::VisitMeshNode(MeshNode* node) {
+    Geometry::Mesh* mesh = node->GetMesh().get();
+    if (mesh != NULL) {
+        sphere.Expand(MeshBounds::GetSphere(mesh).Transform(current));
+        ++meshes;
+    }
+    node->VisitSubNodes(*this);
+}
+
+void SceneBounds::Unbounded(ISceneNode* node) {
+    sphere = BoundingSphere::Infinite();
+}
+
+void SceneBounds::VisitGeometryNode(GeometryNode* node) {
+    Unbounded(node);
+}
+
+void SceneBounds::VisitVertexArrayNode(VertexArrayNode* node) {
+    Unbounded(node);
+}
+
+void SceneBounds::VisitDisplayListNode(DisplayListNode* node) {
+    Unbounded(node);
+}
+
+void SceneBounds::VisitRenderNode(RenderNode* node) {
+    Unbounded(node);
+    node->VisitSubNodes(*this);
+}
+
+void SceneBounds::VisitPostProcessNode(PostProcessNode* node) {
+    // The effect may change the matrices, so nothing below it is
+    // bounded.
+    Unbounded(node);
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
@@ -0,0 +1,69 @@
+// Hierarchical scene bounds.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_SCENE_BOUNDS_H_
+#define _OPENGL_SCENE_BOUNDS_H_
+
+#include <Scene/ISceneNodeVisitor.h>
+#include <Renderers/OpenGL/Frustum.h>
+#include <map>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+using namespace OpenEngine::Scene;
+
+/**
+ * Computes the bounding sphere of every transformation node subtree
+ * of a scene, in the coordinate system given by a base matrix
+ * (usually the view matrix).
+ *
+ * Mesh nodes are bounded by their vertex data. Nodes that draw
+ * geometry the visitor cannot bound (geometry nodes, display lists,
+ * render nodes, post processing, ...) make the subtrees containing
+ * them unbounded, so they are never culled.
+ *
+ * @class SceneBounds SceneBounds.h Renderers/OpenGL/SceneBounds.h
+ */
+class SceneBounds : public ISceneNodeVisitor {
+private:
+    struct Entry {
+        BoundingSphere sphere;
+        unsigned int meshes;
+    };
+    std::map<ISceneNode*, Entry> bounds;
+    Matrix<4, 4, float> current;
+    BoundingSphere sphere;
+    unsigned int meshes;
+
+    void Unbounded(ISceneNode* node);
+public:
+    SceneBounds();
+    virtual ~SceneBounds();
+
+    void Compute(ISceneNode* root, Matrix<4, 4, float> base);
+    void ComputeSubNodes(ISceneNode* root, Matrix<4, 4, float> base);
+    bool Get(ISceneNode* node, BoundingSphere& sphere, unsigned int& meshes);
+    void GetTotal(BoundingSphere& sphere, unsigned int& meshes);
+
+    void VisitTransformationNode(TransformationNode* node);
+    void VisitMeshNode(MeshNode* node);
+    void VisitGeometryNode(GeometryNode* node);
+    void VisitVertexArrayNode(VertexArrayNode* node);
+    void VisitDisplayListNode(DisplayListNode* node);
+    void VisitRenderNode(RenderNode* node);
+    void VisitPostProcessNode(PostProcessNode* node);
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_SCENE_BOUNDS_H_
@@ -17,6 +17,8 @@
 #include <Meta/OpenGL.h>
 #include <Renderers/OpenGL/Renderer.h>
 #include <Resources/IShaderResource.h>
+#include <Resources/OpenGLShader.h>
+#include <Utils/Timer.h>
 #include <list>
 
 #include <Resources/PhongShader.h>
@@ -38,13 +40,71 @@ using namespace std;
 // using OpenEngine::Resources::TextureList;
 
 ShaderLoader::ShaderLoader(TextureLoader& textureLoader, Scene::ISceneNode& scene)
-    : textureLoader(textureLoader), scene(scene), lr(NULL) {}
+    : textureLoader(textureLoader), scene(scene), lr(NULL), loaded(0)
+    , bindless(false) {}
 
 ShaderLoader::~ShaderLoader() {}
 
 void ShaderLoader::Handle(Core::InitializeEventArg event) {
+    Utils::Timer timer;
+    timer.Start();
+    // let the driver use as many compiler threads as it likes
+    if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
     shaders.clear();
+    started.clear();
+    loaded = 0;
     scene.Accept(*this);
+    FinishPending();
+
+    logger.info << "Prepared " << loaded << " shaders in " 
+                << timer.GetElapsedIntervals(1000) << " ms" << logger.end;
+}
+
+/**
+ * Start loading a shader and its textures. OpenGL shaders are
+ * finished by FinishPending, others are loaded right away.
+ */
+void ShaderLoader::Load(IShaderResourcePtr shad) {
+    if (!started.insert(shad.get()).second) return;
+    boost::shared_ptr<OpenGLShader> glShader = 
+        boost::dynamic_pointer_cast<OpenGLShader>(shad);
+    if (glShader) {
+        glShader->StartLoad();
+        pending.push_back(glShader);
+    } else
+        shad->Load();
+    ++loaded;
+
+    // load the textures while the driver compiles
+    TextureList texs = shad->GetTextures();
+    for (unsigned int i = 0; i < texs.size(); ++i)
+        textureLoader.Load(texs[i]);
+}
+
+/**
+ * Finish all started shaders, picking those the driver is done with
+ * first.
+ */
+void ShaderLoader::FinishPending() {
+    while (!pending.empty()) {
+        bool finished = false;
+        list<boost::shared_ptr<OpenGLShader> >::iterator itr = pending.begin();
+        while (itr != pending.end()) {
+            if ((*itr)->IsLoadComplete()) {
+                (*itr)->FinishLoad();
+                itr = pending.erase(itr);
+                finished = true;
+            } else
+                ++itr;
+        }
+        // nothing done yet, wait for the oldest
+        if (!finished) {
+            pending.front()->FinishLoad();
+            pending.pop_front();
+        }
+    }
 }
 
 /**
@@ -63,10 +123,7 @@ void ShaderLoader::VisitGeometryNode(GeometryNode* node) {
 
         if (shad != NULL) {
             // load shader and its textures
-            shad->Load();
-            TextureList texs = shad->GetTextures();
-            for (unsigned int i = 0; i < texs.size(); ++i)
-                textureLoader.Load(texs[i]);
+            Load(shad);
             currentShader = shad;
         }
     }
@@ -90,10 +147,7 @@ void ShaderLoader::VisitVertexArrayNode(VertexArrayNode* node) {
 
         if (shad != NULL) {
             // load shader and its textures
-            shad->Load();
-            TextureList texs = shad->GetTextures();
-            for (unsigned int i = 0; i < texs.size(); ++i)
-                textureLoader.Load(texs[i]);
+            Load(shad);
         }
     }
 }
@@ -105,11 +159,10 @@ void ShaderLoader::VisitMeshNode(MeshNode* node) {
         IShaderResourcePtr shad = shaders[m];
         if (!shad) {
             logger.info << "loading phong shader" << logger.end;
-            shad = IShaderResourcePtr(new PhongShader(m, *lr));
-            shad->Load();
-            TextureList texs = shad->GetTextures();
-            for (unsigned int i = 0; i < texs.size(); ++i)
-            textureLoader.Load(texs[i]);
+            PhongShader* phong = new PhongShader(m, *lr);
+            phong->SetBindlessTextures(bindless);
+            shad = IShaderResourcePtr(phong);
+            Load(shad);
             shaders[m] = shad;
         }
         m->shad = shad;
@@ -120,6 +173,10 @@ void ShaderLoader::SetLightRenderer(LightRenderer* lr) {
     this->lr = lr;
 }
 
+void ShaderLoader::SetBindlessTextures(bool enabled) {
+    bindless = enabled;
+}
+
 } // NS OpenGL
 } // NS Renderers
 } // NS OpenEngine
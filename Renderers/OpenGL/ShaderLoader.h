@@ -20,8 +20,13 @@
 #include <Resources/IShaderResource.h>
 
 #include <map>
+#include <set>
+#include <list>
 
 namespace OpenEngine {
+    namespace Resources {
+        class OpenGLShader;
+    }
 namespace Renderers {
 namespace OpenGL {
 
@@ -36,6 +41,10 @@ using Renderers::OpenGL::LightRenderer;
 /**
  * OpenGL specific shader loader.
  *
+ * All shaders of the scene are compiled as one batch: compilation
+ * and linking of every shader is issued before any of them is
+ * checked, letting the driver compile in parallel.
+ *
  * @class ShaderLoader ShaderLoader.h Renderers/OpenGL/ShaderLoader.h
  */
 class ShaderLoader : public ISceneNodeVisitor, public Core::IListener<Core::InitializeEventArg> {
@@ -44,6 +53,13 @@ private:
     Scene::ISceneNode& scene;
     LightRenderer* lr;
     std::map<MaterialPtr,IShaderResourcePtr> shaders;
+    std::set<Resources::IShaderResource*> started;
+    std::list<boost::shared_ptr<Resources::OpenGLShader> > pending;
+    unsigned int loaded;
+    bool bindless;
+
+    void Load(IShaderResourcePtr shad);
+    void FinishPending();
 public:
     ShaderLoader(TextureLoader& textureLoader, Scene::ISceneNode& scene);
     ~ShaderLoader();
@@ -53,6 +69,13 @@ public:
     void VisitVertexArrayNode(VertexArrayNode* node);
     void VisitMeshNode(MeshNode* node);
     void SetLightRenderer(LightRenderer* lr);
+
+    /**
+     * Let the phong shaders created by the loader read their
+     * textures through bindless handles, where supported. Off by
+     * default.
+     */
+    void SetBindlessTextures(bool enabled);
 };
 
 } // NS OpenGL
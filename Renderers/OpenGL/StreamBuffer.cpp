@@ -0,0 +1,132 @@
+// OpenGL persistently mapped streaming buffer.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/StreamBuffer.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Resources/IDataBlock.h>
+#include <cstring>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+// Allocations are aligned to this many bytes.
+static const unsigned int ALIGNMENT = 16;
+
+/**
+ * Create and map the buffer. Requires a current context.
+ *
+ * @param frameSize Bytes available to each frame.
+ */
+StreamBuffer::StreamBuffer(unsigned int frameSize)
+    : regionSize(frameSize), region(0), offset(0) {
+    for (unsigned int i = 0; i < REGIONS; ++i)
+        fences[i] = NULL;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer);
+    GLStateCache::BindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, regionSize * REGIONS, NULL, flags);
+    mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * REGIONS, flags);
+    GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+    CHECK_FOR_GL_ERROR();
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (unsigned int i = 0; i < REGIONS; ++i)
+        if (fences[i] != NULL) glDeleteSync(fences[i]);
+    GLStateCache::BindBuffer(GL_ARRAY_BUFFER, buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+    GLStateCache::ForgetBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+}
+
+bool StreamBuffer::IsSupported() {
+    return glewIsSupported("GL_VERSION_4_4") || 
+        (GLEW_ARB_buffer_storage && 
+         (glewIsSupported("GL_VERSION_3_2") || GLEW_ARB_sync));
+}
+
+/**
+ * Move to the next region, waiting for the gpu to finish the frame
+ * that last used it. All allocations of the previous frame become
+ * invalid.
+ */
+void StreamBuffer::BeginFrame() {
+    region = (region + 1) % REGIONS;
+    offset = 0;
+    blocks.clear();
+    GLsync& fence = fences[region];
+    if (fence == NULL) return;
+    // one second at a time, flushing so the fence gets signaled
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(fence);
+    fence = NULL;
+}
+
+/**
+ * Fence the region of the frame, after its last draw.
+ */
+void StreamBuffer::EndFrame() {
+    GLsync& fence = fences[region];
+    if (fence != NULL) glDeleteSync(fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * Allocate memory in the region of the frame.
+ *
+ * @param size Bytes to allocate.
+ * @param offset Set to the offset of the memory in the buffer.
+ * @return The memory to write to, or NULL if the region is full.
+ */
+void* StreamBuffer::Allocate(unsigned int size, unsigned int& offset) {
+    if (mapped == NULL) return NULL;
+    unsigned int start = (this->offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (start + size > regionSize) return NULL;
+    this->offset = start + size;
+    offset = region * regionSize + start;
+    return mapped + offset;
+}
+
+/**
+ * Copy the data of a block into the frame, to be drawn through
+ * Lookup.
+ *
+ * @return False if the region is full.
+ */
+bool StreamBuffer::Stream(Resources::IDataBlock* block, unsigned int size) {
+    unsigned int start;
+    void* dst = Allocate(size, start);
+    if (dst == NULL) return false;
+    memcpy(dst, block->GetVoidDataPtr(), size);
+    blocks[block] = start;
+    return true;
+}
+
+/**
+ * Find a block streamed in this frame.
+ *
+ * @param offset Set to the offset of the block data in the buffer.
+ */
+bool StreamBuffer::Lookup(Resources::IDataBlock* block, unsigned int& offset) {
+    std::map<Resources::IDataBlock*, unsigned int>::iterator itr = blocks.find(block);
+    if (itr == blocks.end()) return false;
+    offset = itr->second;
+    return true;
+}
+
+GLuint StreamBuffer::GetID() {
+    return buffer;
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
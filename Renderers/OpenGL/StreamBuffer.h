@@ -0,0 +1,66 @@
+// OpenGL persistently mapped streaming buffer.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_STREAM_BUFFER_H_
+#define _OPENGL_STREAM_BUFFER_H_
+
+#include <Meta/OpenGL.h>
+#include <map>
+
+namespace OpenEngine {
+    namespace Resources {
+        class IDataBlock;
+    }
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Ring buffer for data written every frame.
+ *
+ * The buffer is allocated once with immutable storage and stays
+ * mapped persistently and coherently, so data is written straight
+ * into memory the gpu reads from. It is split into one region per
+ * frame in flight. A fence guards each region, and a region is only
+ * reused once the gpu has finished the frame that read it.
+ *
+ * Allocations are valid until the end of the frame.
+ *
+ * @class StreamBuffer StreamBuffer.h Renderers/OpenGL/StreamBuffer.h
+ */
+class StreamBuffer {
+public:
+    static const unsigned int REGIONS = 3;
+
+private:
+    GLuint buffer;
+    char* mapped;
+    unsigned int regionSize, region, offset;
+    GLsync fences[REGIONS];
+    std::map<Resources::IDataBlock*, unsigned int> blocks;
+
+public:
+    StreamBuffer(unsigned int frameSize);
+    ~StreamBuffer();
+
+    static bool IsSupported();
+
+    void BeginFrame();
+    void EndFrame();
+
+    void* Allocate(unsigned int size, unsigned int& offset);
+    bool Stream(Resources::IDataBlock* block, unsigned int size);
+    bool Lookup(Resources::IDataBlock* block, unsigned int& offset);
+    GLuint GetID();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_STREAM_BUFFER_H_
@@ -0,0 +1,243 @@
+// Asynchronous texture streaming.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/TextureStreamer.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Logging/Logger.h>
+
+#include <SDL/SDL_thread.h>
+#include <SDL/SDL_mutex.h>
+#include <cstring>
+#include <exception>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+// a job whose buffer could not be mapped this many times is dropped
+static const unsigned int MAX_MAP_RETRIES = 8;
+
+/**
+ * Create the pixel buffer ring and start the worker. Requires a
+ * current context.
+ *
+ * @param count Number of pixel buffers, the maximum number of
+ * textures in flight between the worker and the gpu.
+ */
+TextureStreamer::TextureStreamer(unsigned int count)
+    : slots(count), pending(0) {
+    for (unsigned int i = 0; i < count; ++i) {
+        glGenBuffers(1, &slots[i].buffer);
+        slots[i].state = FREE;
+        slots[i].data = NULL;
+        slots[i].size = 0;
+        slots[i].unload = false;
+    }
+    CHECK_FOR_GL_ERROR();
+
+    lock = SDL_CreateMutex();
+    work = SDL_CreateCond();
+    running = true;
+    thread = SDL_CreateThread(Run, this);
+}
+
+/**
+ * Stop the worker and delete the pixel buffers. Textures still in
+ * flight keep their placeholder.
+ */
+TextureStreamer::~TextureStreamer() {
+    SDL_mutexP(lock);
+    running = false;
+    SDL_CondSignal(work);
+    SDL_mutexV(lock);
+    SDL_WaitThread(thread, NULL);
+    SDL_DestroyCond(work);
+    SDL_DestroyMutex(lock);
+
+    for (unsigned int i = 0; i < slots.size(); ++i) {
+        if (slots[i].state == MAPPED || slots[i].state == FILLED) {
+            GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, slots[i].buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        GLStateCache::ForgetBuffer(slots[i].buffer);
+        glDeleteBuffers(1, &slots[i].buffer);
+    }
+    GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+bool TextureStreamer::IsSupported() {
+    return glewIsSupported("GL_VERSION_2_1") || GLEW_ARB_pixel_buffer_object;
+}
+
+/**
+ * Queue a texture for loading. The texture must already have its
+ * texture id.
+ */
+void TextureStreamer::Enqueue(ITexture2DPtr texture) {
+    Job job;
+    job.texture = texture;
+    job.unload = false;
+    job.retries = 0;
+    SDL_mutexP(lock);
+    loadQueue.push_back(job);
+    ++pending;
+    SDL_CondSignal(work);
+    SDL_mutexV(lock);
+}
+
+/**
+ * Collect the textures whose data has been copied to a pixel buffer
+ * and map free buffers for the textures the worker has loaded. Call
+ * once per frame.
+ */
+std::vector<TextureStreamer::Upload> TextureStreamer::Update() {
+    std::vector<Upload> uploads;
+    bool mapFailed = false;
+    SDL_mutexP(lock);
+    for (unsigned int i = 0; i < slots.size(); ++i) {
+        Slot& slot = slots[i];
+        if (slot.state == FILLED) {
+            GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            slot.data = NULL;
+            slot.state = UPLOADING;
+            Upload upload;
+            upload.texture = slot.texture;
+            upload.buffer = slot.buffer;
+            upload.slot = i;
+            uploads.push_back(upload);
+        } else if (slot.state == FREE && !mapFailed && !decoded.empty()) {
+            Job job = decoded.front();
+            decoded.pop_front();
+            ITexture2DPtr tex = job.texture;
+            slot.size = tex->GetWidth() * tex->GetHeight() * 
+                tex->GetChannels() * tex->GetChannelSize() / 8;
+            if (slot.size == 0) {
+                logger.error << "TextureStreamer: dropping empty texture" << logger.end;
+                --pending;
+                continue;
+            }
+            // orphan the previous contents, the copy from them may
+            // still be in progress
+            GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, slot.size, NULL, GL_STREAM_DRAW);
+            slot.data = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+            if (slot.data == NULL) {
+                // Try the job again after the queued ones, so it
+                // cannot stall them. The error of the failed map is
+                // handled here.
+                glGetError();
+                mapFailed = true;
+                if (++job.retries < MAX_MAP_RETRIES)
+                    decoded.push_back(job);
+                else {
+                    logger.error << "TextureStreamer: could not map a pixel buffer, "
+                                 << "dropping texture" << logger.end;
+                    --pending;
+                }
+                continue;
+            }
+            slot.texture = tex;
+            slot.unload = job.unload;
+            slot.state = MAPPED;
+            copyQueue.push_back(i);
+            SDL_CondSignal(work);
+        }
+    }
+    SDL_mutexV(lock);
+    GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    CHECK_FOR_GL_ERROR();
+    return uploads;
+}
+
+/**
+ * Return the pixel buffer of an upload to the ring, after the copy
+ * to the texture has been issued.
+ */
+void TextureStreamer::Release(const Upload& upload) {
+    SDL_mutexP(lock);
+    Slot& slot = slots[upload.slot];
+    slot.texture.reset();
+    slot.state = FREE;
+    --pending;
+    SDL_mutexV(lock);
+}
+
+/**
+ * Number of textures queued but not yet uploaded.
+ */
+unsigned int TextureStreamer::GetPendingCount() {
+    SDL_mutexP(lock);
+    unsigned int count = pending;
+    SDL_mutexV(lock);
+    return count;
+}
+
+int TextureStreamer::Run(void* data) {
+    ((TextureStreamer*)data)->Work();
+    return 0;
+}
+
+/**
+ * The worker copies texture data into mapped buffers first, to free
+ * the ring as soon as possible, and loads queued textures otherwise.
+ */
+void TextureStreamer::Work() {
+    SDL_mutexP(lock);
+    while (running) {
+        if (!copyQueue.empty()) {
+            Slot& slot = slots[copyQueue.front()];
+            copyQueue.pop_front();
+            SDL_mutexV(lock);
+
+            memcpy(slot.data, slot.texture->GetVoidDataPtr(), slot.size);
+            if (slot.unload)
+                slot.texture->Unload();
+
+            SDL_mutexP(lock);
+            slot.state = FILLED;
+        } else if (!loadQueue.empty()) {
+            Job job = loadQueue.front();
+            loadQueue.pop_front();
+            SDL_mutexV(lock);
+
+            bool loaded = true;
+            if (job.texture->GetVoidDataPtr() == NULL) {
+                job.unload = true;
+                try {
+                    job.texture->Load();
+                    loaded = job.texture->GetVoidDataPtr() != NULL;
+                } catch (std::exception& e) {
+                    logger.error << "TextureStreamer: " << e.what() << logger.end;
+                    loaded = false;
+                } catch (...) {
+                    loaded = false;
+                }
+            }
+
+            if (!loaded) {
+                // the texture keeps its placeholder
+                logger.error << "TextureStreamer: could not load texture, "
+                             << "dropping it" << logger.end;
+                SDL_mutexP(lock);
+                --pending;
+                continue;
+            }
+
+            SDL_mutexP(lock);
+            decoded.push_back(job);
+        } else
+            SDL_CondWait(work, lock);
+    }
+    SDL_mutexV(lock);
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
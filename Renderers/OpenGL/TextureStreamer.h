@@ -0,0 +1,99 @@
+// Asynchronous texture streaming.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_TEXTURE_STREAMER_H_
+#define _OPENGL_TEXTURE_STREAMER_H_
+
+#include <Meta/OpenGL.h>
+#include <Resources/ITexture2D.h>
+#include <vector>
+#include <list>
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+using Resources::ITexture2DPtr;
+
+/**
+ * Streams texture data to the gpu through a ring of pixel buffer
+ * objects.
+ *
+ * A worker thread loads the textures from disk and copies their
+ * pixels into mapped pixel buffers, so the render thread only maps
+ * and unmaps the buffers and issues the copy from buffer to texture,
+ * which the driver performs asynchronously. A texture is ready a
+ * frame or two after it was queued.
+ *
+ * All methods except the worker must be called on the render
+ * thread.
+ *
+ * @class TextureStreamer TextureStreamer.h Renderers/OpenGL/TextureStreamer.h
+ */
+class TextureStreamer {
+public:
+    /**
+     * Texture data ready in a pixel buffer, to be copied to the
+     * texture and then released.
+     */
+    struct Upload {
+        ITexture2DPtr texture;
+        GLuint buffer;
+        unsigned int slot;
+    };
+
+private:
+    enum SlotState { FREE, MAPPED, FILLED, UPLOADING };
+    struct Slot {
+        GLuint buffer;
+        SlotState state;
+        void* data;
+        unsigned int size;
+        ITexture2DPtr texture;
+        bool unload;
+    };
+    struct Job {
+        ITexture2DPtr texture;
+        bool unload;
+        unsigned int retries;
+    };
+
+    std::vector<Slot> slots;
+    std::list<Job> loadQueue, decoded;
+    std::list<unsigned int> copyQueue;
+    unsigned int pending;
+
+    SDL_Thread* thread;
+    SDL_mutex* lock;
+    SDL_cond* work;
+    volatile bool running;
+
+    static int Run(void* data);
+    void Work();
+public:
+    TextureStreamer(unsigned int slots = 4);
+    ~TextureStreamer();
+
+    static bool IsSupported();
+
+    void Enqueue(ITexture2DPtr texture);
+    std::vector<Upload> Update();
+    void Release(const Upload& upload);
+    unsigned int GetPendingCount();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_TEXTURE_STREAMER_H_
@@ -0,0 +1,167 @@
+// OpenGL shared uniform blocks.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/UniformBlocks.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Renderers/OpenGL/RenderStatistics.h>
+#include <cstring>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+bool UniformBlocks::initialized = false;
+GLuint UniformBlocks::buffers[2] = {0, 0};
+UniformBlocks::FrameBlock UniformBlocks::frame;
+UniformBlocks::LightBlock UniformBlocks::lights;
+std::set<GLuint> UniformBlocks::frameReaders;
+std::set<GLuint> UniformBlocks::lightReaders;
+
+/**
+ * Create the buffers and bind them to their binding points. Requires
+ * uniform buffer object support.
+ */
+void UniformBlocks::Initialize() {
+    if (initialized) return;
+    memset(&frame, 0, sizeof(FrameBlock));
+    memset(&lights, 0, sizeof(LightBlock));
+
+    glGenBuffers(2, buffers);
+    Upload(buffers[FRAME_BINDING], &frame, sizeof(FrameBlock), true);
+    Upload(buffers[LIGHT_BINDING], &lights, sizeof(LightBlock), true);
+    // Binding a base also sets the generic binding point, binding the
+    // light block last leaves it as the cache expects after Upload.
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, buffers[FRAME_BINDING]);
+    glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BINDING, buffers[LIGHT_BINDING]);
+    CHECK_FOR_GL_ERROR();
+    initialized = true;
+}
+
+void UniformBlocks::Deinitialize() {
+    if (!initialized) return;
+    GLStateCache::ForgetBuffer(buffers[FRAME_BINDING]);
+    GLStateCache::ForgetBuffer(buffers[LIGHT_BINDING]);
+    glDeleteBuffers(2, buffers);
+    buffers[0] = buffers[1] = 0;
+    initialized = false;
+}
+
+bool UniformBlocks::IsInitialized() {
+    return initialized;
+}
+
+/**
+ * The CPU side copy of the per frame block. Changes take effect on
+ * the next UpdateFrameBlock.
+ */
+UniformBlocks::FrameBlock& UniformBlocks::GetFrameBlock() {
+    return frame;
+}
+
+/**
+ * The CPU side copy of the light block. Changes take effect on the
+ * next UpdateLightBlock.
+ */
+UniformBlocks::LightBlock& UniformBlocks::GetLightBlock() {
+    return lights;
+}
+
+void UniformBlocks::UpdateFrameBlock() {
+    if (!initialized || frameReaders.empty()) return;
+    Upload(buffers[FRAME_BINDING], &frame, sizeof(FrameBlock));
+}
+
+void UniformBlocks::UpdateLightBlock() {
+    if (!initialized || lightReaders.empty()) return;
+    // only upload the lights in use
+    GLsizeiptr size = sizeof(lights.lightCount)
+        + sizeof(Light) * lights.lightCount[0];
+    Upload(buffers[LIGHT_BINDING], &lights, size);
+}
+
+void UniformBlocks::Upload(GLuint buffer, const void* data, GLsizeiptr size, bool create) {
+    GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (create)
+        glBufferData(GL_UNIFORM_BUFFER, size, data, GL_DYNAMIC_DRAW);
+    else
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    RenderStatistics::Current().bufferBytes += size;
+    CHECK_FOR_GL_ERROR();
+}
+
+/**
+ * Connect the blocks declared by a linked program to the shared
+ * binding points. Programs not declaring the blocks are left alone.
+ */
+void UniformBlocks::BindProgram(GLuint program) {
+    // The binding is program state, so programs linked before the
+    // buffers are created are bound as well.
+    if (!GLEW_VERSION_3_1 && !GLEW_ARB_uniform_buffer_object) return;
+    GLuint index = glGetUniformBlockIndex(program, "FrameBlock");
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, index, FRAME_BINDING);
+        // The block was not uploaded without readers.
+        bool first = frameReaders.empty();
+        frameReaders.insert(program);
+        if (first) UpdateFrameBlock();
+    }
+    index = glGetUniformBlockIndex(program, "LightBlock");
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, index, LIGHT_BINDING);
+        bool first = lightReaders.empty();
+        lightReaders.insert(program);
+        if (first) UpdateLightBlock();
+    }
+    index = glGetUniformBlockIndex(program, "ShadowBlock");
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, SHADOW_BINDING);
+    CHECK_FOR_GL_ERROR();
+}
+
+/**
+ * Stop uploading the blocks for a program about to be deleted.
+ */
+void UniformBlocks::ForgetProgram(GLuint program) {
+    frameReaders.erase(program);
+    lightReaders.erase(program);
+}
+
+/**
+ * Create a buffer for a block owned by an effect.
+ */
+GLuint UniformBlocks::CreateBuffer(const void* data, GLsizeiptr size) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    Upload(buffer, data, size, true);
+    return buffer;
+}
+
+void UniformBlocks::UpdateBuffer(GLuint buffer, const void* data, GLsizeiptr size) {
+    Upload(buffer, data, size);
+}
+
+/**
+ * Bind a buffer to a binding point.
+ */
+void UniformBlocks::BindBuffer(GLuint binding, GLuint buffer) {
+    // Binding a base also sets the generic binding point, so bind it
+    // through the cache first.
+    GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    CHECK_FOR_GL_ERROR();
+}
+
+void UniformBlocks::DeleteBuffer(GLuint buffer) {
+    GLStateCache::ForgetBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
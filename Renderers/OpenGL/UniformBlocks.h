@@ -0,0 +1,109 @@
+// OpenGL shared uniform blocks.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_UNIFORM_BLOCKS_H_
+#define _OPENGL_UNIFORM_BLOCKS_H_
+
+#include <Meta/OpenGL.h>
+#include <set>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Uniform buffer objects shared by all shader programs.
+ *
+ * The per frame block holds the camera and time and is filled by
+ * the Renderer, the light block holds the lights in eye space and is
+ * filled by the LightRenderer. Both are uploaded once per frame and
+ * stay bound to fixed binding points, so programs declaring the
+ * blocks (see shaders/UniformBlocks.glsl) read them without any per
+ * program uniform uploads. The layouts mirror the std140 layout of
+ * the glsl declarations. A block is only uploaded while a linked
+ * program declares it.
+ *
+ * Blocks holding the state of a single effect, like the shadow
+ * block, are kept in buffers owned by the effect, which are bound to
+ * the binding point of the block when its shader is applied, see
+ * OpenGLShader::SetUniformBuffer. The shaders are compiled with
+ * UNIFORM_BLOCKS defined when the blocks are available.
+ *
+ * @class UniformBlocks UniformBlocks.h Renderers/OpenGL/UniformBlocks.h
+ */
+class UniformBlocks {
+public:
+    static const GLuint FRAME_BINDING = 0;
+    static const GLuint LIGHT_BINDING = 1;
+    static const GLuint SHADOW_BINDING = 2;
+    static const unsigned int MAX_LIGHTS = 8;
+    static const unsigned int MAX_CASCADES = 4;
+
+    struct FrameBlock {
+        GLfloat viewMatrix[16];
+        GLfloat projectionMatrix[16];
+        GLfloat cameraPosition[4];
+        GLfloat time[4];            //!< seconds since start, frame time
+    };
+
+    struct Light {
+        GLfloat position[4];        //!< w is 0 for directional lights
+        GLfloat direction[4];
+        GLfloat ambient[4];
+        GLfloat diffuse[4];
+        GLfloat specular[4];
+        GLfloat attenuation[4];     //!< constant, linear, quadratic
+        GLfloat spot[4];            //!< cutoff, exponent
+    };
+
+    struct LightBlock {
+        GLint lightCount[4];
+        Light lightSources[MAX_LIGHTS];
+    };
+
+    struct ShadowBlock {
+        GLfloat lightMat[MAX_CASCADES][16]; //!< shadow map matrix of each cascade
+        GLfloat cascadeSplits[4];   //!< far eye space depth of each cascade
+        GLint cascades[4];          //!< number of cascades
+    };
+
+private:
+    static bool initialized;
+    static GLuint buffers[2];
+    static FrameBlock frame;
+    static LightBlock lights;
+    // linked programs declaring each block
+    static std::set<GLuint> frameReaders, lightReaders;
+
+    static void Upload(GLuint buffer, const void* data, GLsizeiptr size, bool create = false);
+public:
+    static void Initialize();
+    static void Deinitialize();
+    static bool IsInitialized();
+
+    static FrameBlock& GetFrameBlock();
+    static LightBlock& GetLightBlock();
+    static void UpdateFrameBlock();
+    static void UpdateLightBlock();
+
+    static void BindProgram(GLuint program);
+    static void ForgetProgram(GLuint program);
+
+    // Buffers of effect owned blocks
+    static GLuint CreateBuffer(const void* data, GLsizeiptr size);
+    static void UpdateBuffer(GLuint buffer, const void* data, GLsizeiptr size);
+    static void BindBuffer(GLuint binding, GLuint buffer);
+    static void DeleteBuffer(GLuint buffer);
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_UNIFORM_BLOCKS_H_
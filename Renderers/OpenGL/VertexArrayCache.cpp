@@ -0,0 +1,125 @@
+// OpenGL vertex array object cache.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/OpenGL/VertexArrayCache.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Geometry/GeometrySet.h>
+#include <Resources/IDataBlock.h>
+
+namespace OpenEngine {
+namespace Renderers {
+namespace OpenGL {
+
+using OpenEngine::Geometry::GeometrySetPtr;
+using OpenEngine::Resources::IDataBlockPtr;
+using OpenEngine::Resources::IDataBlockList;
+
+std::map<VertexArrayCache::Key, GLuint> VertexArrayCache::arrays;
+
+static bool AddBlock(IDataBlockPtr block, std::vector<unsigned int>& key) {
+    if (block == NULL) {
+        key.push_back(0);
+        key.push_back(0);
+        return true;
+    }
+    if (block->GetID() == 0) return false;
+    key.push_back(block->GetID());
+    key.push_back(block->GetDimension());
+    return true;
+}
+
+bool VertexArrayCache::MakeKey(GeometrySetPtr geom, Key& key) {
+    if (!AddBlock(geom->GetVertices(), key)) return false;
+    if (!AddBlock(geom->GetNormals(), key)) return false;
+    if (!AddBlock(geom->GetColors(), key)) return false;
+    IDataBlockList tcs = geom->GetTexCoords();
+    for (IDataBlockList::iterator itr = tcs.begin(); itr != tcs.end(); ++itr)
+        if (!AddBlock(*itr, key)) return false;
+    return true;
+}
+
+/**
+ * Bake the client states and pointers of the geometry set into a
+ * new vertex array object. The vertex array object is left bound.
+ */
+GLuint VertexArrayCache::Create(GeometrySetPtr geom) {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    GLStateCache::BindVertexArray(vao);
+    CHECK_FOR_GL_ERROR();
+
+    IDataBlockPtr v = geom->GetVertices();
+    if (v != NULL) {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, v->GetID());
+        glVertexPointer(v->GetDimension(), GL_FLOAT, 0, 0);
+    }
+    IDataBlockPtr n = geom->GetNormals();
+    if (n != NULL) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, n->GetID());
+        glNormalPointer(GL_FLOAT, 0, 0);
+    }
+    IDataBlockPtr c = geom->GetColors();
+    if (c != NULL) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, c->GetID());
+        glColorPointer(c->GetDimension(), GL_FLOAT, 0, 0);
+    }
+    CHECK_FOR_GL_ERROR();
+
+    IDataBlockList tcs = geom->GetTexCoords();
+    unsigned int count = 0;
+    for (IDataBlockList::iterator itr = tcs.begin(); itr != tcs.end(); ++itr, ++count) {
+        glClientActiveTexture(GL_TEXTURE0 + count);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, (*itr)->GetID());
+        glTexCoordPointer((*itr)->GetDimension(), GL_FLOAT, 0, 0);
+    }
+    glClientActiveTexture(GL_TEXTURE0);
+    GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+    CHECK_FOR_GL_ERROR();
+    return vao;
+}
+
+/**
+ * Get the vertex array object for a geometry set, baking it if it
+ * does not exist yet.
+ *
+ * @return The vertex array object or 0 if some of the data blocks
+ * are not bound to buffer objects.
+ */
+GLuint VertexArrayCache::Lookup(GeometrySetPtr geom) {
+    Key key;
+    if (!MakeKey(geom, key)) return 0;
+    std::map<Key, GLuint>::iterator itr = arrays.find(key);
+    if (itr != arrays.end()) return itr->second;
+    GLuint vao = Create(geom);
+    arrays[key] = vao;
+    return vao;
+}
+
+void VertexArrayCache::Clear() {
+    // nothing was baked without vertex array support
+    if (arrays.empty()) return;
+    GLStateCache::BindVertexArray(0);
+    std::map<Key, GLuint>::iterator itr = arrays.begin();
+    for (; itr != arrays.end(); ++itr)
+        glDeleteVertexArrays(1, &itr->second);
+    arrays.clear();
+    CHECK_FOR_GL_ERROR();
+}
+
+unsigned int VertexArrayCache::GetSize() {
+    return arrays.size();
+}
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
@@ -0,0 +1,60 @@
+// OpenGL vertex array object cache.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_VERTEX_ARRAY_CACHE_H_
+#define _OPENGL_VERTEX_ARRAY_CACHE_H_
+
+#include <Meta/OpenGL.h>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <map>
+
+namespace OpenEngine {
+    // Forward declarations.
+    namespace Geometry {
+        class GeometrySet;
+        typedef boost::shared_ptr<GeometrySet> GeometrySetPtr;
+    }
+namespace Renderers {
+namespace OpenGL {
+
+/**
+ * Cache of vertex array objects baked from geometry sets.
+ *
+ * A geometry set is baked the first time it is looked up and the
+ * vertex array object is shared by every geometry set referencing
+ * the same data blocks with the same dimensions. Only geometry sets
+ * whose data blocks all live in buffer objects can be baked.
+ *
+ * The renderer never deletes the buffer objects of data blocks, so
+ * the baked arrays live until Clear, which the renderer calls on
+ * deinitialize.
+ *
+ * @class VertexArrayCache VertexArrayCache.h Renderers/OpenGL/VertexArrayCache.h
+ */
+class VertexArrayCache {
+private:
+    // pairs of (buffer id, dimension) for vertices, normals, colors
+    // and each texture coordinate set, (0,0) marks a missing block.
+    typedef std::vector<unsigned int> Key;
+    static std::map<Key, GLuint> arrays;
+
+    static bool MakeKey(Geometry::GeometrySetPtr geom, Key& key);
+    static GLuint Create(Geometry::GeometrySetPtr geom);
+public:
+    static GLuint Lookup(Geometry::GeometrySetPtr geom);
+    static void Clear();
+    static unsigned int GetSize();
+};
+
+} // NS OpenGL
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OPENGL_VERTEX_ARRAY_CACHE_H_
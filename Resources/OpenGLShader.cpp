@@ -11,49 +11,83 @@
 #define printinfo true
 
 #include <Resources/OpenGLShader.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Renderers/OpenGL/UniformBlocks.h>
 
 #include <Logging/Logger.h>
 #include <Meta/OpenGL.h>
 #include <Resources/Exceptions.h>
 #include <Resources/File.h>
 #include <Resources/ResourceManager.h>
+#include <Resources/ProgramBinaryCache.h>
+#include <Resources/ShaderWatcher.h>
 #include <Resources/ITexture2D.h>
 #include <Resources/ITexture3D.h>
+#include <Utils/Convert.h>
 
 #include <cstring>
+#include <iterator>
 
 namespace OpenEngine {
     namespace Resources {
 
+        using Renderers::OpenGL::GLStateCache;
+        using Renderers::OpenGL::UniformBlocks;
+
         int OpenGLShader::shaderModel = 0;
         bool OpenGLShader::vertexSupport = false;
         bool OpenGLShader::geometrySupport = false;
         bool OpenGLShader::fragmentSupport = false;
+        map<string, GLuint> OpenGLShader::programsByKey;
+        map<GLuint, sharedProgram> OpenGLShader::sharedPrograms;
+        set<OpenGLShader*> OpenGLShader::shaders;
+
+        // Initial size of the uniform arena in bytes.
+        static const unsigned int UNIFORM_ARENA_SIZE = 1024;
 
         OpenGLShader::OpenGLShader() {
             resource.clear();
             nextTexUnit = 0;
             shaderProgram = 0;
+            attributeProgram = 0;
+            linking = false;
+            watched = false;
+            variantChanged = false;
+            bindless = false;
+            uniformData.reserve(UNIFORM_ARENA_SIZE);
+            shaders.insert(this);
         }
 
         OpenGLShader::OpenGLShader(string filename)
             : resource(filename) {
             nextTexUnit = 0;
             shaderProgram = 0;
+            attributeProgram = 0;
+            linking = false;
+            watched = false;
+            variantChanged = false;
+            bindless = false;
+            uniformData.reserve(UNIFORM_ARENA_SIZE);
+            shaders.insert(this);
         }
 
         OpenGLShader::~OpenGLShader() {
-            // Delete the uniforms data.
-            map<string, uniform>::iterator itr = boundUniforms.begin();
-            while(itr != boundUniforms.end()){
-                DeleteData(itr->second);
-                ++itr;
-            }
-            itr = unboundUniforms.begin();
-            while(itr != unboundUniforms.end()){
-                DeleteData(itr->second);
-                ++itr;
-            }
+            ShaderWatcher::Unwatch(this);
+            OpenGLShader::Unload();
+            shaders.erase(this);
+        }
+
+        /**
+         * Release the programs of all shaders while the context is
+         * still current. The shaders compile their programs again
+         * when loaded in a new context.
+         */
+        void OpenGLShader::Deinitialize(){
+            set<OpenGLShader*>::iterator itr = shaders.begin();
+            for (; itr != shaders.end(); ++itr)
+                (*itr)->OpenGLShader::Unload();
+            programsByKey.clear();
+            sharedPrograms.clear();
         }
         
         void OpenGLShader::ShaderSupport(){
@@ -85,6 +119,17 @@ namespace OpenEngine {
         }
 
         void OpenGLShader::Load() {
+            StartLoad();
+            FinishLoad();
+        }
+
+        /**
+         * Start loading the shader. Compilation and linking are
+         * issued to the driver but not waited for, so several
+         * shaders can be started before finishing any of them. The
+         * shader can not be applied before FinishLoad is called.
+         */
+        void OpenGLShader::StartLoad() {
             if (shaderModel == 0) return;
 
             // Load the resource and its attributes from a file, if a
@@ -100,16 +145,106 @@ namespace OpenEngine {
                 throw ResourceException("No shaders specified");
 #endif
       
+            // Shaders may read the shared uniform blocks.
+            if (UniformBlocks::IsInitialized())
+                SetDefine("UNIFORM_BLOCKS");
+            else
+                RemoveDefine("UNIFORM_BLOCKS");
+
             // Load the shader onto the gpu.
             BindShaderPrograms();
             CHECK_FOR_GL_ERROR();
+        }
+
+        /**
+         * Wait for a shader started with StartLoad and check the
+         * result.
+         */
+        void OpenGLShader::FinishLoad() {
+            if (shaderModel == 0) return;
+            CheckShaderPrograms();
+            CHECK_FOR_GL_ERROR();
 
             //PrintUniforms();
         }
+
+        /**
+         * Test if the driver is done compiling and linking a shader
+         * started with StartLoad, so FinishLoad will not block. Only
+         * known with GL_KHR_parallel_shader_compile, without it the
+         * load is reported as complete.
+         */
+        bool OpenGLShader::IsLoadComplete() {
+            if (!linking || !GLEW_KHR_parallel_shader_compile) return true;
+            GLint complete = GL_TRUE;
+            glGetProgramiv(shaderProgram, GL_COMPLETION_STATUS_KHR, &complete);
+            return complete == GL_TRUE;
+        }
         
+        /**
+         * Release all program variants of the shader. Programs
+         * shared with other shaders are deleted by the last one
+         * releasing them.
+         */
         void OpenGLShader::Unload() {
-            glDeleteShader(shaderProgram);
+            // A program started but not finished is not a variant
+            // yet.
+            bool started = shaderProgram != 0;
+            map<string, GLuint>::iterator itr = variants.begin();
+            for (; itr != variants.end(); ++itr){
+                if (itr->second == shaderProgram) started = false;
+                ReleaseProgram(itr->second);
+            }
+            if (started) ReleaseProgram(shaderProgram);
+            for (unsigned int i = 0; i < pendingShaders.size(); ++i)
+                glDeleteShader(pendingShaders[i].first);
+            pendingShaders.clear();
+            linking = false;
+            variants.clear();
             shaderProgram = 0;
+            // the ids may be reused by other programs
+            attributeLocs.clear();
+            attributeProgram = 0;
+        }
+
+        void OpenGLShader::SetDefine(string name, string value){
+            map<string, string>::iterator itr = defines.find(name);
+            if (itr != defines.end() && itr->second == value) return;
+            defines[name] = value;
+            variantChanged = true;
+        }
+
+        void OpenGLShader::SetDefine(string name, int value){
+            SetDefine(name, Utils::Convert::ToString<int>(value));
+        }
+
+        void OpenGLShader::RemoveDefine(string name){
+            if (defines.erase(name) > 0)
+                variantChanged = true;
+        }
+
+        bool OpenGLShader::HasDefine(string name){
+            return defines.find(name) != defines.end();
+        }
+
+        /**
+         * Switch to the program of the current define set, compiling
+         * it if it has not been used before.
+         */
+        void OpenGLShader::SelectVariant(){
+            variantChanged = false;
+            map<string, GLuint>::iterator itr = variants.find(GetDefineHeader());
+            if (itr != variants.end() && itr->second == shaderProgram) return;
+
+            if (itr != variants.end())
+                shaderProgram = itr->second;
+            else {
+                BindShaderPrograms();
+                CheckShaderPrograms();
+            }
+            // The uniforms and textures must be bound to the new
+            // program.
+            ResetProperties();
         }
 
         void OpenGLShader::ApplyShader(){
@@ -117,7 +252,11 @@ namespace OpenEngine {
             if (shaderProgram == 0)
                 throw ResourceException("No shader to apply. Perhaps it was not loaded.");
 #endif
-            if (timer.GetElapsedTime() > Utils::Time(1,0)) {
+            if (linking) FinishLoad();
+            if (variantChanged) SelectVariant();
+            // Shaders not watched for changes poll their sources.
+            if (!watched && 
+                timer.GetElapsedTime() > Utils::Time(1,0)) {
                 timer.Reset();
                 map<string, Utils::DateTime>::iterator itr = timestamps.begin();
                 while (itr != timestamps.end()){
@@ -126,9 +265,7 @@ namespace OpenEngine {
                     Utils::DateTime newstamp = File::
                         GetLastModified(DirectoryManager::FindFileInPath(file));
                     if (oldstamp != newstamp) {
-                        ReleaseShader();
-                        Unload();
-                        Load();
+                        Reload();
                         break;
                     }
                     itr++;
@@ -136,14 +273,44 @@ namespace OpenEngine {
             }
 
             // Bind the shader program.
-            glUseProgram(shaderProgram);
+            GLStateCache::UseProgram(shaderProgram);
+
+            // Another shader sharing the program may have replaced
+            // the uniform values.
+            map<GLuint, sharedProgram>::iterator shared = sharedPrograms.find(shaderProgram);
+#if OE_SAFE
+            if (shared == sharedPrograms.end())
+                throw ResourceException("Shader program missing from the shared programs.");
+#endif
+            if (shared->second.owner != this){
+                shared->second.owner = this;
+                RestoreUniforms();
+            }
 
             BindUniforms();
             BindTextures();
+
+            map<GLuint, GLuint>::iterator buf = uniformBuffers.begin();
+            for (; buf != uniformBuffers.end(); ++buf)
+                UniformBlocks::BindBuffer(buf->first, buf->second);
+        }
+
+        void OpenGLShader::SetUniformBuffer(GLuint binding, GLuint buffer){
+            uniformBuffers[binding] = buffer;
         }
 
         void OpenGLShader::ReleaseShader(){
-            glUseProgram(0);
+            GLStateCache::UseProgram(0);
+        }
+
+        /**
+         * Reload the shader from its sources.
+         */
+        void OpenGLShader::Reload(){
+            logger.info << "Reloading shader: " << resource << logger.end;
+            ReleaseShader();
+            Unload();
+            Load();
         }
 
         //  *** Private helper methods ***
@@ -153,24 +320,26 @@ namespace OpenEngine {
          * uniforms to be bound again.
          */
         void OpenGLShader::ResetProperties(){
-            // Move bound uniforms to unbound, to preserve attributes not
-            // specified in the glsl file.
-            boundUniforms.insert(unboundUniforms.begin(), unboundUniforms.end());
-            unboundUniforms = map<string, uniform>(boundUniforms);
+            // Mark all uniforms for upload, to preserve attributes
+            // not specified in the glsl file. Their locations are
+            // resolved again on the next bind.
+            dirtyUniforms.clear();
+            for (unsigned int i = 0; i < uniforms.size(); ++i){
+                uniforms[i].resolved = false;
+                uniforms[i].dirty = uniforms[i].kind != UNKNOWN;
+                if (uniforms[i].dirty)
+                    dirtyUniforms.push_back(i);
+            }
+
             boundTex2Ds.insert(unboundTex2Ds.begin(), unboundTex2Ds.end());
             unboundTex2Ds = map<string, sampler2D>(boundTex2Ds);
             boundTex3Ds.insert(unboundTex3Ds.begin(), unboundTex3Ds.end());
             unboundTex3Ds = map<string, sampler3D>(boundTex3Ds);
-            boundUniforms.clear();
             boundTex2Ds.clear();
             boundTex3Ds.clear();
+            nextTexUnit = 0;
 
             // Set all their loc's to 0 since we no longer know where they are.
-            map<string, uniform>::iterator itr = unboundUniforms.begin();
-            while (itr != unboundUniforms.end()){
-                itr->second.loc = 0;
-                itr++;
-            }
             map<string, sampler2D>::iterator itr2 = unboundTex2Ds.begin();
             while (itr2 != unboundTex2Ds.end()){
                 itr2->second.loc = 0;
@@ -183,6 +352,62 @@ namespace OpenEngine {
             }
         }
 
+        /**
+         * Upload all uniforms and samplers again, keeping their
+         * resolved locations. Used when the program is shared with
+         * other shaders. The program must be in use.
+         */
+        void OpenGLShader::RestoreUniforms(){
+            dirtyUniforms.clear();
+            for (unsigned int i = 0; i < uniforms.size(); ++i){
+                uniforms[i].dirty = uniforms[i].kind != UNKNOWN;
+                if (uniforms[i].dirty)
+                    dirtyUniforms.push_back(i);
+            }
+
+            // Bindless handles are uploaded again by BindTextures.
+            map<string, sampler2D>::iterator itr2 = boundTex2Ds.begin();
+            for (; itr2 != boundTex2Ds.end(); ++itr2){
+                if (bindless) itr2->second.handle = 0;
+                else glUniform1i(itr2->second.loc, itr2->second.texUnit);
+            }
+            map<string, sampler3D>::iterator itr3 = boundTex3Ds.begin();
+            for (; itr3 != boundTex3Ds.end(); ++itr3){
+                if (bindless) itr3->second.handle = 0;
+                else glUniform1i(itr3->second.loc, itr3->second.texUnit);
+            }
+        }
+
+        /**
+         * Register the current program as shared under the given
+         * key.
+         */
+        void OpenGLShader::ShareProgram(string key){
+            programsByKey[key] = shaderProgram;
+            sharedProgram shared;
+            shared.key = key;
+            shared.users = 1;
+            shared.owner = NULL;
+            sharedPrograms[shaderProgram] = shared;
+        }
+
+        /**
+         * Release a program, deleting it when no other shader uses
+         * it.
+         */
+        void OpenGLShader::ReleaseProgram(GLuint program){
+            map<GLuint, sharedProgram>::iterator itr = sharedPrograms.find(program);
+            if (itr != sharedPrograms.end()){
+                if (itr->second.owner == this)
+                    itr->second.owner = NULL;
+                if (--itr->second.users > 0) return;
+                programsByKey.erase(itr->second.key);
+                sharedPrograms.erase(itr);
+            }
+            UniformBlocks::ForgetProgram(program);
+            glDeleteProgram(program);
+        }
+
         void OpenGLShader::LoadResource(string resource){
             ResetProperties();
 
@@ -294,6 +519,8 @@ namespace OpenEngine {
                          vertexShaders.begin(), vertexShaders.end());
             files.insert(files.end(),
                          geometryShaders.begin(), geometryShaders.end());
+            // The timestamps are kept for watched shaders too, they
+            // are polled if the watcher stops.
             std::vector<std::string>::iterator fileItr = files.begin();
             while (fileItr != files.end()) {
                 std::string filename = *fileItr;
@@ -301,6 +528,11 @@ namespace OpenEngine {
                     GetLastModified(DirectoryManager::FindFileInPath(filename));
                 fileItr++;
             }
+            if (ShaderWatcher::IsRunning()){
+                for (unsigned int i = 0; i < files.size(); ++i)
+                    files[i] = DirectoryManager::FindFileInPath(files[i]);
+                watched = ShaderWatcher::Watch(this, files);
+            }
         }     
 
         void OpenGLShader::PrintShaderInfoLog(GLuint shader){
@@ -338,8 +570,37 @@ namespace OpenEngine {
 #endif
         }
         
+        /**
+         * Issue the compilation and linking of the program without
+         * waiting for the result, see CheckShaderPrograms.
+         */
         void OpenGLShader::BindShaderPrograms(){
+            // Shaders with the same sources and defines, e.g. the
+            // phong shaders of different materials, share a single
+            // program.
+            string key = GetDefineHeader() + GetSourceKey();
+            map<string, GLuint>::iterator shared = programsByKey.find(key);
+            if (shared != programsByKey.end()){
+                shaderProgram = shared->second;
+                ++sharedPrograms[shaderProgram].users;
+                return;
+            }
+
+            // Try the program binary cache before compiling.
+            programKey.clear();
+            if (ProgramBinaryCache::IsEnabled()){
+                string binaryKey = ProgramBinaryCache::MakeKey(key);
+                shaderProgram = ProgramBinaryCache::Load(binaryKey);
+                if (shaderProgram != 0){
+                    ShareProgram(key);
+                    return;
+                }
+                programKey = binaryKey;
+            }
+
             shaderProgram = glCreateProgram();
+            ShareProgram(key);
+            ProgramBinaryCache::Prepare(shaderProgram);
 
             // attach vertex shader
             if (!vertexShaders.empty() && vertexSupport){
@@ -349,6 +610,7 @@ namespace OpenEngine {
                     throw Exception("Failed loading vertexshader");
 #endif
                 glAttachShader(shaderProgram, shader);
+                pendingShaders.push_back(make_pair(shader, vertexShaders));
             }
 
             /*        
@@ -371,20 +633,96 @@ namespace OpenEngine {
                     throw Exception("Failed loading fragmentshader");
 #endif
                 glAttachShader(shaderProgram, shader);
+                pendingShaders.push_back(make_pair(shader, fragmentShaders));
             }
             
-            // Link the program object and print out the info log
+            // Link the program object, the status is checked later.
             glLinkProgram(shaderProgram);
-            GLint linked;
-            glGetProgramiv(shaderProgram, GL_LINK_STATUS, &linked);
-            
+            linking = true;
             CHECK_FOR_GL_ERROR();
-            PrintProgramInfoLog(shaderProgram);
+        }
+
+        /**
+         * Wait for the program issued by BindShaderPrograms and check
+         * the compile and link status.
+         */
+        void OpenGLShader::CheckShaderPrograms(){
+            if (linking){
+                linking = false;
+                for (unsigned int i = 0; i < pendingShaders.size(); ++i)
+                    CheckShader(pendingShaders[i].first, pendingShaders[i].second);
+                pendingShaders.clear();
+
+                GLint linked;
+                glGetProgramiv(shaderProgram, GL_LINK_STATUS, &linked);
+            
+                CHECK_FOR_GL_ERROR();
+                PrintProgramInfoLog(shaderProgram);
 #if OE_SAFE            
-            if(linked == 0)
-                throw Exception("Could not link shader program");
+                if(linked == 0)
+                    throw Exception("Could not link shader program");
 #endif
-            
+
+                if (!programKey.empty() && linked != 0)
+                    ProgramBinaryCache::Store(programKey, shaderProgram);
+            }
+
+            // Connect the shared uniform blocks, if declared.
+            UniformBlocks::BindProgram(shaderProgram);
+            variants[GetDefineHeader()] = shaderProgram;
+            variantChanged = false;
+        }
+
+        /**
+         * The current defines as preprocessor directives.
+         */
+        string OpenGLShader::GetDefineHeader(){
+            string header;
+            map<string, string>::iterator itr = defines.begin();
+            for (; itr != defines.end(); ++itr)
+                header += "#define " + itr->first + " " + itr->second + "\n";
+            return header;
+        }
+
+        /**
+         * The sources of all stages of the program, used to key the
+         * shared programs and the program binary cache.
+         */
+        string OpenGLShader::GetProgramSource(){
+            string source;
+            const vector<string>* stages[3] = 
+                { &vertexShaders, &geometryShaders, &fragmentShaders };
+            for (unsigned int s = 0; s < 3; ++s){
+                source += "\nstage\n";
+                for (unsigned int i = 0; i < stages[s]->size(); ++i){
+                    ifstream* in = File::Open(DirectoryManager::FindFileInPath((*stages[s])[i]));
+                    source += string(istreambuf_iterator<char>(*in),
+                                     istreambuf_iterator<char>());
+                    in->close();
+                    delete in;
+                }
+            }
+            return source;
+        }
+
+        /**
+         * Hash of the stage sources. The sources are only read again
+         * when their timestamps changed since the last hash.
+         */
+        string OpenGLShader::GetSourceKey(){
+            bool changed = sourceKey.empty() ||
+                sourceKeyStamps.size() != timestamps.size();
+            map<string, Utils::DateTime>::iterator itr = timestamps.begin();
+            for (; !changed && itr != timestamps.end(); ++itr){
+                map<string, Utils::DateTime>::iterator old = 
+                    sourceKeyStamps.find(itr->first);
+                changed = old == sourceKeyStamps.end() || old->second != itr->second;
+            }
+            if (changed){
+                sourceKey = ProgramBinaryCache::Hash(GetProgramSource());
+                sourceKeyStamps = timestamps;
+            }
+            return sourceKey;
         }
 
         /**
@@ -393,27 +731,58 @@ namespace OpenEngine {
         GLuint OpenGLShader::LoadShader(vector<string> files, int type){
             GLuint shader = glCreateShader(type);
             
-            unsigned int size = files.size();
-            const GLchar** shaderBits = new const GLchar*[size];
+            // The defines go first, after the version directive if
+            // the shader has one.
+            vector<string> sources;
+            sources.push_back(GetDefineHeader());
 
             // Read all the shaders from disk
-            for (unsigned int i = 0; i < size; ++i){
+            for (unsigned int i = 0; i < files.size(); ++i){
                 if (printinfo)
                     logger.info << "Loading shader: " << files[i] << logger.end;
-                shaderBits[i] = File::ReadShader<GLchar>(DirectoryManager::FindFileInPath(files[i]));
-                if (shaderBits[i] == NULL) return 0;
+                const GLchar* bits = File::ReadShader<GLchar>(DirectoryManager::FindFileInPath(files[i]));
+                if (bits == NULL) return 0;
+                string source(bits);
+                if (i == 0 && source.compare(0, 8, "#version") == 0){
+                    string::size_type end = source.find('\n');
+                    sources[0] = source.substr(0, end) + "\n" + sources[0];
+                    source = end == string::npos ? "" : source.substr(end + 1);
+                }
+                sources.push_back(source);
+            }
+            // Bindless textures need GLSL 4.00. Shaders without a
+            // version directive are compiled as compatibility
+            // profile shaders to keep the built in state. The
+            // extension must be enabled before the first source
+            // declares anything.
+            if (bindless){
+                if (sources[0].compare(0, 8, "#version") != 0)
+                    sources[0] = "#version 400 compatibility\n" + sources[0];
+                string::size_type end = sources[0].find('\n') + 1;
+                sources[0].insert(end, "#extension GL_ARB_bindless_texture : require\n");
             }
 
-            glShaderSource(shader, size, shaderBits, NULL);
+            unsigned int size = sources.size();
+            vector<const GLchar*> shaderBits(size);
+            for (unsigned int i = 0; i < size; ++i)
+                shaderBits[i] = sources[i].c_str();
+            glShaderSource(shader, size, &shaderBits[0], NULL);
 
-            // Compile shader
+            // Compile shader, the status is checked by CheckShader.
             glCompileShader(shader);
+            return shader;
+        }
+
+        /**
+         * Check the compile status of a shader.
+         */
+        void OpenGLShader::CheckShader(GLuint shader, vector<string> files){
             GLint  compiled;
             glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
 #if OE_SAFE
             if (compiled==0) {
                 logger.error << "Failed compiling shader program consisting of: " << logger.end;
-                for (unsigned int i = 0; i< size; ++i)
+                for (unsigned int i = 0; i< files.size(); ++i)
                     logger.error << files[i] << logger.end;
                 GLsizei bufsize;
                 const int maxBufSize = 100;
@@ -425,7 +794,6 @@ namespace OpenEngine {
 #endif
             
             PrintShaderInfoLog(shader);
-            return shader;
         }
                 
     }
@@ -16,6 +16,7 @@
 #include <Meta/OpenGL.h>
 #include <Utils/DateTime.h>
 #include <Utils/Timer.h>
+#include <set>
 
 using namespace std;
 
@@ -41,36 +42,55 @@ namespace OpenEngine {
             
             enum UniformKind {
 #include "UniformList.h"
+                UNIFORM_MAT4,
                 UNKNOWN };
 
+            /**
+             * A uniform slot. The value lives in the uniform arena
+             * of the shader at the given offset.
+             */
             struct uniform{
-                GLuint loc;
+                string name;
+                GLint loc;
                 UniformKind kind;
-                bool bound;
-                void* data;
-            };
-            struct matrix {
-                GLuint loc;
-                Matrix<4, 4, float> mat;
+                unsigned int offset, size;
+                bool resolved, dirty;
             };
             struct sampler2D{
                 GLuint loc;
                 GLint texUnit;
+                GLuint64 handle; // uploaded bindless handle
                 ITexture2DPtr tex;
             };
             struct sampler3D{
                 GLuint loc;
                 GLint texUnit;
+                GLuint64 handle;
                 ITexture3DPtr tex;
             };
+            /**
+             * A program shared by all shaders with the same sources
+             * and defines. The owner is the shader whose uniforms
+             * were last uploaded to it.
+             */
+            struct sharedProgram{
+                string key;
+                unsigned int users;
+                void* owner;
+            };
         }
         
         using namespace OpenGLShaderStructs;
 
         class OpenGLShader : public IShaderResource{
+            // clears watched when it stops watching a shader
+            friend class ShaderWatcher;
         protected:
             static int shaderModel;
             static bool vertexSupport, geometrySupport, fragmentSupport;
+            static map<string, GLuint> programsByKey;
+            static map<GLuint, sharedProgram> sharedPrograms;
+            static set<OpenGLShader*> shaders; // all live shaders
             
         protected:
             string resource;
@@ -78,17 +98,33 @@ namespace OpenEngine {
             vector<string> geometryShaders;
             vector<string> fragmentShaders;
             std::map<std::string, Utils::DateTime> timestamps;
+            // hash of the stage sources and the timestamps it was
+            // computed from
+            string sourceKey;
+            std::map<std::string, Utils::DateTime> sourceKeyStamps;
+            // preprocessor defines and the programs compiled for
+            // each define set
+            map<string, string> defines;
+            map<string, GLuint> variants;
+            bool variantChanged;
+            bool watched;
 
             GLuint shaderProgram;
+            // shaders and cache key of a program being linked
+            bool linking;
+            vector<pair<GLuint, vector<string> > > pendingShaders;
+            string programKey;
             GLint nextTexUnit;
+            bool bindless;
 
             Utils::Timer timer;
 
-            map<string, uniform> boundUniforms;
-            map<string, uniform> unboundUniforms;
-
-            map<string, matrix> boundMatUnis;
-            map<string, matrix> unboundMatUnis;
+            // Uniforms are indexed by their handle, and their values
+            // are stored back to back in a single arena.
+            vector<uniform> uniforms;
+            map<string, int> uniformHandles;
+            vector<char> uniformData;
+            vector<int> dirtyUniforms;
 
             map<string, sampler2D> boundTex2Ds;
             map<string, sampler2D> unboundTex2Ds;
@@ -96,18 +132,36 @@ namespace OpenEngine {
             map<string, sampler3D> boundTex3Ds;
             map<string, sampler3D> unboundTex3Ds;
 
+            // attribute locations of attributeProgram
+            map<string, GLint> attributeLocs;
+            GLuint attributeProgram;
+
+            // uniform buffers by binding point
+            map<GLuint, GLuint> uniformBuffers;
+
             void LoadResource(string resource);
             void ResetProperties();
+            void RestoreUniforms();
+            void ShareProgram(string key);
+            void ReleaseProgram(GLuint program);
             void PrintShaderInfoLog(GLuint shader);
             void PrintProgramInfoLog(GLuint program);
             GLint GetUniLoc(const GLchar *name);
             void BindShaderPrograms();
+            void CheckShaderPrograms();
             GLuint LoadShader(vector<string>, int);
+            void CheckShader(GLuint shader, vector<string> files);
+            string GetProgramSource();
+            string GetSourceKey();
+            string GetDefineHeader();
+            void SelectVariant();
             void BindUniforms();
-            void BindUniform(uniform uni);
-            void BindUniform(matrix mat);
-            void DeleteData(uniform uni);
+            void BindUniform(uniform& uni);
+            void StoreUniform(int handle, UniformKind kind, const void* data, unsigned int size);
+            const uniform& FindUniform(string name, UniformKind kind);
             void BindTextures();
+            GLint NextTexUnit();
+            void BindHandle(GLuint loc, GLuint64& current, GLuint texture);
             
         public:
             OpenGLShader();
@@ -117,15 +171,62 @@ namespace OpenEngine {
             void Load();
             void Unload();
 
+            // Asynchronous loading
+            void StartLoad();
+            void FinishLoad();
+            bool IsLoadComplete();
+            void Reload();
+
+            /**
+             * Set a preprocessor define for all stages of the
+             * shader. Each set of defines is compiled to its own
+             * program the first time it is applied and kept until
+             * the shader is unloaded, so switching between define
+             * sets does not recompile.
+             */
+            void SetDefine(string name, string value = "1");
+            void SetDefine(string name, int value);
+            void RemoveDefine(string name);
+            bool HasDefine(string name);
+
             void ApplyShader();
             void ReleaseShader();
 
             int GetUniformID(string name);
+
+            /**
+             * Resolve a uniform name to a handle. Handles are stable
+             * for the lifetime of the shader, also across reloads,
+             * and setting a uniform through its handle avoids any
+             * string lookups. Only values that changed are uploaded
+             * on the next ApplyShader.
+             */
+            int GetUniformHandle(string name);
             
             void SetTexture(string name, ITexture2DPtr tex, bool force = false);
             void SetTexture(string name, ITexture3DPtr tex, bool force = false);
             void GetTexture(string name, ITexture2DPtr& tex);
             void GetTexture(string name, ITexture3DPtr& tex);
+
+            /**
+             * Read the textures of the shader through resident
+             * handles (GL_ARB_bindless_texture) instead of texture
+             * units, if the driver supports it. The shader is
+             * compiled with BINDLESS_TEXTURES defined and the
+             * extension enabled ahead of its sources. Shaders without
+             * a version directive are compiled as GLSL 4.00
+             * compatibility.
+             */
+            void SetBindlessTextures(bool enabled);
+
+            /**
+             * Bind a uniform buffer to a binding point whenever the
+             * shader is applied, for blocks owned by a single effect,
+             * see UniformBlocks. The buffer is not owned by the
+             * shader.
+             */
+            void SetUniformBuffer(GLuint binding, GLuint buffer);
+
             TextureList GetTextures();
 
             // Uniform functions
@@ -142,11 +243,31 @@ namespace OpenEngine {
             void SetUniform(string name, Matrix<4, 4, float> value, bool force = false);
             void GetUniform(string name, Matrix<4, 4, float>& value);
 
+            // Handle based uniform functions
+#undef GL_SHADER_SCALAR
+#define GL_SHADER_SCALAR(type, extension)                               \
+            void SetUniform(int handle, type value);
+#undef GL_SHADER_VECTOR
+#define GL_SHADER_VECTOR(params, type, extension)                       \
+            void SetUniform(int handle, Vector<params, type> value);
+
+#include "UniformList.h"
+            void SetUniform(int handle, Matrix<4, 4, float> value);
+
             // Attribute functions
             void SetAttribute(string name, IDataBlockPtr values);
             bool HasAttribute(string name);
+            int GetAttributeID(string name);
 
             static void ShaderSupport();
+            static void Deinitialize();
+
+            /**
+             * The linked program of the shader. Shaders sharing a
+             * program return the same id, so consecutive shaders
+             * with the same id only need their uniforms restored.
+             */
+            inline GLuint GetProgramID() { return shaderProgram; }
 
             inline int GetShaderModel() { return shaderModel; }
             inline bool HasVertexSupport() { return vertexSupport; }
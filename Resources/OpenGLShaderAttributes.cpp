@@ -9,6 +9,7 @@
 //--------------------------------------------------------------------
 
 #include <Resources/OpenGLShader.h>
+#include <Renderers/OpenGL/GLStateCache.h>
 
 #include <Resources/Exceptions.h>
 #include <Resources/IDataBlock.h>
@@ -18,6 +19,8 @@
 namespace OpenEngine {
     namespace Resources {
 
+        using Renderers::OpenGL::GLStateCache;
+
         void OpenGLShader::SetAttribute(string name, IDataBlockPtr values){
             // @TODO Store in map instead! Does the shader remember
             // which attribs was bound to it? Then we also need to
@@ -30,24 +33,41 @@ namespace OpenEngine {
 
             logger.info << "Setting attribute " << name << logger.end;
 
-            GLint loc = glGetAttribLocation(shaderProgram, name.c_str());
+            GLint loc = GetAttributeID(name);
             glEnableClientState(GL_VERTEX_ARRAY);
             if (values->GetID() == 0){
                 // Use vertex arrays
                 glVertexAttribPointer(loc, values->GetDimension(), values->GetType(), 0, 0, values->GetVoidData());
             }else{
-                glBindBuffer(GL_ARRAY_BUFFER, values->GetID());
+                GLStateCache::BindBuffer(GL_ARRAY_BUFFER, values->GetID());
                 glVertexAttribPointer(loc, values->GetDimension(), values->GetType(), 0, 0, 0);
             }
             CHECK_FOR_GL_ERROR();
         }
 
+        /**
+         * The location of an attribute, -1 if the program does not
+         * declare it. Locations are queried once per program.
+         */
+        int OpenGLShader::GetAttributeID(string name){
+            if (linking) FinishLoad();
+            if (attributeProgram != shaderProgram){
+                attributeLocs.clear();
+                attributeProgram = shaderProgram;
+            }
+            map<string, GLint>::iterator itr = attributeLocs.find(name);
+            if (itr != attributeLocs.end()) return itr->second;
+            GLint loc = glGetAttribLocation(shaderProgram, name.c_str());
+            attributeLocs[name] = loc;
+            return loc;
+        }
+
         bool OpenGLShader::HasAttribute(string name){
 #if OE_SAFE
             if (shaderProgram == 0)
                 throw ResourceException("No shader to apply. Perhaps it was not loaded.");
 #endif
-            GLint loc = glGetAttribLocation(shaderProgram, name.c_str());
+            GLint loc = GetAttributeID(name);
             CHECK_FOR_GL_ERROR();
             return loc != -1;
         }
@@ -9,6 +9,10 @@
 //--------------------------------------------------------------------
 
 #include <Resources/OpenGLShader.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Renderers/OpenGL/BindlessTextures.h>
+#include <Renderers/OpenGL/ResidencyManager.h>
+#include <Resources/Exceptions.h>
 
 #include <Resources/ITexture2D.h>
 #include <Resources/ITexture3D.h>
@@ -16,6 +20,45 @@
 namespace OpenEngine {
     namespace Resources {
 
+        using Renderers::OpenGL::GLStateCache;
+        using Renderers::OpenGL::BindlessTextures;
+        using Renderers::OpenGL::ResidencyManager;
+
+        void OpenGLShader::SetBindlessTextures(bool enabled){
+            enabled = enabled && BindlessTextures::IsSupported();
+            if (enabled == bindless) return;
+            bindless = enabled;
+            // The new variant rebinds all samplers.
+            if (bindless)
+                SetDefine("BINDLESS_TEXTURES");
+            else
+                RemoveDefine("BINDLESS_TEXTURES");
+        }
+
+        /**
+         * The samplers of a shader are packed into the units from 0
+         * and up. The assignment starts over when the properties are
+         * reset.
+         */
+        GLint OpenGLShader::NextTexUnit(){
+#if OE_SAFE
+            if (nextTexUnit >= GLStateCache::GetLimit(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS))
+                throw ResourceException("Shader uses more samplers than there are texture units.");
+#endif
+            return nextTexUnit++;
+        }
+
+        /**
+         * Set a sampler uniform to the resident handle of a texture,
+         * if it changed.
+         */
+        void OpenGLShader::BindHandle(GLuint loc, GLuint64& current, GLuint texture){
+            GLuint64 handle = BindlessTextures::GetHandle(texture);
+            if (handle == current) return;
+            glUniformHandleui64ARB(loc, handle);
+            current = handle;
+        }
+
         void OpenGLShader::SetTexture(string name, ITexture2DPtr tex, bool force){
             sampler2D sam;
             sam.tex = tex;
@@ -28,13 +71,15 @@ namespace OpenEngine {
                     // Set the samplers values and add it to the bound
                     // map.
                     sam.loc = GetUniLoc(name.c_str());
-                    sam.texUnit = nextTexUnit++;
-                    glUniform1i(sam.loc, sam.texUnit);
+                    sam.texUnit = NextTexUnit();
+                    sam.handle = 0;
+                    if (!bindless) glUniform1i(sam.loc, sam.texUnit);
                     boundTex2Ds[name] = sam;
                 }
             }else{
                 sam.loc = 0;
                 sam.texUnit = 0;
+                sam.handle = 0;
                 unboundTex2Ds[name] = sam;
             }
         }
@@ -51,13 +96,15 @@ namespace OpenEngine {
                     // Set the samplers values and add it to the bound
                     // map.
                     sam.loc = GetUniLoc(name.c_str());
-                    sam.texUnit = nextTexUnit++;
-                    glUniform1i(sam.loc, sam.texUnit);
+                    sam.texUnit = NextTexUnit();
+                    sam.handle = 0;
+                    if (!bindless) glUniform1i(sam.loc, sam.texUnit);
                     boundTex3Ds[name] = sam;
                 }
             }else{
                 sam.loc = 0;
                 sam.texUnit = 0;
+                sam.handle = 0;
                 unboundTex3Ds[name] = sam;
             }
         }
@@ -124,8 +171,9 @@ namespace OpenEngine {
                     // Set the samplers values and add it to the bound
                     // map.
                     sam.loc = GetUniLoc(name.c_str());
-                    sam.texUnit = nextTexUnit++;
-                    glUniform1i(sam.loc, sam.texUnit);
+                    sam.texUnit = NextTexUnit();
+                    sam.handle = 0;
+                    if (!bindless) glUniform1i(sam.loc, sam.texUnit);
                     boundTex2Ds[name] = sam;
                 }
                 unbound++;
@@ -145,30 +193,49 @@ namespace OpenEngine {
                     // Set the samplers values and add it to the bound
                     // map.
                     sam.loc = GetUniLoc(name.c_str());
-                    sam.texUnit = nextTexUnit++;
-                    glUniform1i(sam.loc, sam.texUnit);
+                    sam.texUnit = NextTexUnit();
+                    sam.handle = 0;
+                    if (!bindless) glUniform1i(sam.loc, sam.texUnit);
                     boundTex3Ds[name] = sam;
                 }
                 lazy++;
             }
             unboundTex3Ds.clear();
 
-            // Bind all the textures
+            // Mark the textures as used, loading evicted ones again.
+            map<string, sampler2D>::iterator used = boundTex2Ds.begin();
+            for (; used != boundTex2Ds.end(); ++used)
+                ResidencyManager::Touch(used->second.tex);
+
+            // Point bindless samplers at their handles.
+            if (bindless){
+                map<string, sampler2D>::iterator itr2 = boundTex2Ds.begin();
+                for (; itr2 != boundTex2Ds.end(); ++itr2)
+                    BindHandle(itr2->second.loc, itr2->second.handle, itr2->second.tex->GetID());
+                map<string, sampler3D>::iterator itr3 = boundTex3Ds.begin();
+                for (; itr3 != boundTex3Ds.end(); ++itr3)
+                    BindHandle(itr3->second.loc, itr3->second.handle, itr3->second.tex->GetID());
+                return;
+            }
+
+            // Bind all the textures. Units already holding the
+            // texture are skipped by the state cache without
+            // switching the active unit.
             map<string, sampler2D>::iterator itr2 = boundTex2Ds.begin();
             while(itr2 != boundTex2Ds.end()){
-                glActiveTexture(GL_TEXTURE0 + itr2->second.texUnit);
-                glBindTexture(GL_TEXTURE_2D, itr2->second.tex->GetID());
+                GLStateCache::BindTexture(GL_TEXTURE0 + itr2->second.texUnit, 
+                                          GL_TEXTURE_2D, itr2->second.tex->GetID());
                 itr2++;
             }
             map<string, sampler3D>::iterator itr3 = boundTex3Ds.begin();
             while(itr3 != boundTex3Ds.end()){
-                glActiveTexture(GL_TEXTURE0 + itr3->second.texUnit);
-                glBindTexture(itr3->second.tex->GetUseCase(), itr3->second.tex->GetID());
+                GLStateCache::BindTexture(GL_TEXTURE0 + itr3->second.texUnit, 
+                                          itr3->second.tex->GetUseCase(), itr3->second.tex->GetID());
                 itr3++;
             }
 
             // reset the active texture
-            glActiveTexture(GL_TEXTURE0);
+            GLStateCache::ActiveTexture(GL_TEXTURE0);
         }
 
     }
@@ -11,6 +11,7 @@
 #include <Resources/OpenGLShader.h>
 
 #include <Logging/Logger.h>
+#include <cstring>
 
 namespace OpenEngine {
     namespace Resources {
@@ -18,122 +19,90 @@ namespace OpenEngine {
 #undef GL_SHADER_SCALAR
 #define GL_SHADER_SCALAR(type, extension)                               \
         void OpenGLShader::SetUniform(string name, type value, bool force){ \
-            type *data = new type[1];                                   \
-            data[0] = value;                                            \
-            if (force){                                                 \
-                map<string, uniform>::iterator bound = boundUniforms.find(name); \
-                if (bound != boundUniforms.end()){                      \
-                    DeleteData(bound->second);                          \
-                    bound->second.data = data;                          \
-                    BindUniform(bound->second);                         \
-                }else{                                                  \
-                    uniform uni;                                        \
-                    uni.loc = GetUniLoc(name.c_str());   \
-                    uni.kind = UNIFORM##extension;                      \
-                    BindUniform(uni);                                   \
-                    boundUniforms[name] = uni;                          \
-                }                                                       \
-            }else{                                                      \
-                uniform uni;                                            \
-                uni.loc = 0;                                            \
-                uni.kind = UNIFORM##extension;                          \
-                uni.data = data;                                        \
-                unboundUniforms[name] = uni;                            \
-            }                                                           \
-        }                                                       
-        
+            int handle = GetUniformHandle(name);                        \
+            SetUniform(handle, value);                                  \
+            if (force && uniforms[handle].dirty)                        \
+                BindUniform(uniforms[handle]);                          \
+        }                                                               \
+        void OpenGLShader::SetUniform(int handle, type value){          \
+            StoreUniform(handle, UNIFORM##extension, &value, sizeof(type)); \
+        }
+
 #undef GL_SHADER_VECTOR
 #define GL_SHADER_VECTOR(params, type, extension)                       \
         void OpenGLShader::SetUniform(string name, Vector<params, type> value, bool force){ \
-            type *data = new type[params];                              \
+            int handle = GetUniformHandle(name);                        \
+            SetUniform(handle, value);                                  \
+            if (force && uniforms[handle].dirty)                        \
+                BindUniform(uniforms[handle]);                          \
+        }                                                               \
+        void OpenGLShader::SetUniform(int handle, Vector<params, type> value){ \
+            type data[params];                                          \
             value.ToArray(data);                                        \
-            if (force){                                                 \
-                map<string, uniform>::iterator bound = boundUniforms.find(name); \
-                if (bound != boundUniforms.end()){                      \
-                    DeleteData(bound->second);                          \
-                    bound->second.data = data;                          \
-                    BindUniform(bound->second);                         \
-                }else{                                                  \
-                    uniform uni;                                        \
-                    uni.loc = GetUniLoc(name.c_str());                  \
-                    uni.kind = UNIFORM##params##extension;              \
-                    BindUniform(uni);                                   \
-                    boundUniforms[name] = uni;                          \
-                }                                                       \
-            }else{                                                      \
-                uniform uni;                                            \
-                uni.loc = 0;                                            \
-                uni.kind = UNIFORM##params##extension;                  \
-                uni.data = data;                                        \
-                unboundUniforms[name] = uni;                            \
-            }                                                           \
+            StoreUniform(handle, UNIFORM##params##extension, data, params * sizeof(type)); \
         }
 #include "UniformList.h"
 
 
         void OpenGLShader::SetUniform(string name, Matrix<4, 4, float> value, bool force){
-            if (force){
-                map<string, matrix>::iterator bound = boundMatUnis.find(name);
-                if (bound != boundMatUnis.end()){
-                    bound->second.mat = value;
-                    BindUniform(bound->second);
-                }else{
-                    matrix mat;
-                    mat.loc = GetUniLoc(name.c_str());
-                    mat.mat = value;
-                    BindUniform(bound->second);
-                    unboundMatUnis[name] = mat;
-                }
-            }else{
-                matrix mat;
-                mat.loc = -1;
-                mat.mat = value;
-                unboundMatUnis[name] = mat;
-            }
+            int handle = GetUniformHandle(name);
+            SetUniform(handle, value);
+            if (force && uniforms[handle].dirty)
+                BindUniform(uniforms[handle]);
+        }
+
+        void OpenGLShader::SetUniform(int handle, Matrix<4, 4, float> value){
+            float data[16];
+            value.ToArray(data);
+            StoreUniform(handle, UNIFORM_MAT4, data, 16 * sizeof(float));
         }
         
 #undef GL_SHADER_SCALAR
 #define GL_SHADER_SCALAR(type, extension)                               \
         void OpenGLShader::GetUniform(string name, type& value){        \
-            map<string, uniform>::iterator itr = unboundUniforms.begin(); \
-            if (itr == unboundUniforms.end()){                          \
-                itr = boundUniforms.begin();                            \
-                if (itr == boundUniforms.end())                         \
-                    throw Exception("Uniform " + name + " not found."); \
-            }                                                           \
-            type* v = (type*)itr->second.data;                          \
-            value = *v;                                                 \
+            const uniform& uni = FindUniform(name, UNIFORM##extension); \
+            memcpy(&value, &uniformData[uni.offset], sizeof(type));     \
         }
         
 #undef GL_SHADER_VECTOR
 #define GL_SHADER_VECTOR(params, type, extension)                       \
         void OpenGLShader::GetUniform(string name, Vector<params, type>& value){ \
-            map<string, uniform>::iterator itr = unboundUniforms.begin(); \
-            if (itr == unboundUniforms.end()){                          \
-                itr = boundUniforms.begin();                            \
-                if (itr == boundUniforms.end())                         \
-                    throw Exception("Uniform " + name + " not found."); \
-            }                                                           \
-            type* v = (type*)itr->second.data;                          \
-            value = Vector<params, type>(v);                            \
+            const uniform& uni = FindUniform(name, UNIFORM##params##extension); \
+            value = Vector<params, type>((type*)&uniformData[uni.offset]); \
         }
 
 #include "UniformList.h"
 
         void OpenGLShader::GetUniform(string name, Matrix<4, 4, float>& value){
-            map<string, matrix>::iterator itr = unboundMatUnis.find(name);
-            if (itr == unboundMatUnis.end()){
-                itr = boundMatUnis.find(name);
-                if (itr == boundMatUnis.end())
-                    throw Exception("Uniform " + name + " not found.");
-            }
-            value = itr->second.mat;
+            const uniform& uni = FindUniform(name, UNIFORM_MAT4);
+            const float* f = (const float*)&uniformData[uni.offset];
+            value = Matrix<4, 4, float>(f[0], f[1], f[2], f[3],
+                                        f[4], f[5], f[6], f[7],
+                                        f[8], f[9], f[10], f[11],
+                                        f[12], f[13], f[14], f[15]);
         }
 
         int OpenGLShader::GetUniformID(string name){            
             return glGetUniformLocation(shaderProgram, name.c_str());
         }
 
+        int OpenGLShader::GetUniformHandle(string name){
+            map<string, int>::iterator itr = uniformHandles.find(name);
+            if (itr != uniformHandles.end())
+                return itr->second;
+
+            uniform uni;
+            uni.name = name;
+            uni.loc = -1;
+            uni.kind = UNKNOWN;
+            uni.offset = uni.size = 0;
+            uni.resolved = uni.dirty = false;
+            int handle = uniforms.size();
+            uniforms.push_back(uni);
+            uniformHandles[name] = handle;
+            return handle;
+        }
+
         //  *** Protected helper methods ***
 
         GLint OpenGLShader::GetUniLoc(const GLchar *name){
@@ -146,109 +115,96 @@ namespace OpenEngine {
         }
 
         /**
-         * Binds the unbound uniforms to the shader.
+         * Copy a value into the slot of a uniform and mark it dirty
+         * if it changed.
+         */
+        void OpenGLShader::StoreUniform(int handle, UniformKind kind, 
+                                        const void* data, unsigned int size){
+#if OE_SAFE
+            if (handle < 0 || handle >= (int)uniforms.size())
+                throw Exception("Invalid uniform handle.");
+#endif
+            uniform& uni = uniforms[handle];
+            if (uni.kind != kind){
+                // First value or change of type, reserve a new slot
+                // if the old one is too small.
+                if (uni.kind == UNKNOWN || uni.size < size){
+                    uni.offset = uniformData.size();
+                    uniformData.resize(uni.offset + size);
+                }
+                uni.kind = kind;
+                uni.size = size;
+            }else if (!uni.dirty && uni.resolved &&
+                      memcmp(&uniformData[uni.offset], data, size) == 0)
+                // Value already on the gpu.
+                return;
+
+            memcpy(&uniformData[uni.offset], data, size);
+            if (!uni.dirty){
+                uni.dirty = true;
+                dirtyUniforms.push_back(handle);
+            }
+        }
+
+        const uniform& OpenGLShader::FindUniform(string name, UniformKind kind){
+            map<string, int>::iterator itr = uniformHandles.find(name);
+            if (itr == uniformHandles.end() || uniforms[itr->second].kind != kind)
+                throw Exception("Uniform " + name + " not found.");
+            return uniforms[itr->second];
+        }
+
+        /**
+         * Uploads the uniforms that changed since the last bind.
          *
          * Assumes the shader is already applied.
          */
         void OpenGLShader::BindUniforms(){
-            {
-                // Apply the unbound uniforms.
-                map<string, uniform>::iterator unbound = unboundUniforms.begin();
-                while (unbound != unboundUniforms.end()){
-                    string name = unbound->first;
-                    uniform uni = unbound->second;
-                    map<string, uniform>::iterator bound = boundUniforms.find(name);
-                    if (bound != boundUniforms.end()){
-                        // If the uniform has already been bound, then
-                        // delete the old data, copy the new and bind it.
-                        DeleteData(bound->second);
-                        bound->second.data = uni.data;
-                        BindUniform(bound->second);
-                    }else{
-                        // Else get the location of the uniform, bind it
-                        // and copy it to the bound array.
-                        uni.loc = GetUniLoc(name.c_str());
-                        BindUniform(uni);
-                        boundUniforms[name] = uni;
-                    }
-                    ++unbound;
-                }
-                unboundUniforms.clear();
-            }
-            {
-                // Apply 4x4 mats
-                map<string, matrix>::iterator unbound = unboundMatUnis.begin();
-                while (unbound != unboundMatUnis.end()){
-                    string name = unbound->first;
-                    matrix uni = unbound->second;
-                    map<string, matrix>::iterator bound = boundMatUnis.find(name);
-                    if (bound != boundMatUnis.end()){
-                        bound->second.mat = uni.mat;
-                        BindUniform(bound->second);
-                    }else{
-                        uni.loc = GetUniLoc(name.c_str());
-                        BindUniform(uni);
-                        boundMatUnis[name] = uni;
-                    }
-                    ++unbound;
-                }
-                unboundMatUnis.clear();
+            vector<int>::iterator itr = dirtyUniforms.begin();
+            while (itr != dirtyUniforms.end()){
+                uniform& uni = uniforms[*itr];
+                // Forced uniforms may already have been bound.
+                if (uni.dirty)
+                    BindUniform(uni);
+                ++itr;
             }
+            dirtyUniforms.clear();
         }
               
         /**
-         * Bind the uniform to the GPU.
+         * Bind the uniform to the GPU, resolving its location the
+         * first time.
          */
-        void OpenGLShader::BindUniform(uniform uni){
+        void OpenGLShader::BindUniform(uniform& uni){
+            if (!uni.resolved){
+                uni.loc = GetUniLoc(uni.name.c_str());
+                uni.resolved = true;
+            }
+            uni.dirty = false;
+            if (uni.loc == -1) return;
+
+            const void* data = &uniformData[uni.offset];
             switch(uni.kind){
                 
 #undef GL_SHADER_SCALAR
 #define GL_SHADER_SCALAR(type, extension)                               \
                 case UNIFORM##extension :                               \
-                    glUniform1##extension##v (uni.loc, 1, (const GL##type*) uni.data); \
+                    glUniform1##extension##v (uni.loc, 1, (const GL##type*) data); \
                     break;
 #undef GL_SHADER_VECTOR
 #define GL_SHADER_VECTOR(params, type, extension)                       \
                 case UNIFORM##params##extension :                       \
-                    glUniform##params##extension##v (uni.loc, 1, (const GL##type*) uni.data); \
+                    glUniform##params##extension##v (uni.loc, 1, (const GL##type*) data); \
                     break;
 #include "UniformList.h"
+            case UNIFORM_MAT4:
+                glUniformMatrix4fv(uni.loc, 1, false, (const GLfloat*) data);
+                break;
                 
             default:
                 throw Exception("Unsupported uniform type. How did you manage that?");
             }
 	    CHECK_FOR_GL_ERROR();
         }
-        
-        void OpenGLShader::BindUniform(matrix mat){
-            float data[16];
-            mat.mat.ToArray(data);
-            glUniformMatrix4fv(mat.loc, 1, false, data);
-	    CHECK_FOR_GL_ERROR();
-        }
-
-        /**
-         * Delete the uniforms data.
-         */
-        void OpenGLShader::DeleteData(uniform uni){
-            switch(uni.kind){
-
-#undef GL_SHADER_SCALAR
-#define GL_SHADER_SCALAR(type, extension)                            \
-                case UNIFORM##extension :                            \
-                    delete [] ( type* ) uni.data;                    \
-                    break;
-#undef GL_SHADER_VECTOR
-#define GL_SHADER_VECTOR(params, type, extension)                       \
-                case UNIFORM##params##extension :                       \
-                    delete [] ( type* ) uni.data;                       \
-                    break;
-#include "UniformList.h"
-
-            default:
-                throw Exception("Unsupported uniform type. How did you manage that?");
-            }
-        }
 
         void OpenGLShader::PrintUniforms(){
             GLint uniforms;
@@ -12,14 +12,20 @@
 
 #include <Resources/DirectoryManager.h>
 #include <Logging/Logger.h>
-#include <Resources/Texture2D.h>
+
+#include <algorithm>
 
 namespace OpenEngine {
 namespace Resources {
         
 using namespace Geometry;
 
-    PhongShader::PhongShader(MaterialPtr mat, LightRenderer& lr)
+/**
+ * The phong shaders of all materials share their programs, see
+ * OpenGLShader, only the textures and uniforms are per material. The
+ * material colors are read from the fixed function material state.
+ */
+PhongShader::PhongShader(MaterialPtr mat, LightRenderer& lr)
     : OpenGLShader(DirectoryManager::FindFileInPath("extensions/OpenGLRenderer/shaders/PhongShader.glsl"))
     , mat(mat)
     , lr(lr)
@@ -28,42 +34,37 @@ using namespace Geometry;
     logger.info << "ambient: " << mat->ambient << logger.end;
     logger.info << "diffuse: " << mat->diffuse << logger.end;
     logger.info << "specular: " << mat->specular << logger.end;
-    unsigned char* d = new unsigned char[3];
-    d[0] = 0xFF;
-    d[1] = 0xFF;
-    d[2] = 0xFF;
-    whitetex = UCharTexture2DPtr(new Texture2D<unsigned char>(1, 1, 3, d));        
-    whitetex->SetFiltering(NONE);
-    whitetex->SetColorFormat(RGB);
-    whitetex->SetMipmapping(false);
-    whitetex->SetCompression(false);
-    whitetex->SetWrapping(REPEAT);
-
     Vector<4,float> white(1.0);
     ambient = mat->Get2DTextures()["ambient"];
     if (!ambient) {
-        ambient = whitetex;
         logger.info << "no ambient" << logger.end;
     }
     // SetTexture("ambientMap", ambient);
     
     diffuse = mat->Get2DTextures()["diffuse"];
     if (!diffuse) {
-        diffuse = whitetex;
         logger.info << "no diffuse" << logger.end;
     }
-    else mat->diffuse = white;
-
-    SetTexture("diffuseMap", diffuse);
+    else {
+        mat->diffuse = white;
+        SetDefine("HAS_DIFFUSE_MAP");
+        SetTexture("diffuseMap", diffuse);
+    }
 
     specular = mat->Get2DTextures()["specular"];
     if (!specular) {
-        specular = whitetex;
         logger.info << "no specular" << logger.end;
     }
-    // SetTexture("specularMap", specular);
+    else {
+        SetDefine("HAS_SPECULAR_MAP");
+        SetTexture("specularMap", specular);
+    }
 
-    SetUniform("lights", 0);
+    // The light count is compiled into the shader, each count
+    // gets its own program variant. Start out with the lights of
+    // the last frame so the load compiles the variant in use.
+    SetDefine("NUM_LIGHTS", std::min(lr.GetLightCount(), 2));
+    SetUniform("instanced", 0);
 }
 
 PhongShader::~PhongShader() {
@@ -71,15 +72,26 @@ PhongShader::~PhongShader() {
 }
 
 void PhongShader::Handle(LightCountChangedEventArg arg) {
-    
+    // The defines of a variant still compiling must not change.
+    if (linking) FinishLoad();
+
     if (arg.count > 2) {
-        SetUniform("lights", 2);
+        SetDefine("NUM_LIGHTS", 2);
         logger.warning << "Phong shader is given " << arg.count << " lights but only 2 is supported." << logger.end;
     }
     else {
-        SetUniform("lights", arg.count);
+        SetDefine("NUM_LIGHTS", arg.count);
         logger.info << "Phong shader is given " << arg.count << " lights." << logger.end;
     }
+
+    // Start compiling a new variant right away instead of when the
+    // shader is applied, so the phong shaders of all materials are
+    // compiled in parallel.
+    if (shaderProgram != 0 && variants.find(GetDefineHeader()) == variants.end()) {
+        StartLoad();
+        // A program shared with another shader is done already.
+        if (!linking) FinishLoad();
+    }
 }
 
 }
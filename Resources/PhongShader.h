@@ -31,7 +31,7 @@ private:
     // IShaderResourcePtr shader;
     MaterialPtr mat;
     LightRenderer& lr;
-    ITexture2DPtr ambient, diffuse, specular, whitetex;
+    ITexture2DPtr ambient, diffuse, specular;
 public:
     PhongShader(MaterialPtr mat, LightRenderer& lr);
     virtual ~PhongShader();
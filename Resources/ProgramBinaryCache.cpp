@@ -0,0 +1,159 @@
+// OpenGL program binary cache.
+// -------------------------------------------------------------------
+// Copyright (C) 2010 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Resources/ProgramBinaryCache.h>
+#include <Logging/Logger.h>
+
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+namespace OpenEngine {
+    namespace Resources {
+
+        using namespace std;
+
+        // File header of a cached program.
+        struct ProgramBinaryHeader {
+            char magic[4];
+            GLenum format;
+            GLint length;
+        };
+
+        string ProgramBinaryCache::directory;
+
+        /**
+         * Set the directory to store programs in. The directory
+         * must exist. An empty string disables the cache.
+         */
+        void ProgramBinaryCache::SetDirectory(string dir){
+            if (!dir.empty() && dir[dir.size()-1] != '/')
+                dir += '/';
+            directory = dir;
+        }
+
+        string ProgramBinaryCache::GetDirectory(){
+            return directory;
+        }
+
+        bool ProgramBinaryCache::IsEnabled(){
+            return !directory.empty() &&
+                (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary);
+        }
+
+        /**
+         * Hash a text.
+         *
+         * @return Key usable as a file name.
+         */
+        string ProgramBinaryCache::Hash(const string& text){
+            // fnv-1a and djb2 combined with the length.
+            unsigned int fnv = 2166136261u, djb = 5381;
+            for (string::size_type i = 0; i < text.size(); ++i){
+                unsigned char c = text[i];
+                fnv = (fnv ^ c) * 16777619u;
+                djb = djb * 33 + c;
+            }
+            char key[32];
+            sprintf(key, "%08x%08x%08x", fnv, djb, (unsigned int)text.size());
+            return string(key);
+        }
+
+        /**
+         * Hash the program source together with the driver strings.
+         *
+         * @param source All sources and defines of the program.
+         * @return Key usable as a file name.
+         */
+        string ProgramBinaryCache::MakeKey(const string& source){
+            string text = source;
+            const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+            for (unsigned int i = 0; i < 3; ++i){
+                const GLubyte* str = glGetString(names[i]);
+                if (str != NULL) text += (const char*)str;
+            }
+            return Hash(text);
+        }
+
+        /**
+         * Create a program from the cache.
+         *
+         * @return The linked program or 0 if the key is not cached
+         * or the driver rejected the binary.
+         */
+        GLuint ProgramBinaryCache::Load(const string& key){
+            ifstream in(GetFile(key).c_str(), ios::binary);
+            if (!in.is_open()) return 0;
+
+            ProgramBinaryHeader header;
+            in.read((char*)&header, sizeof(header));
+            if (!in.good() || strncmp(header.magic, "OEPB", 4) != 0 || header.length <= 0)
+                return 0;
+            vector<char> binary(header.length);
+            in.read(&binary[0], header.length);
+            if (!in.good()) return 0;
+
+            // Errors of earlier calls are reported here, not taken
+            // for a rejected binary.
+            CHECK_FOR_GL_ERROR();
+            GLuint program = glCreateProgram();
+            glProgramBinary(program, header.format, &binary[0], header.length);
+            // Clear the error of a format the driver no longer
+            // accepts.
+            glGetError();
+            GLint linked = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+            CHECK_FOR_GL_ERROR();
+            if (linked == 0){
+                glDeleteProgram(program);
+                return 0;
+            }
+            return program;
+        }
+
+        /**
+         * Ask the driver to keep the binary of a program that is
+         * about to be linked.
+         */
+        void ProgramBinaryCache::Prepare(GLuint program){
+            if (!IsEnabled()) return;
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            CHECK_FOR_GL_ERROR();
+        }
+
+        /**
+         * Store a linked program in the cache.
+         */
+        void ProgramBinaryCache::Store(const string& key, GLuint program){
+            GLint length = 0;
+            glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0) return;
+
+            ProgramBinaryHeader header;
+            memcpy(header.magic, "OEPB", 4);
+            vector<char> binary(length);
+            glGetProgramBinary(program, length, &header.length, &header.format, &binary[0]);
+            CHECK_FOR_GL_ERROR();
+
+            ofstream out(GetFile(key).c_str(), ios::binary | ios::trunc);
+            if (!out.is_open()){
+                logger.warning << "Could not write program binary to " << directory << logger.end;
+                return;
+            }
+            out.write((const char*)&header, sizeof(header));
+            out.write(&binary[0], header.length);
+        }
+
+        string ProgramBinaryCache::GetFile(const string& key){
+            return directory + key + ".bin";
+        }
+
+    }
+}
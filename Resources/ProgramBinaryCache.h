@@ -0,0 +1,48 @@
+// OpenGL program binary cache.
+// -------------------------------------------------------------------
+// Copyright (C) 2010 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_PROGRAM_BINARY_CACHE_H_
+#define _OPENGL_PROGRAM_BINARY_CACHE_H_
+
+#include <Meta/OpenGL.h>
+#include <string>
+
+namespace OpenEngine {
+    namespace Resources {
+
+        /**
+         * On disk cache of linked shader programs.
+         *
+         * Programs are stored with glGetProgramBinary under a key
+         * hashed from their sources and the driver strings, so a
+         * driver update or an edited source simply misses the cache.
+         * The cache is disabled until a directory is set.
+         *
+         * @class ProgramBinaryCache ProgramBinaryCache.h Resources/ProgramBinaryCache.h
+         */
+        class ProgramBinaryCache {
+        private:
+            static std::string directory;
+
+            static std::string GetFile(const std::string& key);
+        public:
+            static void SetDirectory(std::string dir);
+            static std::string GetDirectory();
+            static bool IsEnabled();
+
+            static std::string Hash(const std::string& text);
+            static std::string MakeKey(const std::string& source);
+            static GLuint Load(const std::string& key);
+            static void Prepare(GLuint program);
+            static void Store(const std::string& key, GLuint program);
+        };
+    }
+}
+
+#endif
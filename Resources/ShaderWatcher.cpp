@@ -0,0 +1,194 @@
+// Shader source file watcher.
+// -------------------------------------------------------------------
+// Copyright (C) 2010 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Resources/ShaderWatcher.h>
+#include <Resources/OpenGLShader.h>
+#include <Logging/Logger.h>
+
+#include <SDL/SDL_thread.h>
+#include <SDL/SDL_mutex.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace OpenEngine {
+    namespace Resources {
+
+        using namespace std;
+
+        SDL_Thread* ShaderWatcher::thread = NULL;
+        SDL_mutex* ShaderWatcher::lock = NULL;
+        int ShaderWatcher::fd = -1;
+        volatile bool ShaderWatcher::running = false;
+        map<string, int> ShaderWatcher::directories;
+        map<int, string> ShaderWatcher::watches;
+        multimap<string, OpenGLShader*> ShaderWatcher::files;
+        set<OpenGLShader*> ShaderWatcher::dirty;
+
+        /**
+         * Start the watcher thread.
+         *
+         * @return False if file watching is not supported.
+         */
+        bool ShaderWatcher::Start(){
+            if (running) return true;
+#ifdef __linux__
+            fd = inotify_init();
+            if (fd < 0){
+                logger.warning << "Could not initialize inotify, shaders are polled for changes." << logger.end;
+                return false;
+            }
+            lock = SDL_CreateMutex();
+            running = true;
+            thread = SDL_CreateThread(Run, NULL);
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        void ShaderWatcher::Stop(){
+            if (!running) return;
+            running = false;
+            SDL_WaitThread(thread, NULL);
+            thread = NULL;
+#ifdef __linux__
+            close(fd);
+#endif
+            fd = -1;
+            SDL_DestroyMutex(lock);
+            lock = NULL;
+            // The shaders poll their sources from now on.
+            multimap<string, OpenGLShader*>::iterator itr = files.begin();
+            for (; itr != files.end(); ++itr)
+                itr->second->watched = false;
+            directories.clear();
+            watches.clear();
+            files.clear();
+            dirty.clear();
+        }
+
+        bool ShaderWatcher::IsRunning(){
+            return running;
+        }
+
+        /**
+         * Watch the source files of a shader, replacing the files it
+         * was watched by before.
+         *
+         * @param paths Resolved paths of the files.
+         * @return True if all files are watched. Otherwise none are,
+         * and the shader must poll its files.
+         */
+        bool ShaderWatcher::Watch(OpenGLShader* shader, vector<string> paths){
+            if (!running) return false;
+            SDL_mutexP(lock);
+            Remove(shader);
+            for (unsigned int i = 0; i < paths.size(); ++i){
+                // Watch the directory, editors often replace the file.
+                string::size_type sep = paths[i].rfind('/');
+                string dir = sep == string::npos ? "." : paths[i].substr(0, sep);
+                string name = sep == string::npos ? paths[i] : paths[i].substr(sep + 1);
+#ifdef __linux__
+                if (directories.find(dir) == directories.end()){
+                    int wd = inotify_add_watch(fd, dir.c_str(), 
+                                               IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+                    if (wd < 0){
+                        logger.warning << "Could not watch " << dir 
+                                       << ", polling " << paths[i] << logger.end;
+                        Remove(shader);
+                        SDL_mutexV(lock);
+                        return false;
+                    }
+                    directories[dir] = wd;
+                    watches[wd] = dir;
+                }
+#endif
+                files.insert(make_pair(dir + "/" + name, shader));
+            }
+            SDL_mutexV(lock);
+            return true;
+        }
+
+        void ShaderWatcher::Unwatch(OpenGLShader* shader){
+            if (!running) return;
+            SDL_mutexP(lock);
+            Remove(shader);
+            dirty.erase(shader);
+            SDL_mutexV(lock);
+            shader->watched = false;
+        }
+
+        void ShaderWatcher::Remove(OpenGLShader* shader){
+            multimap<string, OpenGLShader*>::iterator itr = files.begin();
+            while (itr != files.end()){
+                if (itr->second == shader)
+                    files.erase(itr++);
+                else
+                    ++itr;
+            }
+        }
+
+        /**
+         * Reload the shaders whose files changed. Must be called on
+         * the render thread.
+         */
+        void ShaderWatcher::ProcessReloads(){
+            if (!running) return;
+            set<OpenGLShader*> reload;
+            SDL_mutexP(lock);
+            reload.swap(dirty);
+            SDL_mutexV(lock);
+
+            set<OpenGLShader*>::iterator itr = reload.begin();
+            for (; itr != reload.end(); ++itr){
+                (*itr)->Reload();
+            }
+        }
+
+        /**
+         * The watcher thread. Waits for notifications with a timeout,
+         * so Stop is noticed.
+         */
+        int ShaderWatcher::Run(void* data){
+#ifdef __linux__
+            char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+            while (running){
+                struct pollfd p;
+                p.fd = fd;
+                p.events = POLLIN;
+                p.revents = 0;
+                if (poll(&p, 1, 250) <= 0) continue;
+                ssize_t length = read(fd, buf, sizeof(buf));
+                if (length <= 0) continue;
+
+                SDL_mutexP(lock);
+                char* ptr = buf;
+                while (ptr < buf + length){
+                    struct inotify_event* e = (struct inotify_event*)ptr;
+                    map<int, string>::iterator dir = watches.find(e->wd);
+                    if (e->len > 0 && dir != watches.end()){
+                        string file = dir->second + "/" + e->name;
+                        multimap<string, OpenGLShader*>::iterator itr = files.lower_bound(file);
+                        for (; itr != files.upper_bound(file); ++itr)
+                            dirty.insert(itr->second);
+                    }
+                    ptr += sizeof(struct inotify_event) + e->len;
+                }
+                SDL_mutexV(lock);
+            }
+#endif
+            return 0;
+        }
+
+    }
+}
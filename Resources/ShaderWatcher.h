@@ -0,0 +1,68 @@
+// Shader source file watcher.
+// -------------------------------------------------------------------
+// Copyright (C) 2010 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OPENGL_SHADER_WATCHER_H_
+#define _OPENGL_SHADER_WATCHER_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+struct SDL_Thread;
+struct SDL_mutex;
+
+namespace OpenEngine {
+    namespace Resources {
+
+        class OpenGLShader;
+
+        /**
+         * Watches the source files of shaders for changes.
+         *
+         * A background thread waits for file system notifications
+         * (inotify) and marks the shaders using a changed file as
+         * dirty. The dirty shaders are reloaded by ProcessReloads,
+         * which the renderer calls at the start of every frame, so
+         * the render loop never touches the disk to find changes.
+         *
+         * Only available on Linux, elsewhere Start fails and shaders
+         * fall back to polling the file timestamps, as do shaders
+         * that are no longer watched after Unwatch or Stop, or whose
+         * directories could not be watched. Shaders must be destroyed
+         * on the render thread.
+         *
+         * @class ShaderWatcher ShaderWatcher.h Resources/ShaderWatcher.h
+         */
+        class ShaderWatcher {
+        private:
+            static SDL_Thread* thread;
+            static SDL_mutex* lock;
+            static int fd;
+            static volatile bool running;
+            static std::map<std::string, int> directories;
+            static std::map<int, std::string> watches;
+            static std::multimap<std::string, OpenGLShader*> files;
+            static std::set<OpenGLShader*> dirty;
+
+            static int Run(void* data);
+            static void Remove(OpenGLShader* shader);
+        public:
+            static bool Start();
+            static void Stop();
+            static bool IsRunning();
+
+            static bool Watch(OpenGLShader* shader, std::vector<std::string> paths);
+            static void Unwatch(OpenGLShader* shader);
+            static void ProcessReloads();
+        };
+    }
+}
+
+#endif
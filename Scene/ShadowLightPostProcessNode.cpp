@@ -8,6 +8,13 @@
 //--------------------------------------------------------------------
 
 #include <Scene/ShadowLightPostProcessNode.h>
+#include <Renderers/OpenGL/Renderer.h>
+#include <Renderers/OpenGL/StreamBuffer.h>
+#include <Renderers/OpenGL/GLStateCache.h>
+#include <Renderers/OpenGL/MeshBounds.h>
+#include <Renderers/OpenGL/GPUProfiler.h>
+#include <Renderers/OpenGL/RenderStatistics.h>
+#include <Renderers/OpenGL/UniformBlocks.h>
 #include <Scene/TransformationNode.h>
 #include <Scene/MeshNode.h>
 #include <Logging/Logger.h>
@@ -15,6 +22,13 @@
 #include <Geometry/Mesh.h>
 #include <Geometry/GeometrySet.h>
 #include <Resources/IShaderResource.h>
+#include <Resources/OpenGLShader.h>
+#include <Core/Exceptions.h>
+#include <Utils/Convert.h>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <climits>
 
 namespace OpenEngine {
 namespace Scene {
@@ -23,14 +37,93 @@ using namespace Resources;
 using namespace Math;
 using namespace Display;
 using namespace Geometry;
+using Renderers::OpenGL::GLStateCache;
+using Renderers::OpenGL::StreamBuffer;
+using Renderers::OpenGL::GPUProfiler;
+using Renderers::OpenGL::RenderStatistics;
+using Renderers::OpenGL::UniformBlocks;
+using Renderers::OpenGL::MeshBounds;
+using Renderers::OpenGL::BoundingSphere;
+using Renderers::OpenGL::Frustum;
 
 ShadowLightPostProcessNode::DepthRenderer::DepthRenderer(ShadowLightPostProcessNode* n)
-    : shadowNode(n) {
+    : shadowNode(n), streamBuffer(NULL), directional(false), receivers(false), insideDepth(0)
+    , casters(0), culled(0) {
 
 }
 
+/**
+ * Setup the world space frusta of the light and the camera.
+ */
+void ShadowLightPostProcessNode::DepthRenderer::SetupCulling(Renderers::RenderingEventArg& arg) {
+    IViewingVolume* light = shadowNode->viewingVolume;
+    Matrix<4,4,float> view = light->GetViewMatrix();
+
+    // The light is assumed to be a rigid transformation, so its
+    // position and direction can be read off the view matrix.
+    float v[16], p[16];
+    view.ToArray(v);
+    light->GetProjectionMatrix().ToArray(p);
+    lightPos = Vector<3,float>(0.0f);
+    for (unsigned int i = 0; i < 3; ++i)
+        lightPos -= Vector<3,float>(v[i], v[4 + i], v[8 + i]) * v[12 + i];
+    lightDir = Vector<3,float>(-v[2], -v[6], -v[10]);
+    // an orthographic projection means a directional light
+    directional = p[15] == 1.0f;
+
+    IViewingVolume* camera = arg.canvas.GetViewingVolume();
+    // A cached map is reused when only the camera moved, so it must
+    // hold the casters of every receiver.
+    receivers = shadowNode->receiverCulling && !shadowNode->caching && camera != NULL;
+    if (receivers)
+        receiverFrustum.SetMatrix(camera->GetViewMatrix() *
+                                  camera->GetProjectionMatrix());
+
+    Matrix<4,4,float> identity(1, 0, 0, 0,
+                               0, 1, 0, 0,
+                               0, 0, 1, 0,
+                               0, 0, 0, 1);
+    model = identity;
+    bounds.ComputeSubNodes(shadowNode, identity);
+    insideDepth = 0;
+}
+
+/**
+ * Test if a world space sphere can cast a shadow into the visible
+ * region. The shadow of the sphere is contained in the cone from the
+ * light tangent to the sphere (a cylinder for directional lights),
+ * so the caster is culled if both the sphere and every direction of
+ * the cone are outside one of the camera planes.
+ */
+bool ShadowLightPostProcessNode::DepthRenderer::IsCaster(const BoundingSphere& s) {
+    if (s.infinite) return true;
+    if (lightFrustum.Test(s) == Frustum::OUTSIDE) return false;
+    if (!receivers) return true;
+
+    Vector<3,float> dir = lightDir;
+    float sinAlpha = 0.0f;
+    if (!directional) {
+        Vector<3,float> d = s.center - lightPos;
+        float len = d.GetLength();
+        if (len <= s.radius) return true;
+        dir = d * (1.0f / len);
+        sinAlpha = s.radius / len;
+    }
+    for (unsigned int i = 0; i < 6; ++i) {
+        Vector<4,float> p = receiverFrustum.GetPlane(i);
+        Vector<3,float> n(p[0], p[1], p[2]);
+        if (n * s.center + p[3] < -s.radius && n * dir <= -sinAlpha)
+            return false;
+    }
+    return true;
+}
+
 void ShadowLightPostProcessNode::DepthRenderer::ApplyViewingVolume(IViewingVolume& volume) {
+    ApplyMatrices(volume.GetProjectionMatrix(), volume.GetViewMatrix());
+}
 
+void ShadowLightPostProcessNode::DepthRenderer::ApplyMatrices(Matrix<4,4,float> projMatrix,
+                                                              Matrix<4,4,float> matrix) {
     // Select The Projection Matrix
     glMatrixMode(GL_PROJECTION);
     CHECK_FOR_GL_ERROR();
@@ -39,8 +132,7 @@ void ShadowLightPostProcessNode::DepthRenderer::ApplyViewingVolume(IViewingVolum
     glLoadIdentity();
     CHECK_FOR_GL_ERROR();
 
-    // Setup OpenGL with the volumes projection matrix
-    Matrix<4,4,float> projMatrix = volume.GetProjectionMatrix();
+    // Setup OpenGL with the projection matrix
     float arr[16] = {0};
     projMatrix.ToArray(arr);
     glMultMatrixf(arr);
@@ -54,8 +146,7 @@ void ShadowLightPostProcessNode::DepthRenderer::ApplyViewingVolume(IViewingVolum
     glLoadIdentity();
     CHECK_FOR_GL_ERROR();
 
-    // Get the view matrix and apply it
-    Matrix<4,4,float> matrix = volume.GetViewMatrix();
+    // Apply the view matrix
     float f[16] = {0};
     matrix.ToArray(f);
     glMultMatrixf(f);
@@ -64,17 +155,19 @@ void ShadowLightPostProcessNode::DepthRenderer::ApplyViewingVolume(IViewingVolum
 
 
 void ShadowLightPostProcessNode::DepthRenderer::Render(Renderers::RenderingEventArg arg) {
-    GLint prevFbo;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &prevFbo);
-    Vector<4, GLint> prevDims;
-    glGetIntegerv(GL_VIEWPORT, prevDims.ToArray());
-    CHECK_FOR_GL_ERROR();
+    GPUProfiler::Scope profile("shadow depth");
+    GLuint prevFbo = GLStateCache::GetFramebuffer();
+    Vector<4, GLint> prevDims = GLStateCache::GetViewport();
 
     // Setup the new frame buffer
     Vector<2, int> dims = shadowNode->shadowDims;
-    glViewport(0, 0, dims[0], dims[1]);
-    CHECK_FOR_GL_ERROR();
-    glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, shadowNode->depthFB->GetID());
+    GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER_EXT, shadowNode->depthFB->GetID());
+    // Only redraw the region touched by changed casters
+    if (shadowNode->partial) {
+        Vector<4, int> r = shadowNode->dirtyRect;
+        GLStateCache::Enable(GL_SCISSOR_TEST);
+        glScissor(r[0], r[1], r[2] - r[0], r[3] - r[1]);
+    }
     // Blit the previous framebuffer depth for merging instead of sorting.
     glClear(GL_DEPTH_BUFFER_BIT);
     CHECK_FOR_GL_ERROR();
@@ -85,33 +178,51 @@ void ShadowLightPostProcessNode::DepthRenderer::Render(Renderers::RenderingEvent
 
     //ApplyViewingVolume(*(arg.canvas.GetViewingVolume()));
 
-    // Apply VV
-    ApplyViewingVolume(*(shadowNode->viewingVolume));
+    casters = culled = 0;
+    if (shadowNode->casterCulling) SetupCulling(arg);
+    Renderers::OpenGL::Renderer* renderer =
+        dynamic_cast<Renderers::OpenGL::Renderer*>(&arg.renderer);
+    streamBuffer = renderer ? renderer->GetStreamBuffer() : NULL;
 
     // Turn of unneeded stuff!
     glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-    glEnable(GL_CULL_FACE);
+    GLStateCache::Enable(GL_CULL_FACE);
     glCullFace(GL_FRONT);
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_POLYGON_OFFSET_FILL);
+    GLStateCache::Enable(GL_DEPTH_TEST);
+    GLStateCache::Enable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(1.1, 4.0);
 
-
-    shadowNode->Accept(*this);
+    // Render each cascade into its own tile of the depth map
+    IViewingVolume* light = shadowNode->viewingVolume;
+    Matrix<4,4,float> view = light->GetViewMatrix();
+    unsigned int count = shadowNode->cascades;
+    for (unsigned int i = 0; i < count; ++i) {
+        Matrix<4,4,float> proj = count > 1
+            ? shadowNode->cascadeProj[i]
+            : light->GetProjectionMatrix();
+        GLStateCache::Viewport(i * dims[0], 0, dims[0], dims[1]);
+        ApplyMatrices(proj, view);
+        CHECK_FOR_GL_ERROR();
+        if (shadowNode->casterCulling)
+            lightFrustum.SetMatrix(view * proj);
+        shadowNode->Accept(*this);
+    }
 
     // glBindTexture(GL_TEXTURE_2D,shadowNode->depthFB->GetDepthTexture()->GetID());
     // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE_ARB, GL_NONE);
 
-    glDisable(GL_POLYGON_OFFSET_FILL);
+    GLStateCache::Disable(GL_POLYGON_OFFSET_FILL);
     glCullFace(GL_BACK);
+    if (shadowNode->partial)
+        GLStateCache::Disable(GL_SCISSOR_TEST);
 
     glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
 
-    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, prevFbo);
-    glViewport(prevDims[0], prevDims[1], prevDims[2], prevDims[3]);
+    GLStateCache::BindFramebuffer(GL_FRAMEBUFFER_EXT, prevFbo);
+    GLStateCache::Viewport(prevDims[0], prevDims[1], prevDims[2], prevDims[3]);
     CHECK_FOR_GL_ERROR();
 
     // Reset viewing volume
@@ -120,6 +231,22 @@ void ShadowLightPostProcessNode::DepthRenderer::Render(Renderers::RenderingEvent
 }
 
 void ShadowLightPostProcessNode::DepthRenderer::VisitTransformationNode(TransformationNode* node) {
+    bool inside = false;
+    if (shadowNode->casterCulling && insideDepth == 0) {
+        BoundingSphere bound;
+        unsigned int meshes;
+        if (bounds.Get(node, bound, meshes)) {
+            if (!IsCaster(bound)) {
+                culled += meshes;
+                return;
+            }
+            // Subtrees inside the light frustum still need the
+            // receiver test of their meshes.
+            inside = !receivers && lightFrustum.Test(bound) == Frustum::INSIDE;
+        }
+    }
+    if (inside) ++insideDepth;
+
     // push transformation matrix
     Matrix<4,4,float> m = node->GetTransformationMatrix();
     float f[16];
@@ -127,19 +254,27 @@ void ShadowLightPostProcessNode::DepthRenderer::VisitTransformationNode(Transfor
     glPushMatrix();
     glMultMatrixf(f);
     CHECK_FOR_GL_ERROR();
-    //Matrix<4, 4, float> oldModelView = currentModelViewMatrix;
-    //currentModelViewMatrix = m * currentModelViewMatrix;
+    Matrix<4, 4, float> oldModel = model;
+    model = m * model;
     // traverse sub nodes
     node->VisitSubNodes(*this);
     CHECK_FOR_GL_ERROR();
     // pop transformation matrix
     glPopMatrix();
-    //currentModelViewMatrix = oldModelView;
+    model = oldModel;
+    if (inside) --insideDepth;
     CHECK_FOR_GL_ERROR();
 }
 
 void ShadowLightPostProcessNode::DepthRenderer::VisitMeshNode(MeshNode* node) {
     MeshPtr mesh = node->GetMesh();
+    if (shadowNode->casterCulling && insideDepth == 0 &&
+        !IsCaster(MeshBounds::GetSphere(mesh.get()).Transform(model))) {
+        ++culled;
+        node->VisitSubNodes(*this);
+        return;
+    }
+    ++casters;
     GeometrySetPtr geom = mesh->GetGeometrySet();
 
     glDisableClientState(GL_NORMAL_ARRAY);
@@ -149,11 +284,19 @@ void ShadowLightPostProcessNode::DepthRenderer::VisitMeshNode(MeshNode* node) {
 
     IDataBlockPtr v = geom->GetVertices();
 
-    glBindBuffer(GL_ARRAY_BUFFER, v->GetID());
-    if (v->GetID() != 0)
-        glVertexPointer(v->GetDimension(), GL_FLOAT, 0, 0);
-    else
-        glVertexPointer(v->GetDimension(), GL_FLOAT, 0, v->GetVoidDataPtr());
+    // Dynamic vertices changed this frame are drawn from the stream
+    // buffer, their own buffer is out of date.
+    unsigned int streamOffset;
+    if (streamBuffer && streamBuffer->Lookup(v.get(), streamOffset)) {
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, streamBuffer->GetID());
+        glVertexPointer(v->GetDimension(), GL_FLOAT, 0, (GLvoid*)(size_t)streamOffset);
+    } else {
+        GLStateCache::BindBuffer(GL_ARRAY_BUFFER, v->GetID());
+        if (v->GetID() != 0)
+            glVertexPointer(v->GetDimension(), GL_FLOAT, 0, 0);
+        else
+            glVertexPointer(v->GetDimension(), GL_FLOAT, 0, v->GetVoidDataPtr());
+    }
 
 
     CHECK_FOR_GL_ERROR();
@@ -162,12 +305,14 @@ void ShadowLightPostProcessNode::DepthRenderer::VisitMeshNode(MeshNode* node) {
     GLsizei count = mesh->GetDrawingRange();
     unsigned int offset = mesh->GetIndexOffset();
     Geometry::Type type = mesh->GetType();
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer->GetID());
+    GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer->GetID());
     if (indexBuffer->GetID() != 0){
         glDrawElements(type, count, GL_UNSIGNED_INT, (GLvoid*)(offset * sizeof(GLuint)));
     }else{
         glDrawElements(type, count, GL_UNSIGNED_INT, indexBuffer->GetData() + offset);
     }
+    ++RenderStatistics::Current().drawElements;
+    RenderStatistics::Current().Draw(type, count);
 
 
 
@@ -180,9 +325,13 @@ void ShadowLightPostProcessNode::DepthRenderer::VisitMeshNode(MeshNode* node) {
 ShadowLightPostProcessNode::ShadowLightPostProcessNode(IShaderResourcePtr s,
                                                        Vector<2,int> dims,
                                                        Vector<2,int> shadowDims)
-: PostProcessNode(s, dims, 1, true),viewingVolume(NULL),shadowDims(shadowDims) {
+: PostProcessNode(s, dims, 1, true),viewingVolume(NULL),shadowDims(shadowDims)
+, casterCulling(true), receiverCulling(false), initialized(false)
+, cascades(1), splitLambda(0.5f), cascadeSplits(0.0f), shadowBlock(0)
+, caching(false), cacheValid(false), partial(false), dirtyRect(0) {
     depthFB = new FrameBuffer(shadowDims,0,true);
     depthRenderer = new DepthRenderer(this);
+    recorder = new CasterRecorder();
 
     GetEffect()->SetTexture("shadow", depthFB->GetDepthTexture());
 }
@@ -191,10 +340,288 @@ void ShadowLightPostProcessNode::SetViewingVolume(IViewingVolume* v) {
     viewingVolume = v;
 }
 
+void ShadowLightPostProcessNode::SetCasterCulling(bool enabled) {
+    casterCulling = enabled;
+}
+
+void ShadowLightPostProcessNode::SetReceiverCulling(bool enabled) {
+    receiverCulling = enabled;
+}
+
+unsigned int ShadowLightPostProcessNode::GetCasterCount() const {
+    return depthRenderer->casters;
+}
+
+unsigned int ShadowLightPostProcessNode::GetCulledCasterCount() const {
+    return depthRenderer->culled;
+}
+
+void ShadowLightPostProcessNode::SetCascades(unsigned int count, float lambda) {
+#if OE_SAFE
+    if (count == 0 || count > MAX_CASCADES)
+        throw Core::Exception("Invalid number of shadow cascades.");
+    if (initialized)
+        throw Core::Exception("Shadow cascades must be set before initialization.");
+#endif
+    cascades = count;
+    splitLambda = lambda;
+    cascadeSplits = Vector<4, float>(0.0f);
+
+    // one tile of shadowDims per cascade, side by side
+    delete depthFB;
+    depthFB = new FrameBuffer(Vector<2,int>(shadowDims[0] * count, shadowDims[1]), 0, true);
+    GetEffect()->SetTexture("shadow", depthFB->GetDepthTexture());
+    cacheValid = false;
+}
+
+unsigned int ShadowLightPostProcessNode::GetCascades() const {
+    return cascades;
+}
+
+void ShadowLightPostProcessNode::SetShadowCaching(bool enabled) {
+    caching = enabled;
+    cacheValid = partial = false;
+}
+
+void ShadowLightPostProcessNode::InvalidateShadowMap() {
+    cacheValid = false;
+}
+
+void ShadowLightPostProcessNode::CasterRecorder::Record(ISceneNode* root) {
+    casters.clear();
+    model = Matrix<4,4,float>(1, 0, 0, 0,
+                              0, 1, 0, 0,
+                              0, 0, 1, 0,
+                              0, 0, 0, 1);
+    root->VisitSubNodes(*this);
+}
+
+void ShadowLightPostProcessNode::CasterRecorder::VisitTransformationNode(TransformationNode* node) {
+    Matrix<4,4,float> oldModel = model;
+    model = node->GetTransformationMatrix() * model;
+    node->VisitSubNodes(*this);
+    model = oldModel;
+}
+
+void ShadowLightPostProcessNode::CasterRecorder::VisitMeshNode(MeshNode* node) {
+    Caster c;
+    c.node = node;
+    c.mesh = node->GetMesh().get();
+    c.model = model;
+    c.sphere = MeshBounds::GetSphere(c.mesh).Transform(model);
+    casters.push_back(c);
+    node->VisitSubNodes(*this);
+}
+
+static bool Equal(Matrix<4,4,float> a, Matrix<4,4,float> b) {
+    float fa[16], fb[16];
+    a.ToArray(fa);
+    b.ToArray(fb);
+    for (unsigned int i = 0; i < 16; ++i)
+        if (fa[i] != fb[i]) return false;
+    return true;
+}
+
+/**
+ * Grow the dirty rectangle by the pixels a world space sphere covers
+ * in each cascade of the depth map.
+ */
+void ShadowLightPostProcessNode::ExpandDirtyRect(const BoundingSphere& s,
+                                                 Matrix<4,4,float> view,
+                                                 std::vector<Matrix<4,4,float> >& proj) {
+    if (s.empty) return;
+    int w = shadowDims[0], h = shadowDims[1];
+    for (unsigned int i = 0; i < proj.size(); ++i) {
+        float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f;
+        bool whole = s.infinite;
+        float m[16];
+        (view * proj[i]).ToArray(m);
+        // project the corners of the box around the sphere
+        for (unsigned int c = 0; c < 8 && !whole; ++c) {
+            Vector<3,float> p(s.center[0] + (c & 1 ? s.radius : -s.radius),
+                              s.center[1] + (c & 2 ? s.radius : -s.radius),
+                              s.center[2] + (c & 4 ? s.radius : -s.radius));
+            float clip[4];
+            for (unsigned int k = 0; k < 4; ++k)
+                clip[k] = m[k] * p[0] + m[4 + k] * p[1] + m[8 + k] * p[2] + m[12 + k];
+            if (clip[3] <= 0.0f) {
+                whole = true;
+                break;
+            }
+            minX = std::min(minX, clip[0] / clip[3]);
+            maxX = std::max(maxX, clip[0] / clip[3]);
+            minY = std::min(minY, clip[1] / clip[3]);
+            maxY = std::max(maxY, clip[1] / clip[3]);
+        }
+        if (whole) {
+            minX = minY = -1.0f;
+            maxX = maxY = 1.0f;
+        }
+        if (minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f)
+            continue;
+
+        // to pixels of the tile, padded by a pixel for the offset
+        int x0 = i * w + std::max(0, int(std::floor((minX * 0.5f + 0.5f) * w)) - 1);
+        int x1 = i * w + std::min(w, int(std::ceil((maxX * 0.5f + 0.5f) * w)) + 1);
+        int y0 = std::max(0, int(std::floor((minY * 0.5f + 0.5f) * h)) - 1);
+        int y1 = std::min(h, int(std::ceil((maxY * 0.5f + 0.5f) * h)) + 1);
+        dirtyRect[0] = std::min(dirtyRect[0], x0);
+        dirtyRect[1] = std::min(dirtyRect[1], y0);
+        dirtyRect[2] = std::max(dirtyRect[2], x1);
+        dirtyRect[3] = std::max(dirtyRect[3], y1);
+    }
+}
+
+/**
+ * Compare the light and the casters to the ones the cached shadow
+ * map was rendered with.
+ *
+ * @return True if the shadow map must be rendered, in which case
+ * partial and dirtyRect tell which part of it.
+ */
+bool ShadowLightPostProcessNode::UpdateDirtyRegion() {
+    recorder->Record(this);
+    std::vector<CasterRecorder::Caster>& current = recorder->casters;
+
+    Matrix<4,4,float> view = viewingVolume->GetViewMatrix();
+    std::vector<Matrix<4,4,float> > proj;
+    if (cascades > 1)
+        proj = cascadeProj;
+    else
+        proj.push_back(viewingVolume->GetProjectionMatrix());
+
+    bool full = !cacheValid || !Equal(view, cachedView)
+        || proj.size() != cachedProj.size()
+        || current.size() != cachedCasters.size();
+    for (unsigned int i = 0; i < proj.size() && !full; ++i)
+        full = !Equal(proj[i], cachedProj[i]);
+
+    bool dirty = full;
+    partial = false;
+    if (!full) {
+        dirtyRect = Vector<4, int>(INT_MAX, INT_MAX, INT_MIN, INT_MIN);
+        for (unsigned int i = 0; i < current.size(); ++i) {
+            CasterRecorder::Caster& prev = cachedCasters[i];
+            CasterRecorder::Caster& cur = current[i];
+            if (prev.node == cur.node && prev.mesh == cur.mesh &&
+                Equal(prev.model, cur.model))
+                continue;
+            ExpandDirtyRect(prev.sphere, view, proj);
+            ExpandDirtyRect(cur.sphere, view, proj);
+        }
+        dirty = partial = dirtyRect[0] < dirtyRect[2] && dirtyRect[1] < dirtyRect[3];
+    }
+
+    cachedCasters.swap(current);
+    cachedView = view;
+    cachedProj = proj;
+    cacheValid = true;
+    return dirty;
+}
+
+/**
+ * Near and far plane distances of a projection matrix.
+ */
+static void GetDepthRange(const float* p, float& n, float& f) {
+    if (p[15] == 1.0f) {
+        // orthographic
+        n = (p[14] + 1.0f) / p[10];
+        f = (p[14] - 1.0f) / p[10];
+    } else {
+        n = p[14] / (p[10] - 1.0f);
+        f = p[14] / (p[10] + 1.0f);
+    }
+}
+
+/**
+ * Split the camera frustum and crop the light projection to the
+ * bounds of each slice in the light's clip space. The depth range of
+ * the light is kept, so casters between the light and the slice
+ * still land in the map. The camera is assumed to have a rigid view
+ * and a symmetric projection.
+ */
+void ShadowLightPostProcessNode::UpdateCascades(IViewingVolume& camera) {
+    float p[16], v[16], l[16];
+    camera.GetProjectionMatrix().ToArray(p);
+    camera.GetViewMatrix().ToArray(v);
+    Matrix<4,4,float> lightProj = viewingVolume->GetProjectionMatrix();
+    (viewingVolume->GetViewMatrix() * lightProj).ToArray(l);
+    bool ortho = p[15] == 1.0f;
+    float n, f;
+    GetDepthRange(p, n, f);
+
+    // The logarithmic split is undefined for a near plane at or
+    // behind the eye, e.g. of orthographic cameras, which are split
+    // uniformly.
+    float lambda = n > 0.0f && f > n ? splitLambda : 0.0f;
+
+    cascadeProj.clear();
+    float sliceNear = n;
+    for (unsigned int i = 0; i < cascades; ++i) {
+        // practical split scheme: blend logarithmic and uniform splits
+        float t = float(i + 1) / cascades;
+        float sliceFar = (1.0f - lambda) * (n + (f - n) * t);
+        if (lambda > 0.0f)
+            sliceFar += lambda * n * std::pow(f / n, t);
+        cascadeSplits[i] = sliceFar;
+
+        float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f;
+        bool behind = false;
+        for (unsigned int c = 0; c < 8; ++c) {
+            float d = (c & 4) ? sliceFar : sliceNear;
+            float s = ortho ? 1.0f : d;
+            Vector<3,float> e((c & 1 ? s : -s) / p[0],
+                              (c & 2 ? s : -s) / p[5],
+                              -d);
+            // eye to world space
+            Vector<3,float> w(0.0f);
+            for (unsigned int j = 0; j < 3; ++j)
+                for (unsigned int k = 0; k < 3; ++k)
+                    w[j] += v[j * 4 + k] * (e[k] - v[12 + k]);
+            // world to light clip space
+            float clip[4];
+            for (unsigned int k = 0; k < 4; ++k)
+                clip[k] = l[k] * w[0] + l[4 + k] * w[1] + l[8 + k] * w[2] + l[12 + k];
+            if (clip[3] <= 0.0f) {
+                behind = true;
+                break;
+            }
+            minX = std::min(minX, clip[0] / clip[3]);
+            maxX = std::max(maxX, clip[0] / clip[3]);
+            minY = std::min(minY, clip[1] / clip[3]);
+            maxY = std::max(maxY, clip[1] / clip[3]);
+        }
+        minX = std::max(minX, -1.0f); maxX = std::min(maxX, 1.0f);
+        minY = std::max(minY, -1.0f); maxY = std::min(maxY, 1.0f);
+        // slices behind the light or outside its volume keep the
+        // full projection
+        if (behind || maxX - minX <= 1e-4f || maxY - minY <= 1e-4f) {
+            minX = minY = -1.0f;
+            maxX = maxY = 1.0f;
+        }
+
+        float sx = 2.0f / (maxX - minX);
+        float sy = 2.0f / (maxY - minY);
+        Matrix<4,4,float> crop(sx, 0, 0, 0,
+                               0, sy, 0, 0,
+                               0, 0, 1, 0,
+                               -0.5f * (maxX + minX) * sx, -0.5f * (maxY + minY) * sy, 0, 1);
+        cascadeProj.push_back(lightProj * crop);
+        sliceNear = sliceFar;
+    }
+}
+
 void ShadowLightPostProcessNode::Initialize(Renderers::RenderingEventArg arg) {
+#if OE_SAFE
+    // The atlas holds the cascades side by side. SetCascades runs
+    // before a context is guaranteed, so the limit is checked here.
+    if (shadowDims[0] * (int)cascades > GLStateCache::GetLimit(GL_MAX_TEXTURE_SIZE))
+        throw Core::Exception("Shadow map atlas is wider than the maximum texture size.");
+#endif
     arg.renderer.BindFrameBuffer(depthFB);
+    initialized = true;
 
-    glBindTexture(GL_TEXTURE_2D,depthFB->GetDepthTexture()->GetID());
+    GLStateCache::BindTexture(GL_TEXTURE_2D,depthFB->GetDepthTexture()->GetID());
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE_ARB, GL_COMPARE_R_TO_TEXTURE_ARB);
     // GL_LINEAR does not make sense for depth texture. However, next tutorial shows usage of GL_LINEAR and PCF
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -204,22 +631,69 @@ void ShadowLightPostProcessNode::Initialize(Renderers::RenderingEventArg arg) {
     glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
     glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
 
+    // The light matrices go in a uniform block of the effect when
+    // supported, instead of uniforms set on its program.
+    boost::shared_ptr<OpenGLShader> effect =
+        boost::dynamic_pointer_cast<OpenGLShader>(GetEffect());
+    if (effect && UniformBlocks::IsInitialized() && shadowBlock == 0) {
+        UniformBlocks::ShadowBlock block;
+        memset(&block, 0, sizeof(block));
+        shadowBlock = UniformBlocks::CreateBuffer(&block, sizeof(block));
+        effect->SetUniformBuffer(UniformBlocks::SHADOW_BINDING, shadowBlock);
+    }
 }
 
 void ShadowLightPostProcessNode::Handle(Renderers::RenderingEventArg arg) {
     if (arg.renderer.GetCurrentStage() == Renderers::IRenderer::RENDERER_PREPROCESS) {
-        depthRenderer->Render(arg);
+        IViewingVolume* camera = arg.canvas.GetViewingVolume();
+        if (cascades > 1) {
+            if (camera != NULL)
+                UpdateCascades(*camera);
+            else
+                cascadeProj.assign(cascades, viewingVolume->GetProjectionMatrix());
+        }
+
+        if (!caching || UpdateDirtyRegion())
+            depthRenderer->Render(arg);
 
         Matrix<4,4,float> bias(.5, .0, .0,  .0,
                                .0, .5, .0,  .0,
                                .0, .0, .5,  .0,
                                .5, .5, .5, 1.0);
 
-
-        GetEffect()->SetUniform("lightMat",
-                                viewingVolume->GetViewMatrix() *
-                                viewingVolume->GetProjectionMatrix() *
-                                bias);
+        std::vector<Matrix<4,4,float> > lightMat;
+        if (cascades > 1) {
+            Matrix<4,4,float> view = viewingVolume->GetViewMatrix();
+            float w = 1.0f / cascades;
+            for (unsigned int i = 0; i < cascades; ++i) {
+                // map the cascade into its tile of the depth map
+                Matrix<4,4,float> tile(w,     .0, .0, .0,
+                                       .0,     1, .0, .0,
+                                       .0,    .0,  1, .0,
+                                       i * w, .0, .0,  1);
+                lightMat.push_back(view * cascadeProj[i] * bias * tile);
+            }
+        } else
+            lightMat.push_back(viewingVolume->GetViewMatrix() *
+                               viewingVolume->GetProjectionMatrix() *
+                               bias);
+
+        if (shadowBlock != 0) {
+            UniformBlocks::ShadowBlock block;
+            memset(&block, 0, sizeof(block));
+            for (unsigned int i = 0; i < cascades; ++i)
+                lightMat[i].ToArray(block.lightMat[i]);
+            cascadeSplits.ToArray(block.cascadeSplits);
+            block.cascades[0] = cascades;
+            UniformBlocks::UpdateBuffer(shadowBlock, &block, sizeof(block));
+        } else if (cascades > 1) {
+            for (unsigned int i = 0; i < cascades; ++i)
+                GetEffect()->SetUniform("lightMat[" + Utils::Convert::ToString<unsigned int>(i) + "]",
+                                        lightMat[i]);
+            GetEffect()->SetUniform("cascadeSplits", cascadeSplits);
+            GetEffect()->SetUniform("cascades", (int)cascades);
+        } else
+            GetEffect()->SetUniform("lightMat", lightMat[0]);
     }
     PostProcessNode::Handle(arg);
 }
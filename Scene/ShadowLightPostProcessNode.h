@@ -14,9 +14,20 @@
 #include <Scene/PostProcessNode.h>
 #include <Display/IViewingVolume.h>
 #include <Resources/FrameBuffer.h>
+#include <Renderers/OpenGL/Frustum.h>
+#include <Renderers/OpenGL/SceneBounds.h>
+#include <vector>
 
 
 namespace OpenEngine {
+namespace Geometry {
+    class Mesh;
+}
+namespace Renderers {
+namespace OpenGL {
+    class StreamBuffer;
+}
+}
 namespace Scene {
 
 /**
@@ -28,20 +39,82 @@ class ShadowLightPostProcessNode : public PostProcessNode {
 private:
     class DepthRenderer : public ISceneNodeVisitor {
         ShadowLightPostProcessNode* shadowNode;
+        // dynamic blocks streamed by the renderer this frame
+        Renderers::OpenGL::StreamBuffer* streamBuffer;
+        // world space culling state
+        Matrix<4,4,float> model;
+        Renderers::OpenGL::Frustum lightFrustum, receiverFrustum;
+        Renderers::OpenGL::SceneBounds bounds;
+        Vector<3,float> lightPos, lightDir;
+        bool directional, receivers;
+        unsigned int insideDepth;
+
+        void SetupCulling(Renderers::RenderingEventArg& arg);
+        bool IsCaster(const Renderers::OpenGL::BoundingSphere& sphere);
     public:
+        unsigned int casters, culled;
+
         DepthRenderer(ShadowLightPostProcessNode* n);
         void Render(Renderers::RenderingEventArg arg);
 
         void VisitTransformationNode(TransformationNode* node);
         void VisitMeshNode(MeshNode* node);
         void ApplyViewingVolume(Display::IViewingVolume& volume);
+        void ApplyMatrices(Matrix<4,4,float> proj, Matrix<4,4,float> view);
+    };
+
+    /**
+     * Records the world transformation of every caster, used to
+     * detect changes to the shadow map between frames.
+     */
+    class CasterRecorder : public ISceneNodeVisitor {
+        Matrix<4,4,float> model;
+    public:
+        struct Caster {
+            MeshNode* node;
+            Geometry::Mesh* mesh;
+            Matrix<4,4,float> model;
+            Renderers::OpenGL::BoundingSphere sphere;
+        };
+        std::vector<Caster> casters;
+
+        void Record(ISceneNode* root);
+        void VisitTransformationNode(TransformationNode* node);
+        void VisitMeshNode(MeshNode* node);
     };
 
     DepthRenderer* depthRenderer;
     Display::IViewingVolume* viewingVolume;
     Resources::FrameBuffer* depthFB;
     Vector<2, int> shadowDims;
+    bool casterCulling, receiverCulling, initialized;
+
+    // cascades
+    unsigned int cascades;
+    float splitLambda;
+    std::vector<Matrix<4,4,float> > cascadeProj;
+    Vector<4, float> cascadeSplits;
+    // uniform buffer of the shadow block, 0 if the effect reads
+    // uniforms
+    unsigned int shadowBlock;
+
+    void UpdateCascades(Display::IViewingVolume& camera);
+
+    // shadow map caching
+    bool caching, cacheValid, partial;
+    CasterRecorder* recorder;
+    std::vector<CasterRecorder::Caster> cachedCasters;
+    Matrix<4,4,float> cachedView;
+    std::vector<Matrix<4,4,float> > cachedProj;
+    Vector<4, int> dirtyRect;
+
+    bool UpdateDirtyRegion();
+    void ExpandDirtyRect(const Renderers::OpenGL::BoundingSphere& sphere,
+                         Matrix<4,4,float> view,
+                         std::vector<Matrix<4,4,float> >& proj);
 public:
+    static const unsigned int MAX_CASCADES = 4;
+
     ShadowLightPostProcessNode(Resources::IShaderResourcePtr shader,
                                Math::Vector<2, int> dims,
                                Math::Vector<2, int> shadowDims);
@@ -49,6 +122,69 @@ public:
     void Initialize(Renderers::RenderingEventArg arg);
 
     void SetViewingVolume(Display::IViewingVolume* v);
+
+    /**
+     * Enable or disable culling of shadow casters outside the
+     * frustum of the light. Enabled by default.
+     */
+    void SetCasterCulling(bool enabled);
+
+    /**
+     * Enable or disable culling of casters whose shadow cannot
+     * reach the frustum of the camera. Disabled by default. Only
+     * applies when caster culling is enabled and shadow caching is
+     * disabled.
+     */
+    void SetReceiverCulling(bool enabled);
+
+    /**
+     * Number of meshes drawn and culled by the last depth pass.
+     */
+    unsigned int GetCasterCount() const;
+    unsigned int GetCulledCasterCount() const;
+
+    /**
+     * Split the camera frustum into a number of slices, each with
+     * its own light projection cropped to the slice. The cascades
+     * are rendered side by side into a depth map of count times the
+     * shadow dimensions.
+     *
+     * With more than one cascade the effect receives the uniforms
+     * lightMat[i] (shadow map matrix of cascade i), cascadeSplits
+     * (the far eye space depth of each cascade) and cascades
+     * instead of lightMat. Must be called before the node is
+     * initialized, which fails if the shadow map atlas of count
+     * cascades is wider than GL_MAX_TEXTURE_SIZE.
+     *
+     * Where uniform buffers are supported the effect reads these
+     * from the ShadowBlock in shaders/UniformBlocks.glsl instead,
+     * with lightMat[0] and cascades.x also for a single cascade.
+     *
+     * @param count Number of cascades, at most MAX_CASCADES.
+     * @param lambda Blend between uniform (0) and logarithmic (1)
+     * split distances.
+     */
+    void SetCascades(unsigned int count, float lambda = 0.5f);
+    unsigned int GetCascades() const;
+
+    /**
+     * Enable or disable caching of the shadow map. When enabled the
+     * depth pass is skipped if neither the light nor any caster
+     * transformation changed since the last frame, and otherwise
+     * restricted to the region covered by the changed casters.
+     * Disabled by default.
+     *
+     * Changes to the vertex data of a caster are not detected, call
+     * InvalidateShadowMap when deforming casters. Receiver culling
+     * is turned off while caching, since the map is reused when only
+     * the camera moves.
+     */
+    void SetShadowCaching(bool enabled);
+
+    /**
+     * Force a full depth pass on the next frame.
+     */
+    void InvalidateShadowMap();
 };
 } // NS Scene
 } // NS OpenEngine
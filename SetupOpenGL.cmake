@@ -11,3 +11,9 @@ ELSE (GLEW_FOUND)
   MESSAGE ("WARNING: Could not find OpenGL extentions (GLEW) - depending targets will be disabled.")
   SET(OE_MISSING_LIBS "${OE_MISSING_LIBS}, GLEW")
 ENDIF (GLEW_FOUND)
+
+# OSMesa is optional, it is only used by the headless benchmark.
+INCLUDE(${OE_CURRENT_EXTENSION_DIR}/FindOSMesa.cmake)
+IF (OSMESA_FOUND)
+  INCLUDE_DIRECTORIES(${OSMESA_INCLUDE_DIR})
+ENDIF (OSMESA_FOUND)
@@ -0,0 +1,468 @@
+// Replay of OpenGL call traces.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+// Replays a frame captured by the GLTracer in an off screen OSMesa
+// context and reports the cpu cost of each kind of call, or prints
+// the call stream as text for diffing two captures.
+//
+// Objects created before the captured frame do not exist in the
+// replay. Buffers are created on first use with the size recorded
+// in the trace, textures without storage and all frame buffers are
+// replaced by the default frame buffer. Shader programs cannot be
+// rebuilt from a trace, so program and uniform calls are counted
+// but not replayed, and draws and attribute and client array
+// pointers reading client memory are skipped. Texture uploads from
+// client memory allocate the storage without the texels, which are
+// not recorded.
+//
+// Usage: GLTraceReplay [-p] [-r repeats] trace
+
+// Call the real OpenGL functions, also if OE_TRACE_GL is set.
+#define OE_GL_TRACER 1
+
+#include <Renderers/OpenGL/GLTracer.h>
+#include <GL/osmesa.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <set>
+#include <vector>
+
+using OpenEngine::Renderers::OpenGL::GLTracer;
+using std::map;
+using std::set;
+using std::vector;
+
+typedef GLTracer::Record Record;
+
+struct CallCost {
+    unsigned int replayed, skipped;
+    double nanoseconds;
+    unsigned long captured; // microseconds
+};
+
+/**
+ * Maps the object names of the trace to objects of the replay.
+ */
+class ReplayState {
+private:
+    map<GLuint, GLuint> buffers, textures, arrays;
+    map<GLuint, GLuint64> bufferSizes;
+    map<GLenum, GLuint> boundBuffers;
+    // attributes of each vertex array pointing into a buffer
+    set<std::pair<GLuint, GLuint> > safeAttributes;
+    // client arrays of each vertex array pointing into a buffer,
+    // texture coordinates per client texture unit
+    set<std::pair<GLuint, GLuint64> > safeClientArrays;
+    GLuint vertexArray;
+    GLenum clientTexture;
+
+    GLuint64 ClientArray(GLenum array) {
+        if (array != GL_TEXTURE_COORD_ARRAY) return array;
+        return array | ((GLuint64)clientTexture << 32);
+    }
+public:
+    ReplayState() : vertexArray(0), clientTexture(GL_TEXTURE0) {}
+
+    /**
+     * The replay buffer of a trace buffer, with storage for at least
+     * size bytes.
+     */
+    GLuint Buffer(GLenum target, GLuint id, GLuint64 size) {
+        if (id == 0) return 0;
+        GLuint& buffer = buffers[id];
+        if (buffer == 0) glGenBuffers(1, &buffer);
+        if (size > bufferSizes[id]) {
+            glBindBuffer(target, buffer);
+            glBufferData(target, size, NULL, GL_STREAM_DRAW);
+            glBindBuffer(target, Buffer(target, boundBuffers[target], 0));
+            bufferSizes[id] = size;
+        }
+        return buffer;
+    }
+
+    void BindBuffer(GLenum target, GLuint id) {
+        boundBuffers[target] = id;
+    }
+
+    void BufferData(GLenum target, GLuint64 size) {
+        GLuint id = boundBuffers[target];
+        if (id != 0) bufferSizes[id] = size;
+    }
+
+    GLuint Texture(GLuint id) {
+        if (id == 0) return 0;
+        GLuint& texture = textures[id];
+        if (texture == 0) glGenTextures(1, &texture);
+        return texture;
+    }
+
+    GLuint VertexArray(GLuint id) {
+        vertexArray = id;
+        if (id == 0) return 0;
+        GLuint& array = arrays[id];
+        if (array == 0) glGenVertexArrays(1, &array);
+        return array;
+    }
+
+    void SetAttributeSafe(GLuint index, bool safe) {
+        if (safe) safeAttributes.insert(std::make_pair(vertexArray, index));
+        else safeAttributes.erase(std::make_pair(vertexArray, index));
+    }
+
+    bool IsAttributeSafe(GLuint index) {
+        return safeAttributes.count(std::make_pair(vertexArray, index)) > 0;
+    }
+
+    void ClientActiveTexture(GLenum unit) {
+        clientTexture = unit;
+    }
+
+    void SetClientArraySafe(GLenum array, bool safe) {
+        if (safe) safeClientArrays.insert(std::make_pair(vertexArray, ClientArray(array)));
+        else safeClientArrays.erase(std::make_pair(vertexArray, ClientArray(array)));
+    }
+
+    bool IsClientArraySafe(GLenum array) {
+        return safeClientArrays.count(std::make_pair(vertexArray, ClientArray(array))) > 0;
+    }
+
+    /**
+     * Point the array buffer binding at the replay buffer of a
+     * client array pointer, or disable the array if it reads client
+     * memory.
+     *
+     * @return False if the pointer must be skipped.
+     */
+    bool ClientPointer(GLenum array, GLuint id, GLuint64 size) {
+        if (id == 0) {
+            SetClientArraySafe(array, false);
+            glDisableClientState(array);
+            return false;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, Buffer(GL_ARRAY_BUFFER, id, size));
+        SetClientArraySafe(array, true);
+        return true;
+    }
+
+    /**
+     * Make sure the element buffer of a draw is bound, it may be part
+     * of a vertex array bound before the captured frame.
+     */
+    void BindElements(GLuint id, GLuint64 size) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Buffer(GL_ELEMENT_ARRAY_BUFFER, id, size));
+        boundBuffers[GL_ELEMENT_ARRAY_BUFFER] = id;
+    }
+};
+
+static double Now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+ * Replay a single call, returning false if it was skipped.
+ */
+static bool Replay(const Record& r, ReplayState& state, double& cost) {
+    const vector<GLuint64>& a = r.args;
+    const void* data = r.data.empty() ? NULL : &r.data[0];
+    double start;
+    switch (r.call) {
+    case GLTracer::BIND_BUFFER: {
+        GLuint buffer = state.Buffer(a[0], a[1], a[2]);
+        state.BindBuffer(a[0], a[1]);
+        start = Now();
+        glBindBuffer(a[0], buffer);
+        break;
+    }
+    case GLTracer::BUFFER_DATA:
+        state.BufferData(a[0], a[1]);
+        start = Now();
+        glBufferData(a[0], a[1], data, a[2]);
+        break;
+    case GLTracer::BUFFER_SUB_DATA:
+        start = Now();
+        glBufferSubData(a[0], a[1], a[2], data);
+        break;
+    case GLTracer::ACTIVE_TEXTURE:
+        start = Now();
+        glActiveTexture(a[0]);
+        break;
+    case GLTracer::BIND_FRAMEBUFFER:
+        start = Now();
+        glBindFramebufferEXT(a[0], 0);
+        break;
+    case GLTracer::BIND_VERTEX_ARRAY: {
+        GLuint array = state.VertexArray(a[0]);
+        start = Now();
+        glBindVertexArray(array);
+        break;
+    }
+    case GLTracer::VERTEX_ATTRIB_POINTER: {
+        if (a[6] == 0) {
+            state.SetAttributeSafe(a[0], false);
+            glDisableVertexAttribArray(a[0]);
+            return false;
+        }
+        GLuint buffer = state.Buffer(GL_ARRAY_BUFFER, a[6], a[7]);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        state.SetAttributeSafe(a[0], true);
+        start = Now();
+        glVertexAttribPointer(a[0], (GLint)a[1], a[2], a[3], (GLsizei)a[4], (const GLvoid*)(size_t)a[5]);
+        break;
+    }
+    case GLTracer::ENABLE_VERTEX_ATTRIB_ARRAY:
+        if (!state.IsAttributeSafe(a[0])) return false;
+        start = Now();
+        glEnableVertexAttribArray(a[0]);
+        break;
+    case GLTracer::DISABLE_VERTEX_ATTRIB_ARRAY:
+        start = Now();
+        glDisableVertexAttribArray(a[0]);
+        break;
+    case GLTracer::VERTEX_ATTRIB_DIVISOR:
+        start = Now();
+        glVertexAttribDivisorARB(a[0], a[1]);
+        break;
+    case GLTracer::DRAW_ELEMENTS_INSTANCED:
+        if (a[5] == 0) return false;
+        state.BindElements(a[5], a[6]);
+        start = Now();
+        glDrawElementsInstancedARB(a[0], (GLsizei)a[1], a[2], (const GLvoid*)(size_t)a[3], (GLsizei)a[4]);
+        break;
+    case GLTracer::BLEND_EQUATION:
+        start = Now();
+        glBlendEquationEXT(a[0]);
+        break;
+    case GLTracer::ENABLE:
+        start = Now();
+        glEnable(a[0]);
+        break;
+    case GLTracer::DISABLE:
+        start = Now();
+        glDisable(a[0]);
+        break;
+    case GLTracer::BIND_TEXTURE: {
+        GLuint texture = state.Texture(a[1]);
+        start = Now();
+        glBindTexture(a[0], texture);
+        break;
+    }
+    case GLTracer::VIEWPORT:
+        start = Now();
+        glViewport((GLint)a[0], (GLint)a[1], (GLsizei)a[2], (GLsizei)a[3]);
+        break;
+    case GLTracer::CLEAR:
+        start = Now();
+        glClear(a[0]);
+        break;
+    case GLTracer::DRAW_ELEMENTS:
+        if (a[4] == 0) return false;
+        state.BindElements(a[4], a[5]);
+        start = Now();
+        glDrawElements(a[0], (GLsizei)a[1], a[2], (const GLvoid*)(size_t)a[3]);
+        break;
+    case GLTracer::DRAW_ARRAYS:
+        start = Now();
+        glDrawArrays(a[0], (GLint)a[1], (GLsizei)a[2]);
+        break;
+    case GLTracer::BLEND_FUNC:
+        start = Now();
+        glBlendFunc(a[0], a[1]);
+        break;
+    case GLTracer::DEPTH_FUNC:
+        start = Now();
+        glDepthFunc(a[0]);
+        break;
+    case GLTracer::BIND_BUFFER_BASE: {
+        GLuint buffer = state.Buffer(a[0], a[2], a[3]);
+        state.BindBuffer(a[0], a[2]);
+        start = Now();
+        glBindBufferBase(a[0], a[1], buffer);
+        break;
+    }
+    case GLTracer::CLIENT_ACTIVE_TEXTURE:
+        state.ClientActiveTexture(a[0]);
+        start = Now();
+        glClientActiveTexture(a[0]);
+        break;
+    case GLTracer::ENABLE_CLIENT_STATE:
+        if (!state.IsClientArraySafe(a[0])) return false;
+        start = Now();
+        glEnableClientState(a[0]);
+        break;
+    case GLTracer::DISABLE_CLIENT_STATE:
+        start = Now();
+        glDisableClientState(a[0]);
+        break;
+    case GLTracer::VERTEX_POINTER:
+        if (!state.ClientPointer(GL_VERTEX_ARRAY, a[4], a[5])) return false;
+        start = Now();
+        glVertexPointer((GLint)a[0], a[1], (GLsizei)a[2], (const GLvoid*)(size_t)a[3]);
+        break;
+    case GLTracer::NORMAL_POINTER:
+        if (!state.ClientPointer(GL_NORMAL_ARRAY, a[3], a[4])) return false;
+        start = Now();
+        glNormalPointer(a[0], (GLsizei)a[1], (const GLvoid*)(size_t)a[2]);
+        break;
+    case GLTracer::COLOR_POINTER:
+        if (!state.ClientPointer(GL_COLOR_ARRAY, a[4], a[5])) return false;
+        start = Now();
+        glColorPointer((GLint)a[0], a[1], (GLsizei)a[2], (const GLvoid*)(size_t)a[3]);
+        break;
+    case GLTracer::TEX_COORD_POINTER:
+        if (!state.ClientPointer(GL_TEXTURE_COORD_ARRAY, a[4], a[5])) return false;
+        start = Now();
+        glTexCoordPointer((GLint)a[0], a[1], (GLsizei)a[2], (const GLvoid*)(size_t)a[3]);
+        break;
+    case GLTracer::MATRIX_MODE:
+        start = Now();
+        glMatrixMode(a[0]);
+        break;
+    case GLTracer::PUSH_MATRIX:
+        start = Now();
+        glPushMatrix();
+        break;
+    case GLTracer::POP_MATRIX:
+        start = Now();
+        glPopMatrix();
+        break;
+    case GLTracer::LOAD_IDENTITY:
+        start = Now();
+        glLoadIdentity();
+        break;
+    case GLTracer::LOAD_MATRIX:
+        start = Now();
+        glLoadMatrixf((const GLfloat*)data);
+        break;
+    case GLTracer::MULT_MATRIX:
+        start = Now();
+        glMultMatrixf((const GLfloat*)data);
+        break;
+    case GLTracer::TEX_IMAGE_2D: {
+        // The unpack buffer may have been bound before the captured
+        // frame. Without one the pointer is client memory.
+        GLuint unpack = state.Buffer(GL_PIXEL_UNPACK_BUFFER, a[9], 0);
+        state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, a[9]);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpack);
+        const GLvoid* pixels = unpack != 0 ? (const GLvoid*)(size_t)a[8] : NULL;
+        start = Now();
+        glTexImage2D(a[0], (GLint)a[1], (GLint)a[2], (GLsizei)a[3], (GLsizei)a[4],
+                     (GLint)a[5], a[6], a[7], pixels);
+        break;
+    }
+    case GLTracer::LIGHT:
+        start = Now();
+        glLightfv(a[0], a[1], (const GLfloat*)data);
+        break;
+    default:
+        // programs and uniforms
+        return false;
+    }
+    cost = Now() - start;
+    return true;
+}
+
+static void Print(const vector<Record>& records) {
+    for (unsigned int i = 0; i < records.size(); ++i) {
+        const Record& r = records[i];
+        std::cout << GLTracer::GetCallName(r.call) << "(";
+        for (unsigned int j = 0; j < r.args.size(); ++j)
+            std::cout << (j > 0 ? ", " : "") << (long long)r.args[j];
+        std::cout << ")";
+        if (!r.data.empty()) std::cout << " [" << r.data.size() << " bytes]";
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool print = false;
+    unsigned int repeats = 100;
+    const char* file = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-p") == 0) print = true;
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) repeats = atoi(argv[++i]);
+        else file = argv[i];
+    }
+    if (file == NULL || repeats == 0) {
+        std::cerr << "usage: " << argv[0] << " [-p] [-r repeats] trace" << std::endl;
+        return 1;
+    }
+
+    vector<Record> records;
+    if (!GLTracer::ReadTrace(file, records)) {
+        std::cerr << "could not read the trace " << file << std::endl;
+        return 1;
+    }
+    if (print) {
+        Print(records);
+        return 0;
+    }
+
+    const unsigned int width = 256, height = 256;
+    OSMesaContext context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 8, 0, NULL);
+    vector<GLubyte> pixels(width * height * 4);
+    if (context == NULL ||
+        !OSMesaMakeCurrent(context, &pixels[0], GL_UNSIGNED_BYTE, width, height)) {
+        std::cerr << "could not create an OSMesa context" << std::endl;
+        return 1;
+    }
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        std::cerr << "GLEW: " << (const char*)glewGetErrorString(err) << std::endl;
+        OSMesaDestroyContext(context);
+        return 1;
+    }
+
+    vector<CallCost> costs(GLTracer::CALL_COUNT);
+    for (unsigned int i = 0; i < costs.size(); ++i) {
+        costs[i].replayed = costs[i].skipped = 0;
+        costs[i].nanoseconds = 0.0;
+        costs[i].captured = 0;
+    }
+    for (unsigned int i = 0; i < records.size(); ++i)
+        costs[records[i].call].captured += records[i].duration;
+
+    ReplayState state;
+    double frames = 0.0;
+    for (unsigned int n = 0; n < repeats; ++n) {
+        double start = Now();
+        for (unsigned int i = 0; i < records.size(); ++i) {
+            double cost;
+            CallCost& c = costs[records[i].call];
+            if (Replay(records[i], state, cost)) {
+                ++c.replayed;
+                c.nanoseconds += cost;
+            } else ++c.skipped;
+        }
+        glFinish();
+        frames += Now() - start;
+    }
+    OSMesaDestroyContext(context);
+
+    std::cout << "calls " << records.size() << std::endl
+              << "repeats " << repeats << std::endl
+              << "frame_ms " << frames / repeats / 1e6 << std::endl
+              << "# call count replayed skipped replay_ns_mean capture_us_total" << std::endl;
+    for (unsigned int i = 0; i < costs.size(); ++i) {
+        const CallCost& c = costs[i];
+        if (c.replayed + c.skipped == 0) continue;
+        std::cout << GLTracer::GetCallName((GLTracer::Call)i) << " "
+                  << (c.replayed + c.skipped) / repeats << " "
+                  << c.replayed / repeats << " "
+                  << c.skipped / repeats << " "
+                  << (c.replayed > 0 ? c.nanoseconds / c.replayed : 0.0) << " "
+                  << c.captured << std::endl;
+    }
+    return 0;
+}
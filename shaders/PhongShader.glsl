@@ -1,5 +1,7 @@
 # built-in phong shader program
 
+vert: extensions/OpenGLRenderer/shaders/UniformBlocks.glsl
 vert: extensions/OpenGLRenderer/shaders/PhongShader.glsl.vert
+frag: extensions/OpenGLRenderer/shaders/UniformBlocks.glsl
 frag: extensions/OpenGLRenderer/shaders/PhongShader.glsl.frag
 
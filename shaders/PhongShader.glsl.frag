@@ -1,9 +1,29 @@
+// With BINDLESS_TEXTURES the samplers are resident handles set by
+// OpenGLShader, which also enables GL_ARB_bindless_texture ahead of
+// the sources.
 #define MAX_LIGHTS 2
+// Set by PhongShader to the number of enabled lights.
+#ifndef NUM_LIGHTS
 #define NUM_LIGHTS 1
+#endif
 
 varying vec3 normal, eyeVec;
+#ifdef HAS_DIFFUSE_MAP
 uniform sampler2D diffuseMap;
+#endif
+#ifdef HAS_SPECULAR_MAP
+uniform sampler2D specularMap;
+#endif
 varying vec3 lightDir[MAX_LIGHTS];
+
+#ifdef UNIFORM_BLOCKS
+#define LIGHT_DIFFUSE(i) lightSources[i].diffuse
+#define LIGHT_SPECULAR(i) lightSources[i].specular
+#else
+#define LIGHT_DIFFUSE(i) gl_LightSource[i].diffuse
+#define LIGHT_SPECULAR(i) gl_LightSource[i].specular
+#endif
+
 void main (void)
 {
   vec4 final_color =
@@ -16,17 +36,25 @@ void main (void)
     float lambertTerm = dot(N,L);
     if (lambertTerm > 0.0)
     {
+      vec4 diffuse = gl_FrontMaterial.diffuse;
+#ifdef HAS_DIFFUSE_MAP
+      diffuse *= texture2D(diffuseMap, gl_TexCoord[0].st);
+#endif
       final_color +=
-        gl_LightSource[i].diffuse *
-          gl_FrontMaterial.diffuse *  texture2D(diffuseMap, gl_TexCoord[0].st) *
+        LIGHT_DIFFUSE(i) *
+        diffuse *
         lambertTerm;
       vec3 E = normalize(eyeVec);
       vec3 R = reflect(-L, N);
       float specular = pow(max(dot(R, E), 0.0),
                            gl_FrontMaterial.shininess);
+      vec4 specularColor = gl_FrontMaterial.specular;
+#ifdef HAS_SPECULAR_MAP
+      specularColor *= texture2D(specularMap, gl_TexCoord[0].st);
+#endif
       final_color +=
-        gl_LightSource[i].specular *
-        gl_FrontMaterial.specular *
+        LIGHT_SPECULAR(i) *
+        specularColor *
         specular;
     }
   }
@@ -1,18 +1,44 @@
 varying vec3 normal, eyeVec;
 #define MAX_LIGHTS 2
+// Set by PhongShader to the number of enabled lights.
+#ifndef NUM_LIGHTS
 #define NUM_LIGHTS 1
+#endif
 varying vec3 lightDir[MAX_LIGHTS];
+
+// The lights and the projection come from the shared uniform blocks
+// where available.
+#ifdef UNIFORM_BLOCKS
+#define LIGHT_POSITION(i) lightSources[i].position
+#define PROJECTION projectionMatrix
+#else
+#define LIGHT_POSITION(i) gl_LightSource[i].position
+#define PROJECTION gl_ProjectionMatrix
+#endif
+
+// Set by the renderer when drawing instances. The instance model
+// view matrix is assumed to contain no non-uniform scaling.
+uniform int instanced;
+attribute mat4 instanceModelView;
+
 void main()
 {
     gl_TexCoord[0] = gl_MultiTexCoord0; 
-    gl_Position = ftransform();
-    normal = gl_NormalMatrix * gl_Normal;
-    vec4 vVertex = gl_ModelViewMatrix * gl_Vertex;
+    vec4 vVertex;
+    if (instanced != 0) {
+        vVertex = instanceModelView * gl_Vertex;
+        gl_Position = PROJECTION * vVertex;
+        normal = (instanceModelView * vec4(gl_Normal, 0.0)).xyz;
+    } else {
+        vVertex = gl_ModelViewMatrix * gl_Vertex;
+        gl_Position = PROJECTION * vVertex;
+        normal = gl_NormalMatrix * gl_Normal;
+    }
     eyeVec = -vVertex.xyz;
     int i;
     for (i=0; i<NUM_LIGHTS; ++i)
         lightDir[i] =
-      vec3(gl_LightSource[i].position.xyz - vVertex.xyz);
+      vec3(LIGHT_POSITION(i).xyz - vVertex.xyz);
 }
 /* uniform int lights; */
 /* varying vec3 normal, lightDir[2], halfVec[2]; */
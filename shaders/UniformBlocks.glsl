@@ -0,0 +1,45 @@
+// Shared uniform blocks, see Renderers/OpenGL/UniformBlocks.h.
+//
+// List this file before the other sources of a shader stage, eg.
+//   vert: extensions/OpenGLRenderer/shaders/UniformBlocks.glsl
+// The blocks are connected to their binding points when the program
+// is linked. They are only declared when UNIFORM_BLOCKS is defined,
+// which OpenGLShader does when the renderer supports them.
+
+#ifdef UNIFORM_BLOCKS
+#extension GL_ARB_uniform_buffer_object : enable
+
+#define MAX_BLOCK_LIGHTS 8
+
+layout(std140) uniform FrameBlock {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    vec4 cameraPosition;
+    vec4 time; // seconds since start, frame time
+};
+
+struct BlockLight {
+    vec4 position;    // eye space, w is 0 for directional lights
+    vec4 direction;   // eye space
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation; // constant, linear, quadratic
+    vec4 spot;        // cutoff, exponent
+};
+
+layout(std140) uniform LightBlock {
+    ivec4 lightCount;
+    BlockLight lightSources[MAX_BLOCK_LIGHTS];
+};
+
+// The shadow map of a ShadowLightPostProcessNode, only bound while
+// its effect is applied.
+#define MAX_BLOCK_CASCADES 4
+
+layout(std140) uniform ShadowBlock {
+    mat4 lightMat[MAX_BLOCK_CASCADES]; // shadow map matrix of each cascade
+    vec4 cascadeSplits; // far eye space depth of each cascade
+    ivec4 cascades;     // number of cascades
+};
+#endif